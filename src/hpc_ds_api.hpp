@@ -1,13 +1,21 @@
 #pragma once
 #include "hpc_ds_details.hpp"
 #include "hpc_ds_structs.hpp"
+#include <algorithm>
 #include <fmt/core.h>
+#include <fstream>
+#include <functional>
+#include <future>
 #include <i3d/image3d.h>
 #include <i3d/transform.h>
+#include <deque>
+#include <list>
 #include <memory>
+#include <numeric>
 #include <ranges>
 #include <stdexcept>
 #include <string>
+#include <system_error>
 #include <type_traits>
 #include <vector>
 
@@ -28,6 +36,69 @@ inline dataset_props_ptr get_dataset_properties(const std::string& ip,
                                                 int port,
                                                 const std::string& uuid);
 
+/**
+ * @brief Set minimal level of printed log messages
+ *
+ * Messages are printed only if enabled at compile time as well (see
+ * DATASTORE_NLOG, DATASTORE_NINFO and DATASTORE_NWARNING).
+ *
+ * @param level Minimal level (LogLevel::NONE disables logging)
+ */
+inline void set_log_level(LogLevel level);
+
+/**
+ * @brief Replace all log sinks (standard output by default) by given one
+ *
+ * Sinks are called from the background logging thread.
+ *
+ * @param sink Sink receiving formatted messages (empty disables output)
+ */
+inline void set_log_sink(LogSink sink);
+
+/**
+ * @brief Add sink receiving log messages
+ *
+ * @param sink Sink receiving formatted messages
+ */
+inline void add_log_sink(LogSink sink);
+
+/**
+ * @brief Wait until all messages logged so far are passed to the sinks
+ */
+inline void flush_log();
+
+/**
+ * @brief Start recording timeline of client operations
+ *
+ * Previously recorded events are discarded. Spans of properties fetches,
+ * session requests, all HTTP requests and encoding/decoding of each block are
+ * recorded (from all threads), until stop_tracing is called.
+ */
+inline void start_tracing();
+
+/**
+ * @brief Stop recording timeline of client operations
+ */
+inline void stop_tracing();
+
+/**
+ * @brief Get recorded timeline in Chrome trace format
+ *
+ * The result can be opened in chrome://tracing or https://ui.perfetto.dev
+ *
+ * @return std::string JSON
+ */
+inline std::string get_trace();
+
+/**
+ * @brief Save recorded timeline in Chrome trace format to file
+ *
+ * @param path Path to the output file
+ * @throws std::system_error (std::errc::io_error) if the file cannot be
+ * written
+ */
+inline void save_trace(const std::string& path);
+
 /**
  * @brief Read full image
  *
@@ -61,6 +132,34 @@ i3d::Image3d<T> read_image(const std::string& ip,
                            const std::string& version = "latest",
                            dataset_props_ptr props = nullptr);
 
+/**
+ * @brief Read full image of voxel type given by server
+ *
+ * Same as read_image, but the voxel type does not have to be known at compile
+ * time. Dataset properties are fetched (at most) once.
+ *
+ * @param ip IP address of server (http:// at the beginning is not necessary)
+ * @param port Port, where the server is listening for requests
+ * @param uuid Unique identifier of dataset
+ * @param channel Channel, at which the image is located
+ * @param timepoint Timepoint, at which the image is located
+ * @param angle Angle, at which the image is located
+ * @param resolution Resolution, at which the image is located
+ * @param version Version, at which the image is located (integer identifier or
+ * "latest")
+ * @param props [Optional] cached dataset properties
+ * @return AnyImage holding i3d::Image3d of dataset voxel type
+ */
+inline AnyImage read_image_any(const std::string& ip,
+                               int port,
+                               const std::string& uuid,
+                               int channel = 0,
+                               int timepoint = 0,
+                               int angle = 0,
+                               i3d::Vector3d<int> resolution = {1, 1, 1},
+                               const std::string& version = "latest",
+                               dataset_props_ptr props = nullptr);
+
 /**
  * @brief Write full image
  *
@@ -124,6 +223,15 @@ void write_with_pyramids(const i3d::Image3d<T>& img,
                          SamplingMode m = SamplingMode::NEAREST_NEIGHBOUR,
                          dataset_props_ptr props = nullptr);
 
+/**
+ * @brief Callable providing full-resolution blocks
+ *
+ * Gets block coordinate and returns corresponding block at resolution
+ * {1, 1, 1} (of size given by DatasetProperties::get_block_size).
+ */
+template <cnpts::Scalar T>
+using block_producer = std::function<i3d::Image3d<T>(i3d::Vector3d<int>)>;
+
 /**
  * @brief Representation of connection to specific image
  *
@@ -166,6 +274,130 @@ class ImageView {
 	 */
 	dataset_props_ptr get_properties() const;
 
+	/**
+	 * @brief Set limits used to split blocks into requests
+	 *
+	 * Limits are shared with the Connection this view was obtained from (and
+	 * all its views). Separate planners are kept for reading and writing, both
+	 * get the same limits.
+	 *
+	 * @param limits Batch limits
+	 */
+	void set_batch_limits(const BatchLimits& limits);
+
+	/**
+	 * @brief Get limits used to split blocks into requests
+	 *
+	 * @return BatchLimits
+	 */
+	BatchLimits get_batch_limits() const;
+
+	/**
+	 * @brief Set policy of retrying failed block requests
+	 *
+	 * The policy is shared with the Connection this view was obtained from
+	 * (and all its views).
+	 *
+	 * @param policy Retry policy
+	 */
+	void set_retry_policy(const RetryPolicy& policy);
+
+	/**
+	 * @brief Get policy of retrying failed block requests
+	 *
+	 * @return RetryPolicy
+	 */
+	RetryPolicy get_retry_policy() const;
+
+	/**
+	 * @brief Set policy of hedging slow block reads
+	 *
+	 * The policy (and the history of request durations) is shared with the
+	 * Connection this view was obtained from (and all its views).
+	 *
+	 * @param policy Hedging policy
+	 */
+	void set_hedging_policy(const HedgingPolicy& policy);
+
+	/**
+	 * @brief Get policy of hedging slow block reads
+	 *
+	 * @return HedgingPolicy
+	 */
+	HedgingPolicy get_hedging_policy() const;
+
+	/**
+	 * @brief Set limits of concurrent block requests
+	 *
+	 * The limit is shared by all connections (and views) to the same server
+	 * (ip:port).
+	 *
+	 * @param policy Concurrency policy
+	 */
+	void set_concurrency_policy(const ConcurrencyPolicy& policy);
+
+	/**
+	 * @brief Get limits of concurrent block requests
+	 *
+	 * @return ConcurrencyPolicy
+	 */
+	ConcurrencyPolicy get_concurrency_policy() const;
+
+	/**
+	 * @brief Get current limit of block requests in flight to the server
+	 *
+	 * @return std::size_t
+	 */
+	std::size_t get_concurrency_limit() const;
+
+	/**
+	 * @brief Set socket timeouts of HTTP requests
+	 *
+	 * Timeouts are shared with the Connection this view was obtained from
+	 * (and all its views).
+	 *
+	 * @param timeouts Timeouts
+	 * @throws std::logic_error if any of the timeouts is not positive
+	 */
+	void set_timeouts(const Timeouts& timeouts);
+
+	/**
+	 * @brief Get socket timeouts of HTTP requests
+	 *
+	 * @return Timeouts
+	 */
+	Timeouts get_timeouts() const;
+
+	/**
+	 * @brief Get copy of this view, whose operations can be cancelled
+	 *
+	 * Reads and writes of the returned view stop, when <token> is cancelled
+	 * or its deadline passes, and throw OperationCancelled. Requests in
+	 * progress are aborted (their connections are closed). Blocks received
+	 * completely before that are already stored in the destination image,
+	 * the rest of it keeps its previous content. Of writes, batches finished
+	 * before are stored on the server, the interrupted one may or may not be.
+	 *
+	 * @param token Cancellation token (may be shared by several views)
+	 * @return ImageView
+	 */
+	ImageView with_cancellation(CancellationToken token) const;
+
+	/**
+	 * @brief Get metrics recorded so far (see Metrics for their names)
+	 *
+	 * Metrics are shared with the Connection this view was obtained from (and
+	 * all its views). Empty, when compiled with DATASTORE_NMETRICS.
+	 *
+	 * @return Metrics snapshot
+	 */
+	Metrics get_metrics() const;
+
+	/**
+	 * @brief Discard all recorded metrics
+	 */
+	void reset_metrics();
+
 	/**
 	 * @brief Read one block from server
 	 *
@@ -246,6 +478,7 @@ class ImageView {
 	 *
 	 * Read blocks specified in <coords> and saves them into locations given in
 	 * <offsets>.
+	 * Blocks are decoded concurrently, so their locations should not overlap.
 	 *
 	 * If in DEBUG, the function checks if coordinates given in <coords> points
 	 * to a valid blocks.
@@ -301,6 +534,22 @@ class ImageView {
 	                 i3d::Vector3d<int> offset = {0, 0, 0},
 	                 dataset_props_ptr props = nullptr) const;
 
+	/**
+	 * @brief Read region of interest into caller-provided buffer
+	 *
+	 * Reads region [start_point, start_point + dest.size) and decodes blocks
+	 * directly into strided view <dest>, so no intermediate image is created.
+	 *
+	 * @tparam T Scalar used as underlying type for image representation
+	 * @param start_point smallest point of the region
+	 * @param dest destination view
+	 * @param props [Optional] cached dataset properties
+	 */
+	template <cnpts::Scalar T>
+	void read_region(i3d::Vector3d<int> start_point,
+	                 StridedView<T> dest,
+	                 dataset_props_ptr props = nullptr) const;
+
 	/**
 	 * @brief Read full image
 	 *
@@ -317,6 +566,73 @@ class ImageView {
 	template <cnpts::Scalar T>
 	i3d::Image3d<T> read_image(dataset_props_ptr props = nullptr) const;
 
+	/**
+	 * @brief Read region of interest of voxel type given by server
+	 *
+	 * Same as read_region, but the voxel type does not have to be known at
+	 * compile time. Dataset properties are fetched (at most) once.
+	 *
+	 * @param start_point smallest point of the region
+	 * @param end_point point just after the region
+	 * @param props [Optional] cached dataset properties
+	 * @return AnyImage holding i3d::Image3d of dataset voxel type
+	 */
+	AnyImage read_region_any(i3d::Vector3d<int> start_point,
+	                         i3d::Vector3d<int> end_point,
+	                         dataset_props_ptr props = nullptr) const;
+
+	/**
+	 * @brief Read full image of voxel type given by server
+	 *
+	 * Same as read_image, but the voxel type does not have to be known at
+	 * compile time. Dataset properties are fetched (at most) once.
+	 *
+	 * @param props [Optional] cached dataset properties
+	 * @return AnyImage holding i3d::Image3d of dataset voxel type
+	 */
+	AnyImage read_image_any(dataset_props_ptr props = nullptr) const;
+
+	/**
+	 * @brief Read full image to file
+	 *
+	 * Creates sparse file of the image size, maps it to memory and decodes
+	 * blocks directly into it (using several concurrent download streams), so
+	 * the image does not have to fit into RAM. Voxels are stored with x as
+	 * the fastest axis in native byte order, optionally preceded by NRRD
+	 * header.
+	 *
+	 * @tparam T Scalar used as underlying type for image representation
+	 * @param path Path of the file (overwritten if exists)
+	 * @param layout File layout
+	 * @param props [Optional] cached dataset properties
+	 */
+	template <cnpts::Scalar T>
+	void read_image_to_file(const std::string& path,
+	                        FileLayout layout = FileLayout::RAW,
+	                        dataset_props_ptr props = nullptr) const;
+
+	/**
+	 * @brief Export full image into sequence of 2D image files
+	 *
+	 * Image is read in slabs one block thick, every slice is written to its
+	 * own file using i3d image writers (file format is guessed from the
+	 * extension). The next slab is fetched while the previous one is being
+	 * written, so at most two slabs are held in memory.
+	 *
+	 * i3d writers accept only whole images, therefore volumetric formats
+	 * (HDF5, multi-page TIFF) cannot be written slab by slab; the slices can be
+	 * read back as one image by i3d::SequenceReader.
+	 *
+	 * @tparam T Scalar used as underlying type for image representation
+	 * @param path_pattern Path of slice files with replacement field of slice
+	 * index (fmt syntax, e.g. "slice_{:04}.tif"), existing files are
+	 * overwritten
+	 * @param props [Optional] cached dataset properties
+	 */
+	template <cnpts::FileVoxel T>
+	void export_image(const std::string& path_pattern,
+	                  dataset_props_ptr props = nullptr) const;
+
 	/**
 	 * @brief Write block to server
 	 *
@@ -379,7 +695,172 @@ class ImageView {
 	void write_image(const i3d::Image3d<T>& img,
 	                 dataset_props_ptr props = nullptr) const;
 
+	/**
+	 * @brief Write region to server
+	 *
+	 * Write whole <src> image to server, so that its first voxel is placed at
+	 * <start_point>. The region does not have to be aligned to blocks.
+	 *
+	 * Blocks fully covered by the region are uploaded directly. Blocks only
+	 * partially covered are fetched from the server in batches of upload
+	 * requests, merged with corresponding part of <src> and uploaded back
+	 * (while the next batch is being fetched). Both phases run concurrently.
+	 *
+	 * @tparam T Scalar used as underlying type for image representation
+	 * @param src Source image
+	 * @param start_point Position of the first voxel of <src> in server image
+	 * @param props [Optional] cached dataset properties
+	 */
+	template <cnpts::Scalar T>
+	void write_region(const i3d::Image3d<T>& src,
+	                  i3d::Vector3d<int> start_point,
+	                  dataset_props_ptr props = nullptr) const;
+
+	/**
+	 * @brief Write region from caller-provided buffer to server
+	 *
+	 * Same as the overload above, blocks are encoded directly from strided
+	 * view <src>.
+	 *
+	 * @tparam T Scalar used as underlying type for image representation
+	 * (may be const-qualified)
+	 * @param src Source view
+	 * @param start_point Position of the first voxel of <src> in server image
+	 * @param props [Optional] cached dataset properties
+	 */
+	template <cnpts::Scalar T>
+	void write_region(StridedView<T> src,
+	                  i3d::Vector3d<int> start_point,
+	                  dataset_props_ptr props = nullptr) const;
+
+	/**
+	 * @brief Import full image from sequence of 2D image files
+	 *
+	 * Counterpart of export_image. Slices are loaded by i3d image readers
+	 * into slabs one block thick and every slab is uploaded as soon as it is
+	 * complete, while the next one is being loaded. At most two slabs are
+	 * held in memory, so the image does not have to fit into RAM.
+	 *
+	 * Every slice file has to have the size of the image in x and y and
+	 * voxel type matching T.
+	 *
+	 * @tparam T Scalar used as underlying type for image representation
+	 * @param path_pattern Path of slice files with replacement field of slice
+	 * index (fmt syntax, e.g. "slice_{:04}.tif")
+	 * @param props [Optional] cached dataset properties
+	 */
+	template <cnpts::FileVoxel T>
+	void import_image(const std::string& path_pattern,
+	                  dataset_props_ptr props = nullptr) const;
+
+	/**
+	 * @brief Apply filter to the image tile by tile and write result to
+	 * <target>
+	 *
+	 * Block grid is partitioned into tiles (see TilingPolicy), which are
+	 * processed concurrently. Every tile is read with its halo, passed to
+	 * <filter> (e.g. i3d filter wrapped in lambda) and the filtered tile
+	 * without halo is written to <target> in batches. Only a few tiles are
+	 * held in memory at once.
+	 *
+	 * Tiles read halos from this view while other tiles are being written,
+	 * so <target> should be a different view (e.g. another version), unless
+	 * the filter is pointwise.
+	 *
+	 * @tparam T Scalar used as underlying type for image representation
+	 * @param filter callable filter(const i3d::Image3d<T>& in,
+	 * i3d::Image3d<T>& out), <out> has to have the size of <in>
+	 * @param target view of the same image dimensions to write result to
+	 * @param policy tiles and halo size
+	 * @param props [Optional] cached dataset properties
+	 */
+	template <cnpts::Scalar T, typename F>
+	void apply_filter(F&& filter,
+	                  const ImageView& target,
+	                  TilingPolicy policy = {},
+	                  dataset_props_ptr props = nullptr) const;
+
+	/**
+	 * @brief Compute statistics of voxels of region of interest
+	 *
+	 * Blocks are fetched concurrently and their voxels are recorded right
+	 * from the received data (no image is allocated), partial statistics
+	 * of blocks are then merged. Voxel type is taken from the dataset
+	 * properties.
+	 *
+	 * @param start_point smallest point of the region
+	 * @param end_point largest point of the region (exclusive)
+	 * @param options histogram bins and range, resolution level to use
+	 * (<start_point> and <end_point> are scaled to it)
+	 * @param props [Optional] cached dataset properties
+	 * @return Statistics of the region
+	 */
+	Statistics compute_statistics(i3d::Vector3d<int> start_point,
+	                              i3d::Vector3d<int> end_point,
+	                              StatisticsOptions options = {},
+	                              dataset_props_ptr props = nullptr) const;
+
+	/**
+	 * @brief Compute statistics of voxels of full image
+	 *
+	 * @param options histogram bins and range, resolution level to use
+	 * @param props [Optional] cached dataset properties
+	 * @return Statistics of the image
+	 */
+	Statistics compute_statistics(StatisticsOptions options = {},
+	                              dataset_props_ptr props = nullptr) const;
+
   private:
+	/**
+	 * @brief Check whether this view is supported by the dataset
+	 *
+	 * @param props dataset properties
+	 */
+	void check_view(const DatasetProperties& props) const;
+
+	/**
+	 * @brief Fetch blocks from server (batched) and pass them to <consume>
+	 *
+	 * @param coords Block coordinates
+	 * @param props dataset properties
+	 * @param consume callable (index to <coords>, block octet-data, block size)
+	 */
+	template <typename F>
+	void fetch_blocks(const std::vector<i3d::Vector3d<int>>& coords,
+	                  const DatasetProperties& props,
+	                  F&& consume) const;
+
+	/**
+	 * @brief Upload blocks to server (batched), data are filled by <produce>
+	 *
+	 * @param coords Block coordinates
+	 * @param props dataset properties
+	 * @param produce callable (index to <coords>, preallocated block
+	 * octet-data, block size)
+	 */
+	template <typename F>
+	void upload_blocks(const std::vector<i3d::Vector3d<int>>& coords,
+	                   const DatasetProperties& props,
+	                   F&& produce) const;
+
+	/**
+	 * @brief Get octet-data size of each block
+	 */
+	std::vector<std::size_t>
+	get_block_bytes(const std::vector<i3d::Vector3d<int>>& coords,
+	                const DatasetProperties& props) const;
+
+	/**
+	 * @brief Throw OperationCancelled, if operations of this view are
+	 * cancelled
+	 */
+	void check_cancelled() const;
+
+	/**
+	 * @brief Sleep before retry of a request (interrupted by cancellation)
+	 */
+	void wait_before_retry(std::chrono::milliseconds delay) const;
+
 	std::string _ip;
 	int _port;
 	std::string _uuid;
@@ -388,6 +869,15 @@ class ImageView {
 	int _angle;
 	i3d::Vector3d<int> _resolution;
 	std::string _version;
+
+	/* Shared with the Connection this view was obtained from */
+	std::shared_ptr<details::Context> _context =
+	    std::make_shared<details::Context>();
+
+	/* See with_cancellation */
+	std::optional<CancellationToken> _cancellation;
+
+	friend class Connection;
 };
 
 /**
@@ -414,6 +904,20 @@ class Connection {
 	 */
 	Connection(std::string ip, int port, std::string uuid);
 
+	/**
+	 * @brief Construct a new Connection object to several servers
+	 *
+	 * The servers must serve the same datasets (e.g. share the storage).
+	 * Block requests are spread among them, each goes to the server with the
+	 * least outstanding requests (then to the one with lower latency). A
+	 * server that failed is avoided for a while and its requests are retried
+	 * on the others (see RetryPolicy).
+	 *
+	 * @param endpoints Addresses of the servers (at least one)
+	 * @param uuid Unique identifier of dataset
+	 */
+	Connection(std::vector<Endpoint> endpoints, std::string uuid);
+
 	/**
 	 * @brief Get ImageView of specified image.
 	 *
@@ -439,25 +943,131 @@ class Connection {
 	dataset_props_ptr get_properties() const;
 
 	/**
-	 * @brief Read one block from server to image
+	 * @brief Set limits used to split blocks into requests
 	 *
-	 * Reads one block of image located at <coord> and saves it to <dest> with
-	 * offset <dest_offset>.
-	 *
-	 * If in DEBUG, function will check wheter given coordinate corresponds
-	 * to valid block as well as wheter the block fits into the image (taking
-	 * offset into account).
+	 * Limits are shared with all views obtained from this connection. Separate
+	 * planners are kept for reading and writing, both get the same limits.
 	 *
-	 * @tparam T Scalar used as underlying type for image representation
-	 * @param coord Block coordinate
-	 * @param channel Channel, at which the image is located
-	 * @param timepoint Timepoint, at which the image is located
-	 * @param angle Angle, at which the image is located
-	 * @param resolution Resolution, at which the image is located
-	 * @param version Version, at which the image is located (integer identifier
-	 * or "latest")
-	 * @param props [Optional] cached dataset properties
-	 * @return Image containing selected block
+	 * @param limits Batch limits
+	 */
+	void set_batch_limits(const BatchLimits& limits);
+
+	/**
+	 * @brief Get limits used to split blocks into requests
+	 *
+	 * @return BatchLimits
+	 */
+	BatchLimits get_batch_limits() const;
+
+	/**
+	 * @brief Set policy of retrying failed block requests
+	 *
+	 * The policy is shared with all views obtained from this connection.
+	 *
+	 * @param policy Retry policy
+	 */
+	void set_retry_policy(const RetryPolicy& policy);
+
+	/**
+	 * @brief Get policy of retrying failed block requests
+	 *
+	 * @return RetryPolicy
+	 */
+	RetryPolicy get_retry_policy() const;
+
+	/**
+	 * @brief Set policy of hedging slow block reads
+	 *
+	 * The policy (and the history of request durations) is shared with all
+	 * views obtained from this connection.
+	 *
+	 * @param policy Hedging policy
+	 */
+	void set_hedging_policy(const HedgingPolicy& policy);
+
+	/**
+	 * @brief Get policy of hedging slow block reads
+	 *
+	 * @return HedgingPolicy
+	 */
+	HedgingPolicy get_hedging_policy() const;
+
+	/**
+	 * @brief Set limits of concurrent block requests
+	 *
+	 * The limit is shared by all connections (and views) to the same server
+	 * (ip:port).
+	 *
+	 * @param policy Concurrency policy
+	 */
+	void set_concurrency_policy(const ConcurrencyPolicy& policy);
+
+	/**
+	 * @brief Get limits of concurrent block requests
+	 *
+	 * @return ConcurrencyPolicy
+	 */
+	ConcurrencyPolicy get_concurrency_policy() const;
+
+	/**
+	 * @brief Get current limit of block requests in flight to the server
+	 *
+	 * @return std::size_t
+	 */
+	std::size_t get_concurrency_limit() const;
+
+	/**
+	 * @brief Set socket timeouts of HTTP requests
+	 *
+	 * Timeouts are shared with all views obtained from this connection.
+	 *
+	 * @param timeouts Timeouts
+	 * @throws std::logic_error if any of the timeouts is not positive
+	 */
+	void set_timeouts(const Timeouts& timeouts);
+
+	/**
+	 * @brief Get socket timeouts of HTTP requests
+	 *
+	 * @return Timeouts
+	 */
+	Timeouts get_timeouts() const;
+
+	/**
+	 * @brief Get metrics recorded so far (see Metrics for their names)
+	 *
+	 * Metrics are shared with all views obtained from this connection. Empty,
+	 * when compiled with DATASTORE_NMETRICS.
+	 *
+	 * @return Metrics snapshot
+	 */
+	Metrics get_metrics() const;
+
+	/**
+	 * @brief Discard all recorded metrics
+	 */
+	void reset_metrics();
+
+	/**
+	 * @brief Read one block from server to image
+	 *
+	 * Reads one block of image located at <coord> and saves it to <dest> with
+	 * offset <dest_offset>.
+	 *
+	 * If in DEBUG, function will check wheter given coordinate corresponds
+	 * to valid block as well as wheter the block fits into the image (taking
+	 * offset into account).
+	 *
+	 * @tparam T Scalar used as underlying type for image representation
+	 * @param coord Block coordinate
+	 * @param channel Channel, at which the image is located
+	 * @param timepoint Timepoint, at which the image is located
+	 * @param angle Angle, at which the image is located
+	 * @param resolution Resolution, at which the image is located
+	 * @param version Version, at which the image is located (integer identifier
+	 * or "latest")
+	 * @param props [Optional] cached dataset properties
+	 * @return Image containing selected block
 	 */
 	template <cnpts::Scalar T>
 	i3d::Image3d<T> read_block(i3d::Vector3d<int> coord,
@@ -548,6 +1158,7 @@ class Connection {
 	 *
 	 * Read blocks specified in <coords> and saves them into locations given in
 	 * <offsets>.
+	 * Blocks are decoded concurrently, so their locations should not overlap.
 	 *
 	 * If in DEBUG, the function checks if coordinates given in <coords> points
 	 * to a valid blocks, as well as wheter the offsets specified for each block
@@ -637,6 +1248,33 @@ class Connection {
 	                 const std::string& version,
 	                 dataset_props_ptr props = nullptr) const;
 
+	/**
+	 * @brief Read region of interest into caller-provided buffer
+	 *
+	 * Reads region [start_point, start_point + dest.size) directly into
+	 * strided view <dest>.
+	 *
+	 * @tparam T Scalar used as underlying type for image representation
+	 * @param start_point smallest point of the region
+	 * @param dest destination view
+	 * @param channel Channel, at which the image is located
+	 * @param timepoint Timepoint, at which the image is located
+	 * @param angle Angle, at which the image is located
+	 * @param resolution Resolution, at which the image is located
+	 * @param version Version, at which the image is located (integer identifier
+	 * or "latest")
+	 * @param props [Optional] cached dataset properties
+	 */
+	template <cnpts::Scalar T>
+	void read_region(i3d::Vector3d<int> start_point,
+	                 StridedView<T> dest,
+	                 int channel,
+	                 int timepoint,
+	                 int angle,
+	                 i3d::Vector3d<int> resolution,
+	                 const std::string& version,
+	                 dataset_props_ptr props = nullptr) const;
+
 	/**
 	 * @brief Read full image
 	 *
@@ -664,6 +1302,107 @@ class Connection {
 	                           const std::string& version,
 	                           dataset_props_ptr props = nullptr) const;
 
+	/**
+	 * @brief Read region of interest of voxel type given by server
+	 *
+	 * Same as read_region, but the voxel type does not have to be known at
+	 * compile time. Dataset properties are fetched (at most) once.
+	 *
+	 * @param start_point smallest point of the region
+	 * @param end_point point just after the region
+	 * @param channel Channel, at which the image is located
+	 * @param timepoint Timepoint, at which the image is located
+	 * @param angle Angle, at which the image is located
+	 * @param resolution Resolution, at which the image is located
+	 * @param version Version, at which the image is located (integer identifier
+	 * or "latest")
+	 * @param props [Optional] cached dataset properties
+	 * @return AnyImage holding i3d::Image3d of dataset voxel type
+	 */
+	AnyImage read_region_any(i3d::Vector3d<int> start_point,
+	                         i3d::Vector3d<int> end_point,
+	                         int channel,
+	                         int timepoint,
+	                         int angle,
+	                         i3d::Vector3d<int> resolution,
+	                         const std::string& version,
+	                         dataset_props_ptr props = nullptr) const;
+
+	/**
+	 * @brief Read full image of voxel type given by server
+	 *
+	 * Same as read_image, but the voxel type does not have to be known at
+	 * compile time. Dataset properties are fetched (at most) once.
+	 *
+	 * @param channel Channel, at which the image is located
+	 * @param timepoint Timepoint, at which the image is located
+	 * @param angle Angle, at which the image is located
+	 * @param resolution Resolution, at which the image is located
+	 * @param version Version, at which the image is located (integer identifier
+	 * or "latest")
+	 * @param props [Optional] cached dataset properties
+	 * @return AnyImage holding i3d::Image3d of dataset voxel type
+	 */
+	AnyImage read_image_any(int channel,
+	                        int timepoint,
+	                        int angle,
+	                        i3d::Vector3d<int> resolution,
+	                        const std::string& version,
+	                        dataset_props_ptr props = nullptr) const;
+
+	/**
+	 * @brief Read full image to file
+	 *
+	 * Blocks are decoded directly into memory-mapped file, so the image does
+	 * not have to fit into RAM (see ImageView::read_image_to_file).
+	 *
+	 * @tparam T Scalar used as underlying type for image representation
+	 * @param path Path of the file (overwritten if exists)
+	 * @param layout File layout
+	 * @param channel Channel, at which the image is located
+	 * @param timepoint Timepoint, at which the image is located
+	 * @param angle Angle, at which the image is located
+	 * @param resolution Resolution, at which the image is located
+	 * @param version Version, at which the image is located (integer identifier
+	 * or "latest")
+	 * @param props [Optional] cached dataset properties
+	 */
+	template <cnpts::Scalar T>
+	void read_image_to_file(const std::string& path,
+	                        FileLayout layout,
+	                        int channel,
+	                        int timepoint,
+	                        int angle,
+	                        i3d::Vector3d<int> resolution,
+	                        const std::string& version,
+	                        dataset_props_ptr props = nullptr) const;
+
+	/**
+	 * @brief Export full image into sequence of 2D image files
+	 *
+	 * Slabs are fetched and written concurrently with bounded memory (see
+	 * ImageView::export_image).
+	 *
+	 * @tparam T Scalar used as underlying type for image representation
+	 * @param path_pattern Path of slice files with replacement field of slice
+	 * index (fmt syntax, e.g. "slice_{:04}.tif")
+	 * @param channel Channel, at which the image is located
+	 * @param timepoint Timepoint, at which the image is located
+	 * @param angle Angle, at which the image is located
+	 * @param resolution Resolution, at which the image is located
+	 * @param version Version, at which the image is located (integer identifier
+	 * or "latest")
+	 * @param props [Optional] cached dataset properties
+	 */
+	template <cnpts::FileVoxel T>
+	void export_image(const std::string& path_pattern,
+	                  int channel,
+	                  int timepoint,
+	                  int angle,
+	                  i3d::Vector3d<int> resolution,
+	                  const std::string& version,
+	                  dataset_props_ptr props = nullptr) const;
+
 	/**
 	 * @brief Write block to server
 	 *
@@ -760,6 +1499,116 @@ class Connection {
 	                 const std::string& version,
 	                 dataset_props_ptr props = nullptr) const;
 
+	/**
+	 * @brief Write region to server
+	 *
+	 * Write whole <src> image to server, so that its first voxel is placed at
+	 * <start_point>. The region does not have to be aligned to blocks.
+	 * Partially covered blocks are merged with their content on the server.
+	 *
+	 * @tparam T Scalar used as underlying type for image representation
+	 * @param src Source image
+	 * @param start_point Position of the first voxel of <src> in server image
+	 * @param channel Channel, at which the image is located
+	 * @param timepoint Timepoint, at which the image is located
+	 * @param angle Angle, at which the image is located
+	 * @param resolution Resolution, at which the image is located
+	 * @param version Version, at which the image is located (integer identifier
+	 * or "latest")
+	 * @param props [Optional] cached dataset properties
+	 */
+	template <cnpts::Scalar T>
+	void write_region(const i3d::Image3d<T>& src,
+	                  i3d::Vector3d<int> start_point,
+	                  int channel,
+	                  int timepoint,
+	                  int angle,
+	                  i3d::Vector3d<int> resolution,
+	                  const std::string& version,
+	                  dataset_props_ptr props = nullptr) const;
+
+	/**
+	 * @brief Write region from caller-provided buffer to server
+	 *
+	 * Same as the overload above, blocks are encoded directly from strided
+	 * view <src>.
+	 *
+	 * @tparam T Scalar used as underlying type for image representation
+	 * (may be const-qualified)
+	 * @param src Source view
+	 * @param start_point Position of the first voxel of <src> in server image
+	 * @param channel Channel, at which the image is located
+	 * @param timepoint Timepoint, at which the image is located
+	 * @param angle Angle, at which the image is located
+	 * @param resolution Resolution, at which the image is located
+	 * @param version Version, at which the image is located (integer identifier
+	 * or "latest")
+	 * @param props [Optional] cached dataset properties
+	 */
+	template <cnpts::Scalar T>
+	void write_region(StridedView<T> src,
+	                  i3d::Vector3d<int> start_point,
+	                  int channel,
+	                  int timepoint,
+	                  int angle,
+	                  i3d::Vector3d<int> resolution,
+	                  const std::string& version,
+	                  dataset_props_ptr props = nullptr) const;
+
+	/**
+	 * @brief Import full image from sequence of 2D image files
+	 *
+	 * Slabs are loaded and uploaded concurrently with bounded memory (see
+	 * ImageView::import_image).
+	 *
+	 * @tparam T Scalar used as underlying type for image representation
+	 * @param path_pattern Path of slice files with replacement field of slice
+	 * index (fmt syntax, e.g. "slice_{:04}.tif")
+	 * @param channel Channel, at which the image is located
+	 * @param timepoint Timepoint, at which the image is located
+	 * @param angle Angle, at which the image is located
+	 * @param resolution Resolution, at which the image is located
+	 * @param version Version, at which the image is located (integer identifier
+	 * or "latest")
+	 * @param props [Optional] cached dataset properties
+	 */
+	template <cnpts::FileVoxel T>
+	void import_image(const std::string& path_pattern,
+	                  int channel,
+	                  int timepoint,
+	                  int angle,
+	                  i3d::Vector3d<int> resolution,
+	                  const std::string& version,
+	                  dataset_props_ptr props = nullptr) const;
+
+	/**
+	 * @brief Compute statistics of voxels of region of interest
+	 *
+	 * Blocks are reduced as they arrive, without allocating the image (see
+	 * ImageView::compute_statistics).
+	 *
+	 * @param start_point smallest point of the region
+	 * @param end_point largest point of the region (exclusive)
+	 * @param channel Channel, at which the image is located
+	 * @param timepoint Timepoint, at which the image is located
+	 * @param angle Angle, at which the image is located
+	 * @param resolution Resolution, at which the image is located
+	 * @param version Version, at which the image is located (integer identifier
+	 * or "latest")
+	 * @param options histogram bins and range, resolution level to use
+	 * @param props [Optional] cached dataset properties
+	 * @return Statistics of the region
+	 */
+	Statistics compute_statistics(i3d::Vector3d<int> start_point,
+	                              i3d::Vector3d<int> end_point,
+	                              int channel,
+	                              int timepoint,
+	                              int angle,
+	                              i3d::Vector3d<int> resolution,
+	                              const std::string& version,
+	                              StatisticsOptions options = {},
+	                              dataset_props_ptr props = nullptr) const;
+
 	/**
 	 * @brief Write full image and generate pyramids
 	 *
@@ -789,13 +1638,186 @@ class Connection {
 	                         SamplingMode m,
 	                         dataset_props_ptr props = nullptr) const;
 
-  private:
-	std::string _ip;
-	int _port;
-	std::string _uuid;
-};
+	/**
+	 * @brief Write full image and generate pyramids by integer-factor
+	 * reduction
+	 *
+	 * Same as the overload above, but every level is computed by reducing
+	 * windows of the finer level with selected <ReductionMode> (average, max,
+	 * min, mode, ...), which is cheaper than resampling and suits label
+	 * images as well. Coarser levels are reduced from finer ones, so
+	 * AVERAGE and MODE approximate the full-resolution window (see
+	 * ReductionMode).
+	 *
+	 * @tparam T Scalar used as underlying type for image representation
+	 * @param img Input image in original resolution
+	 * @param channel Channel, at which the image is located
+	 * @param timepoint Timepoint, at which the image is located
+	 * @param angle Angle, at which the image is located
+	 * @param version Version, at which the image is located (integer identifier
+	 * or "latest")
+	 * @param m Reduction used to compute coarser levels
+	 * @param props [Optional] cached dataset properties
+	 */
+	template <cnpts::Scalar T>
+	void write_with_pyramids(const i3d::Image3d<T>& img,
+	                         int channel,
+	                         int timepoint,
+	                         int angle,
+	                         const std::string& version,
+	                         ReductionMode m,
+	                         dataset_props_ptr props = nullptr) const;
 
-} // namespace ds
+	/**
+	 * @brief Stream full-resolution blocks and generate pyramids
+	 *
+	 * Full-resolution image is never held in memory. Blocks are requested from
+	 * <producer> tile by tile, where tile is the smallest region producing
+	 * whole blocks at every resolution level. As soon as a tile is complete,
+	 * blocks of all resolution levels it covers are uploaded (while the next
+	 * tile is being produced).
+	 *
+	 * Tile is limited to details::pyramids::MAX_TILE_VOXELS. Levels which
+	 * would need a larger tile (block or level geometries with large least
+	 * common multiple) are generated afterwards level by level, from the
+	 * already uploaded finer level, in batches of blocks of the same size.
+	 *
+	 * @tparam T Scalar used as underlying type for image representation
+	 * @param producer Callable returning full-resolution block at given
+	 * coordinate
+	 * @param channel Channel, at which the image is located
+	 * @param timepoint Timepoint, at which the image is located
+	 * @param angle Angle, at which the image is located
+	 * @param version Version, at which the image is located (integer identifier
+	 * or "latest")
+	 * @param m Reduction used to compute coarser levels
+	 * @param props [Optional] cached dataset properties
+	 */
+	template <cnpts::Scalar T>
+	void stream_with_pyramids(const block_producer<T>& producer,
+	                          int channel,
+	                          int timepoint,
+	                          int angle,
+	                          const std::string& version,
+	                          ReductionMode m,
+	                          dataset_props_ptr props = nullptr) const;
+
+	/**
+	 * @brief Stream full-resolution image from another view and generate
+	 * pyramids
+	 *
+	 * Same as the overload above, full-resolution blocks are read (in
+	 * batches) from <src>, which has to have the same dimensions as
+	 * full-resolution image of this dataset.
+	 *
+	 * @tparam T Scalar used as underlying type for image representation
+	 * @param src View of the source image
+	 * @param channel Channel, at which the image is located
+	 * @param timepoint Timepoint, at which the image is located
+	 * @param angle Angle, at which the image is located
+	 * @param version Version, at which the image is located (integer identifier
+	 * or "latest")
+	 * @param m Reduction used to compute coarser levels
+	 * @param props [Optional] cached dataset properties
+	 */
+	template <cnpts::Scalar T>
+	void stream_with_pyramids(const ImageView& src,
+	                          int channel,
+	                          int timepoint,
+	                          int angle,
+	                          const std::string& version,
+	                          ReductionMode m,
+	                          dataset_props_ptr props = nullptr) const;
+
+	/**
+	 * @brief Update pyramids after full-resolution blocks were changed
+	 *
+	 * Maps changed full-resolution blocks to affected blocks of each coarser
+	 * resolution level (in the same cascade as write_with_pyramids), reads
+	 * their children from the already updated finer level, recomputes them
+	 * and uploads them. Other blocks are left untouched, so <m> should match
+	 * the mode the pyramids were generated with.
+	 *
+	 * @tparam T Scalar used as underlying type for image representation
+	 * @param coords Coordinates of changed full-resolution blocks
+	 * @param channel Channel, at which the image is located
+	 * @param timepoint Timepoint, at which the image is located
+	 * @param angle Angle, at which the image is located
+	 * @param version Version, at which the image is located (integer identifier
+	 * or "latest")
+	 * @param m Reduction used to compute coarser levels
+	 * @param props [Optional] cached dataset properties
+	 */
+	template <cnpts::Scalar T>
+	void update_pyramids(const std::vector<i3d::Vector3d<int>>& coords,
+	                     int channel,
+	                     int timepoint,
+	                     int angle,
+	                     const std::string& version,
+	                     ReductionMode m,
+	                     dataset_props_ptr props = nullptr) const;
+
+  private:
+	/**
+	 * @brief Generate levels from the finest to the coarsest one and upload
+	 * them
+	 *
+	 * @param downsample callable (source, destination, destination size,
+	 * factor)
+	 */
+	template <cnpts::Scalar T, typename D>
+	void cascade_pyramids(const i3d::Image3d<T>& img,
+	                      int channel,
+	                      int timepoint,
+	                      int angle,
+	                      const std::string& version,
+	                      D&& downsample,
+	                      dataset_props_ptr props) const;
+
+	/**
+	 * @brief Generate and upload pyramids tile by tile
+	 *
+	 * @param fill_tile callable (tile start, tile image to fill)
+	 */
+	template <cnpts::Scalar T, typename F>
+	void stream_tiles(F&& fill_tile,
+	                  int channel,
+	                  int timepoint,
+	                  int angle,
+	                  const std::string& version,
+	                  ReductionMode m,
+	                  dataset_props_ptr props) const;
+
+	/**
+	 * @brief Recompute and upload given blocks of one resolution level
+	 *
+	 * Parents are processed in batches, whose finer windows together do
+	 * not exceed details::pyramids::MAX_TILE_VOXELS.
+	 *
+	 * @param parents blocks to recompute at <resolution>
+	 * @param source finer level the blocks are computed from
+	 */
+	template <cnpts::Scalar T>
+	void update_level(const std::vector<i3d::Vector3d<int>>& parents,
+	                  i3d::Vector3d<int> source,
+	                  i3d::Vector3d<int> resolution,
+	                  int channel,
+	                  int timepoint,
+	                  int angle,
+	                  const std::string& version,
+	                  ReductionMode m,
+	                  dataset_props_ptr props) const;
+
+	std::string _ip;
+	int _port;
+	std::string _uuid;
+
+	/* Buffers (and other state) shared by all views of this connection */
+	std::shared_ptr<details::Context> _context =
+	    std::make_shared<details::Context>();
+};
+
+} // namespace ds
 
 /* ================= IMPLEMENTATION FOLLOWS ======================== */
 
@@ -809,6 +1831,46 @@ namespace ds {
 	    details::get_dataset_properties(dataset_url));
 }
 
+/* inline */ void set_log_level(LogLevel level) {
+	if constexpr (details::_LOG_)
+		details::log::Logger::instance().set_level(level);
+}
+
+/* inline */ void set_log_sink(LogSink sink) {
+	if constexpr (details::_LOG_)
+		details::log::Logger::instance().set_sink(std::move(sink));
+}
+
+/* inline */ void add_log_sink(LogSink sink) {
+	if constexpr (details::_LOG_)
+		details::log::Logger::instance().add_sink(std::move(sink));
+}
+
+/* inline */ void flush_log() {
+	if constexpr (details::_LOG_)
+		details::log::Logger::instance().flush();
+}
+
+/* inline */ void start_tracing() { details::trace::Tracer::instance().start(); }
+
+/* inline */ void stop_tracing() { details::trace::Tracer::instance().stop(); }
+
+/* inline */ std::string get_trace() {
+	return details::trace::Tracer::instance().to_json();
+}
+
+/* inline */ void save_trace(const std::string& path) {
+	std::ofstream file(path);
+	file << get_trace();
+
+	/* Closed first, so that errors of the final flush are reported too,
+	 * iostreams do not set errno reliably */
+	file.close();
+	if (file.fail())
+		throw std::system_error(std::make_error_code(std::errc::io_error),
+		                        fmt::format("Cannot write trace to {}", path));
+}
+
 template <cnpts::Scalar T>
 i3d::Image3d<T> read_image(const std::string& ip,
                            int port,
@@ -824,6 +1886,21 @@ i3d::Image3d<T> read_image(const std::string& ip,
 	    .read_image<T>(props);
 }
 
+/* inline */ AnyImage
+read_image_any(const std::string& ip,
+               int port,
+               const std::string& uuid,
+               int channel /* = 0 */,
+               int timepoint /* = 0 */,
+               int angle /* = 0 */,
+               i3d::Vector3d<int> resolution /* = {1, 1, 1} */,
+               const std::string& version /* = "latest" */,
+               dataset_props_ptr props /* = nullptr */) {
+	return ImageView(ip, port, uuid, channel, timepoint, angle, resolution,
+	                 version)
+	    .read_image_any(props);
+}
+
 template <cnpts::Scalar T>
 void write_image(const i3d::Image3d<T>& img,
                  const std::string& ip,
@@ -866,12 +1943,89 @@ ImageView::ImageView(std::string ip,
                      std::string version)
     : _ip(std::move(ip)), _port(port), _uuid(std::move(uuid)),
       _channel(channel), _timepoint(timepoint), _angle(angle),
-      _resolution(resolution), _version(std::move(version)) {}
+      _resolution(resolution), _version(std::move(version)) {
+	_context->endpoints = std::make_shared<details::EndpointPool>(
+	    std::vector<Endpoint>{{_ip, _port}});
+}
 
 dataset_props_ptr ImageView::get_properties() const {
-	return get_dataset_properties(_ip, _port, _uuid);
+	auto start = details::MetricsRegistry::now();
+	details::EndpointPool& endpoints = *_context->endpoints;
+	dataset_props_ptr props =
+	    details::requests::with_failover(endpoints, [&](std::size_t i) {
+		    const Endpoint& endpoint = endpoints.endpoint(i);
+		    return get_dataset_properties(endpoint.ip, endpoint.port, _uuid);
+	    });
+	_context->metrics.record("properties.latency",
+	                         details::MetricsRegistry::now() - start);
+	return props;
+}
+
+inline void ImageView::set_batch_limits(const BatchLimits& limits) {
+	_context->downloads.set_limits(limits);
+	_context->uploads.set_limits(limits);
 }
 
+inline BatchLimits ImageView::get_batch_limits() const {
+	return _context->uploads.get_limits();
+}
+
+inline void ImageView::set_retry_policy(const RetryPolicy& policy) {
+	_context->retries.set_policy(policy);
+}
+
+inline RetryPolicy ImageView::get_retry_policy() const {
+	return _context->retries.get_policy();
+}
+
+inline void ImageView::set_hedging_policy(const HedgingPolicy& policy) {
+	_context->hedger.set_policy(policy);
+}
+
+inline HedgingPolicy ImageView::get_hedging_policy() const {
+	return _context->hedger.get_policy();
+}
+
+inline void
+ImageView::set_concurrency_policy(const ConcurrencyPolicy& policy) {
+	const details::EndpointPool& endpoints = *_context->endpoints;
+	for (std::size_t i = 0; i < endpoints.size(); ++i)
+		endpoints.concurrency(i).set_policy(policy);
+}
+
+inline ConcurrencyPolicy ImageView::get_concurrency_policy() const {
+	return _context->endpoints->concurrency(0).get_policy();
+}
+
+inline std::size_t ImageView::get_concurrency_limit() const {
+	const details::EndpointPool& endpoints = *_context->endpoints;
+	std::size_t out = 0;
+	for (std::size_t i = 0; i < endpoints.size(); ++i)
+		out += endpoints.concurrency(i).limit();
+	return out;
+}
+
+inline void ImageView::set_timeouts(const Timeouts& timeouts) {
+	_context->set_timeouts(timeouts);
+}
+
+inline Timeouts ImageView::get_timeouts() const {
+	return _context->get_timeouts();
+}
+
+inline ImageView
+ImageView::with_cancellation(CancellationToken token) const {
+	ImageView out = *this;
+	out._cancellation = std::move(token);
+	return out;
+}
+
+inline Metrics ImageView::get_metrics() const {
+	return _context->metrics.snapshot();
+}
+
+inline void ImageView::reset_metrics() { _context->metrics.reset(); }
+
 template <cnpts::Scalar T>
 i3d::Image3d<T>
 ImageView::read_block(i3d::Vector3d<int> coord,
@@ -908,10 +2062,26 @@ ImageView::read_blocks(const std::vector<i3d::Vector3d<int>>& coords,
 	if (!props)
 		props = get_properties();
 
-	/* Process blocks one by one */
-	std::vector<i3d::Image3d<T>> out;
-	for (auto coord : coords)
-		out.push_back(read_block<T>(coord));
+	if (!details::matches_image_type(i3d::Image3d<T>{}, props->voxel_type))
+		throw std::logic_error("Server and i3d image type does not match\n");
+
+	check_view(*props);
+
+	if (!details::check_block_coords(
+	        coords, props->get_img_dimensions(_resolution),
+	        props->get_block_dimensions(_resolution)))
+		throw std::out_of_range("Blocks out of range");
+
+	/* All blocks are fetched in batches, each into its own image */
+	std::vector<i3d::Image3d<T>> out(coords.size());
+	fetch_blocks(coords, *props,
+	             [&](std::size_t i, std::span<const char> data,
+	                 i3d::Vector3d<int> block_size) {
+		             out[i].MakeRoom(block_size);
+		             details::data_manip::read_data(data, props->voxel_type,
+		                                            out[i], {0, 0, 0},
+		                                            block_size);
+	             });
 
 	return out;
 }
@@ -929,32 +2099,9 @@ void ImageView::read_blocks(const std::vector<i3d::Vector3d<int>>& coords,
 	if (!details::matches_image_type(dest, props->voxel_type))
 		throw std::logic_error("Server and i3d image type does not match\n");
 
-	auto resolutions = props->get_all_resolutions();
-	if (std::ranges::find(resolutions, _resolution) == end(resolutions))
-		throw std::logic_error(
-		    fmt::format("Resolution {} not supported by server\n",
-		                details::to_string(_resolution))
-		        .c_str());
-
-	if (!props->timepoint_ids.contains(_timepoint))
-		throw std::logic_error(
-		    fmt::format("Timepoint {} not supported by server\n",
-		                details::to_string(_timepoint))
-		        .c_str());
-
-	if (_channel >= props->channels)
-		throw std::logic_error(
-		    fmt::format("Channel {} not supported by server\n",
-		                details::to_string(_channel))
-		        .c_str());
-
-	if (_angle >= props->angles)
-		throw std::logic_error(fmt::format("Angle {} not supported by server\n",
-		                                   details::to_string(_angle))
-		                           .c_str());
+	check_view(*props);
 
 	/* Fetched properties from server */
-	std::string dataset_url = details::get_dataset_url(_ip, _port, _uuid);
 	i3d::Vector3d<int> block_dim = props->get_block_dimensions(_resolution);
 
 	i3d::Vector3d<int> img_dim = props->get_img_dimensions(_resolution);
@@ -965,34 +2112,13 @@ void ImageView::read_blocks(const std::vector<i3d::Vector3d<int>>& coords,
 	if (!details::check_block_coords(coords, img_dim, block_dim))
 		throw std::out_of_range("Blocks out of range");
 
-	/* prepare request url */
-	std::string session_url = details::requests::session_url_request(
-	    dataset_url, _resolution, _version);
-
-	if (session_url.ends_with('/'))
-		session_url.pop_back();
-
-	std::vector<std::pair<std::string, std::vector<std::size_t>>> requests =
-	    details::create_requests(coords, session_url, _timepoint, _channel,
-	                             _angle);
-
-	for (const auto& [req, idxs] : requests) {
-		auto [data, response] = details::requests::make_request(req);
-
-		std::size_t start_i = 0;
-		for (std::size_t i : idxs) {
-			i3d::Vector3d<int> block_size =
-			    props->get_block_size(coords[i], _resolution);
-			std::size_t data_size = details::data_manip::get_block_data_size(
-			    block_size, props->voxel_type);
-
-			details::data_manip::read_data(
-			    std::span(data.begin() + start_i, data_size), props->voxel_type,
-			    dest, offsets[i], block_size);
-
-			start_i += data_size;
-		}
-	}
+	fetch_blocks(coords, *props,
+	             [&](std::size_t i, std::span<const char> data,
+	                 i3d::Vector3d<int> block_size) {
+		             details::data_manip::read_data(data, props->voxel_type,
+		                                            dest, offsets[i],
+		                                            block_size);
+	             });
 }
 
 template <cnpts::Scalar T>
@@ -1003,20 +2129,10 @@ ImageView::read_region(i3d::Vector3d<int> start_point,
 	if (!props)
 		props = get_properties();
 
-	i3d::Vector3d img_dim = props->get_img_dimensions(_resolution);
-	i3d::Vector3d block_dim = props->get_block_dimensions(_resolution);
-
-	std::vector<i3d::Vector3d<int>> coords = details::get_intercepted_blocks(
-	    start_point, end_point, img_dim, block_dim);
-
-	std::vector<i3d::Vector3d<int>> offsets;
-	for (auto coord : coords)
-		offsets.emplace_back(coord * block_dim - start_point);
-
 	i3d::Image3d<T> out_img;
 	out_img.MakeRoom(end_point - start_point);
 
-	read_blocks(coords, out_img, offsets, props);
+	read_region(start_point, details::data_manip::make_view(out_img), props);
 	return out_img;
 }
 
@@ -1026,182 +2142,1206 @@ void ImageView::read_region(i3d::Vector3d<int> start_point,
                             i3d::Image3d<T>& dest,
                             i3d::Vector3d<int> offset /* = {0, 0, 0} */,
                             dataset_props_ptr props /* = nullptr */) const {
-	auto temp_img = read_region<T>(start_point, end_point, props);
+	if (!lt(offset + end_point - start_point,
+	        i3d::Vector3d<int>(dest.GetSize()) + 1))
+		throw std::out_of_range("Region does not fit into destination image");
+
+	/* Decode directly to the destination */
+	read_region(start_point,
+	            details::data_manip::make_view(dest).subview(
+	                offset, end_point - start_point),
+	            props);
+}
+
+template <cnpts::Scalar T>
+void ImageView::read_region(i3d::Vector3d<int> start_point,
+                            StridedView<T> dest,
+                            dataset_props_ptr props /* = nullptr */) const {
+	if (!props)
+		props = get_properties();
+
+	if (!details::matches_image_type(i3d::Image3d<T>{}, props->voxel_type))
+		throw std::logic_error("Server and i3d image type does not match\n");
+
+	if (!dest.fits())
+		throw std::out_of_range("Strided view exceeds its buffer");
+
+	check_view(*props);
+
+	i3d::Vector3d<int> img_dim = props->get_img_dimensions(_resolution);
+	i3d::Vector3d<int> block_dim = props->get_block_dimensions(_resolution);
+
+	std::vector<i3d::Vector3d<int>> coords = details::get_intercepted_blocks(
+	    start_point, start_point + dest.size, img_dim, block_dim);
+
+	fetch_blocks(coords, *props,
+	             [&](std::size_t i, std::span<const char> data,
+	                 i3d::Vector3d<int> block_size) {
+		             details::data_manip::read_data(
+		                 data, props->voxel_type, dest,
+		                 coords[i] * block_dim - start_point, block_size);
+	             });
+}
+
+template <cnpts::Scalar T>
+i3d::Image3d<T>
+ImageView::read_image(dataset_props_ptr props /* = nullptr */) const {
+	if (!props)
+		props = get_properties();
+
+	i3d::Vector3d img_dim = props->get_img_dimensions(_resolution);
+	return read_region<T>(0, img_dim, props);
+}
+
+inline AnyImage
+ImageView::read_region_any(i3d::Vector3d<int> start_point,
+                           i3d::Vector3d<int> end_point,
+                           dataset_props_ptr props /* = nullptr */) const {
+	if (!props)
+		props = get_properties();
+
+	return visit_voxel_type(props->voxel_type, [&](auto type) -> AnyImage {
+		using T = typename decltype(type)::type;
+		return read_region<T>(start_point, end_point, props);
+	});
+}
+
+inline AnyImage
+ImageView::read_image_any(dataset_props_ptr props /* = nullptr */) const {
+	if (!props)
+		props = get_properties();
+
+	return read_region_any(0, props->get_img_dimensions(_resolution), props);
+}
+
+template <cnpts::Scalar T>
+void ImageView::read_image_to_file(const std::string& path,
+                                   FileLayout layout /* = FileLayout::RAW */,
+                                   dataset_props_ptr props /* = nullptr */
+) const {
+	if (!props)
+		props = get_properties();
+
+	if (!details::matches_image_type(i3d::Image3d<T>{}, props->voxel_type))
+		throw std::logic_error("Server and i3d image type does not match\n");
+
+	check_view(*props);
+
+	i3d::Vector3d<int> img_dim = props->get_img_dimensions(_resolution);
+	i3d::Vector3d<int> block_dim = props->get_block_dimensions(_resolution);
+	i3d::Vector3d<int> block_count = props->get_block_count(_resolution);
+
+	std::string header;
+	if (layout == FileLayout::NRRD)
+		header = details::files::get_nrrd_header(*props, _resolution);
+
+	std::size_t voxel_count =
+	    std::size_t(img_dim.x) * std::size_t(img_dim.y) * std::size_t(img_dim.z);
+	details::files::MappedFile file(path,
+	                                header.size() + voxel_count * sizeof(T));
+	std::ranges::copy(header, file.data());
+
+	StridedView<T> dest = StridedView<T>::contiguous(
+	    std::span<T>(reinterpret_cast<T*>(file.data() + header.size()),
+	                 voxel_count),
+	    img_dim);
+
+	/* Blocks in file order, so each stream fills contiguous part of file */
+	std::vector<i3d::Vector3d<int>> coords;
+	for (int z = 0; z < block_count.z; ++z)
+		for (int y = 0; y < block_count.y; ++y)
+			for (int x = 0; x < block_count.x; ++x)
+				coords.emplace_back(x, y, z);
+
+	if (!details::check_block_coords(coords, img_dim, block_dim))
+		throw std::out_of_range("Blocks out of range");
+
+	std::size_t chunk_count =
+	    std::min(coords.size(), details::files::FILE_READ_STREAMS * 4);
+	details::parallel_for(
+	    chunk_count,
+	    [&](std::size_t chunk) {
+		    std::vector<i3d::Vector3d<int>> chunk_coords(
+		        coords.begin() + chunk * coords.size() / chunk_count,
+		        coords.begin() + (chunk + 1) * coords.size() / chunk_count);
+
+		    fetch_blocks(chunk_coords, *props,
+		                 [&](std::size_t i, std::span<const char> data,
+		                     i3d::Vector3d<int> block_size) {
+			                 details::data_manip::read_data(
+			                     data, props->voxel_type, dest,
+			                     chunk_coords[i] * block_dim, block_size);
+		                 });
+	    },
+	    details::files::FILE_READ_STREAMS);
+
+	file.sync();
+}
+
+template <cnpts::FileVoxel T>
+void ImageView::export_image(const std::string& path_pattern,
+                             dataset_props_ptr props /* = nullptr */) const {
+	if (!props)
+		props = get_properties();
+
+	if (!details::matches_image_type(i3d::Image3d<T>{}, props->voxel_type))
+		throw std::logic_error("Server and i3d image type does not match\n");
+
+	check_view(*props);
+
+	std::string first_path = details::files::get_slice_path(path_pattern, 0);
+	if (first_path == details::files::get_slice_path(path_pattern, 1))
+		throw std::logic_error(
+		    "Path pattern does not contain slice index: " + path_pattern);
+
+	i3d::FileFormat format = i3d::GuessFileFormat(first_path.c_str());
+	if (format == i3d::IMG_UNKNOWN)
+		throw std::logic_error("Unknown image file format: " + first_path);
+
+	i3d::Vector3d<int> img_dim = props->get_img_dimensions(_resolution);
+	i3d::Vector3d<int> block_dim = props->get_block_dimensions(_resolution);
+
+	/* Slabs are one block thick, so every block is fetched exactly once */
+	std::future<void> pending;
+	for (int z = 0; z < img_dim.z; z += block_dim.z) {
+		i3d::Vector3d<int> slab_end = {img_dim.x, img_dim.y,
+		                               std::min(img_dim.z, z + block_dim.z)};
+		auto slab = std::make_shared<i3d::Image3d<T>>(
+		    read_region<T>({0, 0, z}, slab_end, props));
+
+		/* Write this slab while the next one is being fetched */
+		if (pending.valid())
+			pending.get();
+		pending = std::async(std::launch::async, [slab, z, format,
+		                                          &path_pattern]() {
+			details::files::write_slices(*slab, path_pattern, z, format);
+		});
+	}
+
+	if (pending.valid())
+		pending.get();
+}
+
+template <cnpts::Scalar T>
+void ImageView::write_block(const i3d::Image3d<T>& src,
+                            i3d::Vector3d<int> coord,
+                            i3d::Vector3d<int> src_offset /*  = {0, 0, 0} */,
+                            dataset_props_ptr props /* = nullptr */) const {
+	write_blocks(src, {coord}, {src_offset}, props);
+}
+
+template <cnpts::Scalar T>
+void ImageView::write_blocks(const i3d::Image3d<T>& src,
+                             const std::vector<i3d::Vector3d<int>>& coords,
+                             const std::vector<i3d::Vector3d<int>>& src_offsets,
+                             dataset_props_ptr props /* = nullptr */) const {
+
+	if (!props)
+		props = get_properties();
+
+	if (!details::matches_image_type(src, props->voxel_type))
+		throw std::logic_error("Server and i3d image type does not match\n");
+
+	check_view(*props);
+
+	/* Fetch server properties */
+	i3d::Vector3d<int> block_dim = props->get_block_dimensions(_resolution);
+	i3d::Vector3d<int> img_dim = props->get_img_dimensions(_resolution);
+
+	/* Error checking (when not in debug, all checks automatically return
+	 * true)*/
+	if (coords.size() != src_offsets.size())
+		throw std::logic_error("Count of coordinates != count of offsets");
+
+	if (!details::check_block_coords(coords, img_dim, block_dim))
+		throw std::out_of_range("Blocks out of range");
+
+	upload_blocks(coords, *props,
+	              [&](std::size_t i, std::span<char> data,
+	                  i3d::Vector3d<int> block_size) {
+		              details::data_manip::write_data(
+		                  src, src_offsets[i], data, props->voxel_type,
+		                  block_size);
+	              });
+}
+
+template <cnpts::Scalar T>
+void ImageView::write_image(const i3d::Image3d<T>& img,
+                            dataset_props_ptr props /* = nullptr */) const {
+
+	/* Fetch image properties from server */
+	if (!props)
+		props = get_properties();
+
+	auto resolutions = props->get_all_resolutions();
+	if (std::ranges::find(resolutions, _resolution) == end(resolutions) ||
+	    !eq(props->get_img_dimensions(_resolution), img.GetSize()))
+		throw std::logic_error("Size of server and i3d image does not match\n");
+
+	i3d::Vector3d<int> block_dim = props->get_block_dimensions(_resolution);
+	i3d::Vector3d<int> img_dim = props->get_img_dimensions(_resolution);
+	i3d::Vector3d<int> block_count =
+	    (img_dim + block_dim - 1) / block_dim; // Ceiling
+
+	/* Prepare coordinates of blocks and offsets to write whole image */
+	std::vector<i3d::Vector3d<int>> blocks;
+	std::vector<i3d::Vector3d<int>> offsets;
+
+	for (int x = 0; x < block_count.x; ++x)
+		for (int y = 0; y < block_count.y; ++y)
+			for (int z = 0; z < block_count.z; ++z) {
+				blocks.emplace_back(x, y, z);
+				offsets.emplace_back(x * block_dim.x, y * block_dim.y,
+				                     z * block_dim.z);
+			}
+
+	/* write whole image */
+	write_blocks(img, blocks, offsets, props);
+}
+
+template <cnpts::Scalar T>
+void ImageView::write_region(const i3d::Image3d<T>& src,
+                             i3d::Vector3d<int> start_point,
+                             dataset_props_ptr props /* = nullptr */) const {
+	write_region(details::data_manip::make_view(src), start_point, props);
+}
+
+template <cnpts::Scalar T>
+void ImageView::write_region(StridedView<T> src,
+                             i3d::Vector3d<int> start_point,
+                             dataset_props_ptr props /* = nullptr */) const {
+	using voxel_t = std::remove_const_t<T>;
+	StridedView<const voxel_t> view = src;
+
+	if (!props)
+		props = get_properties();
+
+	if (!details::matches_image_type(i3d::Image3d<voxel_t>{},
+	                                 props->voxel_type))
+		throw std::logic_error("Server and i3d image type does not match\n");
+
+	if (!view.fits())
+		throw std::out_of_range("Strided view exceeds its buffer");
+
+	check_view(*props);
+
+	i3d::Vector3d<int> img_dim = props->get_img_dimensions(_resolution);
+	i3d::Vector3d<int> block_dim = props->get_block_dimensions(_resolution);
+	i3d::Vector3d<int> end_point = start_point + view.size;
+
+	if (view.size.x <= 0 || view.size.y <= 0 || view.size.z <= 0)
+		return;
+
+	if (!lt(i3d::Vector3d<int>(-1, -1, -1), start_point) ||
+	    !lt(end_point, img_dim + 1))
+		throw std::out_of_range(
+		    fmt::format("Region {} -> {} is out of image boundaries {}",
+		                details::to_string(start_point),
+		                details::to_string(end_point),
+		                details::to_string(img_dim))
+		        .c_str());
+
+	std::vector<i3d::Vector3d<int>> coords = details::get_intercepted_blocks(
+	    start_point, end_point, img_dim, block_dim);
+
+	/* Split blocks to the fully covered and the partially covered ones */
+	std::vector<i3d::Vector3d<int>> full_coords;
+	std::vector<i3d::Vector3d<int>> full_offsets;
+	std::vector<i3d::Vector3d<int>> edge_coords;
+
+	for (auto coord : coords) {
+		i3d::Vector3d<int> block_start = coord * block_dim;
+		i3d::Vector3d<int> block_end =
+		    block_start + props->get_block_size(coord, _resolution);
+
+		if (lt(start_point - 1, block_start) && lt(block_end, end_point + 1)) {
+			full_coords.push_back(coord);
+			full_offsets.push_back(block_start - start_point);
+		} else
+			edge_coords.push_back(coord);
+	}
+
+	/* The first error of either phase is rethrown once both have finished */
+	std::exception_ptr error;
+	std::mutex error_mtx;
+	auto keep_error = [&]() {
+		std::scoped_lock lock(error_mtx);
+		if (!error)
+			error = std::current_exception();
+	};
+
+	/* Fully covered blocks are uploaded while edges are being merged */
+	std::future<void> full_upload;
+	if (!full_coords.empty())
+		full_upload = std::async(std::launch::async, [&]() {
+			try {
+				upload_blocks(full_coords, *props,
+				              [&](std::size_t i, std::span<char> data,
+				                  i3d::Vector3d<int> block_size) {
+					              details::data_manip::write_data(
+					                  view, full_offsets[i], data,
+					                  props->voxel_type, block_size);
+				              });
+			} catch (...) {
+				keep_error();
+			}
+		});
+
+	try {
+		/* Edge blocks are merged in batches of upload requests (planned
+		 * without session url, so a batch may still be sent as two) */
+		std::vector<std::pair<std::string, std::vector<std::size_t>>>
+		    batches = _context->uploads.plan(
+		        edge_coords, get_block_bytes(edge_coords, *props), "",
+		        _timepoint, _channel, _angle);
+
+		/* Batch is uploaded while the next one is being read and merged */
+		std::future<void> pending;
+		for (const auto& [_, idxs] : batches) {
+			/* Blocks of the batch are stacked along z-axis */
+			auto staging = std::make_shared<i3d::Image3d<voxel_t>>();
+			staging->MakeRoom(block_dim.x, block_dim.y,
+			                  block_dim.z * int(idxs.size()));
+
+			std::vector<i3d::Vector3d<int>> batch_coords;
+			std::vector<i3d::Vector3d<int>> staging_offsets;
+			for (std::size_t i = 0; i < idxs.size(); ++i) {
+				batch_coords.push_back(edge_coords[idxs[i]]);
+				staging_offsets.emplace_back(0, 0, int(i) * block_dim.z);
+			}
+
+			read_blocks(batch_coords, *staging, staging_offsets, props);
+
+			/* Merge source region into fetched blocks */
+			for (std::size_t i = 0; i < batch_coords.size(); ++i) {
+				i3d::Vector3d<int> block_start = batch_coords[i] * block_dim;
+				i3d::Vector3d<int> block_end =
+				    block_start +
+				    props->get_block_size(batch_coords[i], _resolution);
+
+				i3d::Vector3d<int> from, to;
+				for (int d = 0; d < 3; ++d) {
+					from[d] = std::max(block_start[d], start_point[d]);
+					to[d] = std::min(block_end[d], end_point[d]);
+				}
+
+				for (int z = from.z; z < to.z; ++z)
+					for (int y = from.y; y < to.y; ++y) {
+						const voxel_t* in =
+						    &view.at(from.x - start_point.x, y - start_point.y,
+						             z - start_point.z);
+						voxel_t* out = staging->GetVoxelAddr(
+						    from.x - block_start.x, y - block_start.y,
+						    z - block_start.z + staging_offsets[i].z);
+
+						for (int x = 0; x < to.x - from.x; ++x)
+							out[x] = in[x * view.strides.x];
+					}
+			}
+
+			if (pending.valid())
+				pending.get();
+			check_cancelled();
+			pending = std::async(
+			    std::launch::async,
+			    [this, staging, batch_coords = std::move(batch_coords),
+			     staging_offsets = std::move(staging_offsets), props]() {
+				    write_blocks(*staging, batch_coords, staging_offsets,
+				                 props);
+			    });
+		}
+
+		if (pending.valid())
+			pending.get();
+	} catch (...) {
+		keep_error();
+	}
+
+	if (full_upload.valid())
+		full_upload.get();
+
+	if (error)
+		std::rethrow_exception(error);
+}
+
+template <cnpts::FileVoxel T>
+void ImageView::import_image(const std::string& path_pattern,
+                             dataset_props_ptr props /* = nullptr */) const {
+	if (!props)
+		props = get_properties();
+
+	if (!details::matches_image_type(i3d::Image3d<T>{}, props->voxel_type))
+		throw std::logic_error("Server and i3d image type does not match\n");
+
+	check_view(*props);
+
+	if (details::files::get_slice_path(path_pattern, 0) ==
+	    details::files::get_slice_path(path_pattern, 1))
+		throw std::logic_error(
+		    "Path pattern does not contain slice index: " + path_pattern);
+
+	i3d::Vector3d<int> img_dim = props->get_img_dimensions(_resolution);
+	i3d::Vector3d<int> block_dim = props->get_block_dimensions(_resolution);
+
+	/* Slabs are one block thick, so only complete blocks are uploaded */
+	std::future<void> pending;
+	for (int z = 0; z < img_dim.z; z += block_dim.z) {
+		auto slab = std::make_shared<i3d::Image3d<T>>();
+		slab->MakeRoom(img_dim.x, img_dim.y,
+		               std::min(img_dim.z, z + block_dim.z) - z);
+		details::files::read_slices(*slab, path_pattern, z);
+
+		/* Upload this slab while the next one is being loaded */
+		if (pending.valid())
+			pending.get();
+		check_cancelled();
+		pending = std::async(std::launch::async, [this, slab, z, props]() {
+			write_region(*slab, {0, 0, z}, props);
+		});
+	}
+
+	if (pending.valid())
+		pending.get();
+}
+
+template <cnpts::Scalar T, typename F>
+void ImageView::apply_filter(F&& filter,
+                             const ImageView& target,
+                             TilingPolicy policy /* = {} */,
+                             dataset_props_ptr props /* = nullptr */) const {
+	if (!props)
+		props = get_properties();
+
+	if (!details::matches_image_type(i3d::Image3d<T>{}, props->voxel_type))
+		throw std::logic_error("Server and i3d image type does not match\n");
+
+	check_view(*props);
+
+	if (!lt(i3d::Vector3d<int>(0, 0, 0), policy.tile_blocks) ||
+	    !lt(i3d::Vector3d<int>(-1, -1, -1), policy.halo))
+		throw std::logic_error("Tiles have to be non-empty and halo "
+		                       "non-negative");
+
+	i3d::Vector3d<int> img_dim = props->get_img_dimensions(_resolution);
+	i3d::Vector3d<int> block_dim = props->get_block_dimensions(_resolution);
 
-	// Copy to desired location
-	for (std::size_t x = 0; x < temp_img.GetSizeX(); ++x)
-		for (std::size_t y = 0; y < temp_img.GetSizeY(); ++y)
-			for (std::size_t z = 0; z < temp_img.GetSizeZ(); ++z)
-				dest.SetVoxel(x + offset.x, y + offset.y, z + offset.z,
-				              temp_img.GetVoxel({x, y, z}));
+	/* Views of the same connection and dataset share the properties */
+	dataset_props_ptr target_props =
+	    target._context == _context && target._uuid == _uuid
+	        ? props
+	        : target.get_properties();
+	if (target_props->get_img_dimensions(target._resolution) != img_dim)
+		throw std::logic_error(
+		    fmt::format("Target image dimensions {} differ from {}",
+		                details::to_string(target_props->get_img_dimensions(
+		                    target._resolution)),
+		                details::to_string(img_dim)));
+
+	/* Tiles are aligned to blocks, so the written blocks are complete */
+	i3d::Vector3d<int> tile_dim = block_dim * policy.tile_blocks;
+	i3d::Vector3d<int> tile_count = (img_dim + tile_dim - 1) / tile_dim;
+
+	details::parallel_for(
+	    std::size_t(tile_count.x) * std::size_t(tile_count.y) *
+	        std::size_t(tile_count.z),
+	    [&](std::size_t i) {
+		    i3d::Vector3d<int> tile(
+		        int(i % std::size_t(tile_count.x)),
+		        int(i / std::size_t(tile_count.x) % std::size_t(tile_count.y)),
+		        int(i / std::size_t(tile_count.x) / std::size_t(tile_count.y)));
+		    i3d::Vector3d<int> tile_start = tile * tile_dim;
+		    i3d::Vector3d<int> tile_end = min(tile_start + tile_dim, img_dim);
+
+		    i3d::Vector3d<int> read_start =
+		        max(i3d::Vector3d<int>(0, 0, 0), tile_start - policy.halo);
+		    i3d::Vector3d<int> read_end = min(img_dim, tile_end + policy.halo);
+
+		    i3d::Image3d<T> in = read_region<T>(read_start, read_end, props);
+		    i3d::Image3d<T> out;
+		    std::invoke(filter, std::as_const(in), out);
+
+		    if (out.GetSize() != in.GetSize())
+			    throw std::logic_error("Filter has to preserve image size");
+
+		    target.write_region(
+		        details::data_manip::make_view(std::as_const(out))
+		            .subview(tile_start - read_start, tile_end - tile_start),
+		        tile_start, target_props);
+	    },
+	    policy.threads);
 }
 
-template <cnpts::Scalar T>
-i3d::Image3d<T>
-ImageView::read_image(dataset_props_ptr props /* = nullptr */) const {
+inline Statistics
+ImageView::compute_statistics(i3d::Vector3d<int> start_point,
+                              i3d::Vector3d<int> end_point,
+                              StatisticsOptions options /* = {} */,
+                              dataset_props_ptr props /* = nullptr */) const {
 	if (!props)
 		props = get_properties();
 
-	i3d::Vector3d img_dim = props->get_img_dimensions(_resolution);
-	return read_region<T>(0, img_dim, props);
-}
+	/* Smallest region of the other level covering the requested one */
+	if (options.resolution && *options.resolution != _resolution) {
+		ImageView level = *this;
+		level._resolution = *options.resolution;
+		options.resolution.reset();
+
+		i3d::Vector3d<int> fine = start_point * _resolution;
+		i3d::Vector3d<int> fine_end = end_point * _resolution;
+		return level.compute_statistics(
+		    fine / level._resolution,
+		    min((fine_end + level._resolution - 1) / level._resolution,
+		        props->get_img_dimensions(level._resolution)),
+		    options, props);
+	}
 
-template <cnpts::Scalar T>
-void ImageView::write_block(const i3d::Image3d<T>& src,
-                            i3d::Vector3d<int> coord,
-                            i3d::Vector3d<int> src_offset /*  = {0, 0, 0} */,
-                            dataset_props_ptr props /* = nullptr */) const {
-	write_blocks(src, {coord}, {src_offset}, props);
-}
+	check_view(*props);
 
-template <cnpts::Scalar T>
-void ImageView::write_blocks(const i3d::Image3d<T>& src,
-                             const std::vector<i3d::Vector3d<int>>& coords,
-                             const std::vector<i3d::Vector3d<int>>& src_offsets,
-                             dataset_props_ptr props /* = nullptr */) const {
+	i3d::Vector3d<int> img_dim = props->get_img_dimensions(_resolution);
+	i3d::Vector3d<int> block_dim = props->get_block_dimensions(_resolution);
+
+	if (!lt(i3d::Vector3d<int>(-1, -1, -1), start_point) ||
+	    !lt(start_point, end_point) || !lt(end_point, img_dim + 1))
+		throw std::out_of_range(
+		    fmt::format("Region {} -> {} is out of image boundaries {}",
+		                details::to_string(start_point),
+		                details::to_string(end_point),
+		                details::to_string(img_dim))
+		        .c_str());
 
+	if (options.range && !(options.range->first < options.range->second))
+		throw std::logic_error("Histogram range has to be non-empty");
+
+	return visit_voxel_type(props->voxel_type, [&](auto type) {
+		using T = typename decltype(type)::type;
+
+		Statistics out;
+		if (options.range)
+			out = Statistics(options.bins, options.range->first,
+			                 options.range->second);
+		else if constexpr (std::is_integral_v<T> && sizeof(T) <= 2)
+			out = Statistics(options.bins,
+			                 double(std::numeric_limits<T>::lowest()),
+			                 double(std::numeric_limits<T>::max()) + 1);
+		std::mutex out_mtx;
+
+		/* <out> is reassigned by merge under the lock, blocks are recorded
+		 * concurrently without it */
+		std::size_t bins = out.histogram().size();
+		double low = out.low();
+		double high = out.high();
+
+		std::vector<i3d::Vector3d<int>> coords =
+		    details::get_intercepted_blocks(start_point, end_point, img_dim,
+		                                    block_dim);
+		fetch_blocks(coords, *props,
+		             [&](std::size_t i, std::span<const char> data,
+		                 i3d::Vector3d<int> block_size) {
+			             Statistics block(bins, low, high);
+			             details::data_manip::record_data<T>(
+			                 data, props->voxel_type, block,
+			                 end_point - start_point,
+			                 coords[i] * block_dim - start_point, block_size);
+
+			             std::scoped_lock lock(out_mtx);
+			             out.merge(block);
+		             });
+		return out;
+	});
+}
+
+inline Statistics
+ImageView::compute_statistics(StatisticsOptions options /* = {} */,
+                              dataset_props_ptr props /* = nullptr */) const {
 	if (!props)
 		props = get_properties();
 
-	if (!details::matches_image_type(src, props->voxel_type))
-		throw std::logic_error("Server and i3d image type does not match\n");
+	return compute_statistics(0, props->get_img_dimensions(_resolution),
+	                          options, props);
+}
 
-	auto resolutions = props->get_all_resolutions();
+inline void ImageView::check_view(const DatasetProperties& props) const {
+	auto resolutions = props.get_all_resolutions();
 	if (std::ranges::find(resolutions, _resolution) == end(resolutions))
 		throw std::logic_error(
 		    fmt::format("Resolution {} not supported by server\n",
 		                details::to_string(_resolution))
 		        .c_str());
 
-	if (!props->timepoint_ids.contains(_timepoint))
+	if (!props.timepoint_ids.contains(_timepoint))
 		throw std::logic_error(
 		    fmt::format("Timepoint {} not supported by server\n",
 		                details::to_string(_timepoint))
 		        .c_str());
 
-	if (_channel >= props->channels)
+	if (_channel >= props.channels)
 		throw std::logic_error(
 		    fmt::format("Channel {} not supported by server\n",
 		                details::to_string(_channel))
 		        .c_str());
 
-	if (_angle >= props->angles)
+	if (_angle >= props.angles)
 		throw std::logic_error(fmt::format("Angle {} not supported by server\n",
 		                                   details::to_string(_angle))
 		                           .c_str());
+}
 
-	/* Fetch server properties */
-	std::string dataset_url = details::get_dataset_url(_ip, _port, _uuid);
-
-	i3d::Vector3d<int> block_dim = props->get_block_dimensions(_resolution);
-	i3d::Vector3d<int> img_dim = props->get_img_dimensions(_resolution);
-
-	/* Error checking (when not in debug, all checks automatically return
-	 * true)*/
-	if (coords.size() != src_offsets.size())
-		throw std::logic_error("Count of coordinates != count of offsets");
+template <typename F>
+void ImageView::fetch_blocks(const std::vector<i3d::Vector3d<int>>& coords,
+                             const DatasetProperties& props,
+                             F&& consume) const {
+	if (coords.empty())
+		return;
+	check_cancelled();
+
+	details::MetricsRegistry& metrics = _context->metrics;
+	Timeouts timeouts = _context->get_timeouts();
+	const CancellationToken* token =
+	    _cancellation ? &*_cancellation : nullptr;
+
+	/* Requests are planned with session url of one endpoint, but sent to
+	 * any of them (with its own session) */
+	details::EndpointPool& endpoints = *_context->endpoints;
+	details::requests::Sessions sessions(endpoints, _uuid, _resolution,
+	                                     _version);
+	auto session_start = details::MetricsRegistry::now();
+	std::string session_url = details::requests::with_failover(
+	    endpoints, [&](std::size_t i) { return sessions.get(i); });
+	metrics.record("read.session",
+	               details::MetricsRegistry::now() - session_start);
+
+	std::vector<std::size_t> block_bytes = get_block_bytes(coords, props);
+	RetryPolicy policy = _context->retries.get_policy();
+
+	/* Requests to be sent (with number of their attempt) */
+	struct Pending {
+		std::string url;
+		std::vector<std::size_t> idxs;
+		int attempt;
+	};
+	std::deque<Pending> pending;
+
+	/* Plan requests of <idxs> and queue them in front of the others */
+	auto enqueue = [&](const std::vector<std::size_t>& idxs, int attempt) {
+		std::vector<i3d::Vector3d<int>> sub_coords;
+		std::vector<std::size_t> sub_bytes;
+		for (std::size_t i : idxs) {
+			sub_coords.push_back(coords[i]);
+			sub_bytes.push_back(block_bytes[i]);
+		}
 
-	if (!details::check_block_coords(coords, img_dim, block_dim))
-		throw std::out_of_range("Blocks out of range");
+		auto requests = _context->downloads.plan(sub_coords, sub_bytes,
+		                                         session_url, _timepoint,
+		                                         _channel, _angle);
+		for (auto it = requests.rbegin(); it != requests.rend(); ++it) {
+			for (std::size_t& i : it->second)
+				i = idxs[i];
+			pending.push_front({std::move(it->first), std::move(it->second),
+			                    attempt});
+		}
+	};
 
-	/* prepare request url */
-	std::string session_url = details::requests::session_url_request(
-	    dataset_url, _resolution, _version);
+	std::vector<std::size_t> all(coords.size());
+	std::iota(all.begin(), all.end(), 0);
+	enqueue(all, 1);
 
-	if (session_url.ends_with('/'))
-		session_url.pop_back();
+	/* Batches are fetched concurrently, requests in flight are limited by
+	 * controllers shared by all connections to the same server */
+	std::mutex pending_mutex;
+	std::condition_variable pending_cv;
+	std::size_t active = 0;
+	bool stop = false;
 
-	std::vector<std::pair<std::string, std::vector<std::size_t>>> requests =
-	    details::create_requests(
-	        coords, session_url, _timepoint, _channel, _angle,
-	        134217728 /
-	            (sizeof(T) * block_dim.x * block_dim.y *
-	             block_dim.z)); //<-- Magic constant empiricaly chosen :D
+	auto fetch = [&](Pending batch) {
+		check_cancelled();
 
-	for (const auto& [req, idxs] : requests) {
 		std::size_t full_size = 0;
-		for (std::size_t i : idxs)
-			full_size += details::data_manip::get_block_data_size(
-			    props->get_block_size(coords[i], _resolution),
-			    props->voxel_type);
+		for (std::size_t i : batch.idxs)
+			full_size += block_bytes[i];
+
+		/* Taken only with a slot, so that workers waiting for one do not
+		 * hold memory */
+		details::BufferPool::Buffer buffer(nullptr, {});
+		std::vector<char>& data = *buffer;
+
+		details::requests::RequestTiming timing;
+		std::string error;
+		int status = 0;
+		{
+			details::EndpointPool::Lease lease = endpoints.acquire();
+			std::size_t e = lease.index();
+			details::ConcurrencyController& concurrency =
+			    endpoints.concurrency(e);
+			const std::string* endpoint_session = sessions.try_get(e, error);
+
+			if (!endpoint_session)
+				endpoints.record_failure(e);
+			else {
+				/* Slots are kept by requests, which may outlive this call
+				 * (when the other request of a hedged race wins), and pool
+				 * outlives them, even if they outlive this connection */
+				struct Hold {
+					std::shared_ptr<details::EndpointPool> pool;
+					details::ConcurrencyController::Slot slot;
+				};
+				auto primary = std::make_shared<Hold>(
+				    Hold{_context->endpoints, concurrency.acquire(token)});
+				const details::ConcurrencyController::Slot& slot =
+				    primary->slot;
+				metrics.record("read.concurrency", slot.in_flight());
+				buffer = _context->buffers.acquire(full_size);
+
+				/* Duplicate of a slow request goes preferably to another
+				 * endpoint and is sent only if it gets a slot there */
+				auto hedge_target =
+				    [&]() -> std::optional<details::requests::HedgeTarget> {
+					std::vector<std::size_t> order = endpoints.order();
+					auto other = std::ranges::find_if(
+					    order, [&](std::size_t i) { return i != e; });
+					std::size_t d = other == order.end() ? e : *other;
+
+					std::string ignored;
+					const std::string* session = sessions.try_get(d, ignored);
+					if (!session)
+						return std::nullopt;
+
+					auto hedge_slot = endpoints.concurrency(d).try_acquire();
+					if (!hedge_slot)
+						return std::nullopt;
+
+					auto hold = std::make_shared<Hold>(
+					    Hold{_context->endpoints, std::move(*hedge_slot)});
+
+					auto finish = [hold, d](
+					                  int hedge_status,
+					                  const details::requests::RequestTiming&
+					                      hedge_timing,
+					                  std::size_t bytes) {
+						details::EndpointPool& pool = *hold->pool;
+						if (hedge_status == 200) {
+							pool.concurrency(d).record_success(
+							    hold->slot, bytes, hedge_timing.first_byte);
+							pool.record_success(d, hedge_timing.first_byte);
+						} else if (hedge_status == 0 || hedge_status >= 500) {
+							pool.concurrency(d).record_congestion(hold->slot);
+							pool.record_failure(d);
+						}
+					};
+					return details::requests::HedgeTarget{
+					    *session + batch.url.substr(session_url.size()),
+					    finish, hold};
+				};
+
+				auto start = std::chrono::steady_clock::now();
+				bool hedge_won = false;
+				status = details::requests::hedged_request(
+				    {*endpoint_session + batch.url.substr(session_url.size()),
+				     {},
+				     primary},
+				    data, error, &timing, timeouts, token, _context->hedger,
+				    metrics, hedge_target, hedge_won);
+
+				/* Winning duplicate has already recorded its endpoint */
+				if (status == 200) {
+					if (!hedge_won) {
+						concurrency.record_success(slot, data.size(),
+						                           timing.first_byte);
+						endpoints.record_success(e, timing.first_byte);
+					}
+					_context->downloads.record(
+					    data.size(), std::chrono::steady_clock::now() - start);
+				} else if ((status == 0 || status >= 500) &&
+				           !(token && token->cancelled())) {
+					concurrency.record_congestion(slot);
+					endpoints.record_failure(e);
+				}
+			}
+		}
 
-		/* Prepare vector representing octet-data (will be send to server) */
-		std::vector<char> data(full_size);
+		if (status != 0 && status != 200) {
+			error = fmt::format("Server responded with status {}", status);
+			if (!details::requests::is_transient(status))
+				throw std::logic_error(error.c_str());
+			data.clear();
+		}
 
-		/* Transform image to octet-data */
+		/* Body longer than requested is malformed (e.g. server disagrees
+		 * about block sizes), so none of its blocks can be trusted */
+		std::size_t usable = data.size();
+		if (data.size() > full_size) {
+			error = fmt::format("Server returned {} bytes, expected {}",
+			                    data.size(), full_size);
+			usable = 0;
+		}
+
+		/* Decode all complete blocks, even of truncated body */
+		auto decode_start = details::MetricsRegistry::now();
+		std::size_t received = 0;
 		std::size_t start_i = 0;
-		for (std::size_t i : idxs) {
-			i3d::Vector3d<int> block_size =
-			    props->get_block_size(coords[i], _resolution);
-			std::size_t data_size = details::data_manip::get_block_data_size(
-			    block_size, props->voxel_type);
+		for (std::size_t i : batch.idxs) {
+			if (start_i + block_bytes[i] > usable)
+				break;
+
+			consume(i,
+			        std::span<const char>(data.data() + start_i,
+			                              block_bytes[i]),
+			        props.get_block_size(coords[i], _resolution));
 
-			details::data_manip::write_data(
-			    src, src_offsets[i],
-			    std::span(data.begin() + start_i, data_size), props->voxel_type,
-			    block_size);
+			start_i += block_bytes[i];
+			++received;
+		}
+
+		metrics.record("read.decode",
+		               details::MetricsRegistry::now() - decode_start);
+		metrics.record("read.first_byte", timing.first_byte);
+		metrics.record("read.transfer", timing.transfer);
+		metrics.record("read.request_bytes", data.size());
+		metrics.add("read.bytes", data.size());
+		metrics.add("read.blocks", received);
+		metrics.add("read.requests", 1);
+
+		if (received == batch.idxs.size())
+			return;
+		check_cancelled();
+
+		/* Request the missing blocks again */
+		if (error.empty())
+			error = fmt::format("Server returned {} bytes, expected {}",
+			                    data.size(), full_size);
+
+		if (batch.attempt >= policy.max_attempts)
+			throw std::logic_error(
+			    fmt::format("Reading of blocks failed after {} attempts: {}",
+			                batch.attempt, error)
+			        .c_str());
+
+		std::chrono::milliseconds delay =
+		    _context->retries.delay(batch.attempt);
+		details::log::warning("{}, retrying {} of {} blocks in {} ms", error,
+		                      batch.idxs.size() - received,
+		                      batch.idxs.size(), delay.count());
+		metrics.add("read.retries", 1);
+		wait_before_retry(delay);
+
+		std::scoped_lock lock(pending_mutex);
+		enqueue({batch.idxs.begin() + std::ptrdiff_t(received),
+		         batch.idxs.end()},
+		        batch.attempt + 1);
+		pending_cv.notify_all();
+	};
+
+	/* Takes batches until all are fetched (retries may add new ones) */
+	auto worker = [&]() {
+		std::unique_lock lock(pending_mutex);
+		for (;;) {
+			pending_cv.wait(lock, [&]() {
+				return stop || !pending.empty() || active == 0;
+			});
+			if (stop || pending.empty())
+				return;
+
+			Pending batch = std::move(pending.front());
+			pending.pop_front();
+			++active;
+			lock.unlock();
+
+			try {
+				fetch(std::move(batch));
+			} catch (...) {
+				lock.lock();
+				stop = true;
+				pending_cv.notify_all();
+				throw;
+			}
 
-			start_i += data_size;
+			lock.lock();
+			--active;
+			pending_cv.notify_all();
 		}
+	};
+
+	std::size_t workers =
+	    std::clamp<std::size_t>(endpoints.max_concurrency(), 1, pending.size());
+	details::parallel_for(
+	    workers, [&](std::size_t) { worker(); }, workers);
+}
+
+inline std::vector<std::size_t>
+ImageView::get_block_bytes(const std::vector<i3d::Vector3d<int>>& coords,
+                           const DatasetProperties& props) const {
+	std::vector<std::size_t> out;
+	out.reserve(coords.size());
+	for (auto coord : coords)
+		out.push_back(std::size_t(details::data_manip::get_block_data_size(
+		    props.get_block_size(coord, _resolution), props.voxel_type)));
+	return out;
+}
+
+inline void ImageView::check_cancelled() const {
+	if (_cancellation)
+		_cancellation->throw_if_cancelled();
+}
 
-		auto [_, response] = details::requests::make_request(
-		    req, Poco::Net::HTTPRequest::HTTP_POST, data,
-		    {{"Content-Type", "application/octet-stream"}});
+inline void
+ImageView::wait_before_retry(std::chrono::milliseconds delay) const {
+	if (!_cancellation) {
+		std::this_thread::sleep_for(delay);
+		return;
 	}
+
+	if (_cancellation->wait_for(delay))
+		_cancellation->throw_if_cancelled();
 }
 
-template <cnpts::Scalar T>
-void ImageView::write_image(const i3d::Image3d<T>& img,
-                            dataset_props_ptr props /* = nullptr */) const {
+template <typename F>
+void ImageView::upload_blocks(const std::vector<i3d::Vector3d<int>>& coords,
+                              const DatasetProperties& props,
+                              F&& produce) const {
+	if (coords.empty())
+		return;
+	check_cancelled();
+
+	details::MetricsRegistry& metrics = _context->metrics;
+	Timeouts timeouts = _context->get_timeouts();
+	const CancellationToken* token =
+	    _cancellation ? &*_cancellation : nullptr;
+
+	/* Requests are planned with session url of one endpoint, but sent to
+	 * any of them (with its own session) */
+	details::EndpointPool& endpoints = *_context->endpoints;
+	details::requests::Sessions sessions(endpoints, _uuid, _resolution,
+	                                     _version);
+	auto session_start = details::MetricsRegistry::now();
+	std::string session_url = details::requests::with_failover(
+	    endpoints, [&](std::size_t i) { return sessions.get(i); });
+	metrics.record("write.session",
+	               details::MetricsRegistry::now() - session_start);
+
+	std::vector<std::size_t> block_bytes = get_block_bytes(coords, props);
+	RetryPolicy policy = _context->retries.get_policy();
+	std::vector<std::pair<std::string, std::vector<std::size_t>>> requests =
+	    _context->uploads.plan(coords, block_bytes, session_url, _timepoint,
+	                           _channel, _angle);
 
-	/* Fetch image properties from server */
-	if (!props)
-		props = get_properties();
+	/* Batches are sent concurrently (see fetch_blocks) */
+	auto send = [&](std::size_t r) {
+		const auto& [req, idxs] = requests[r];
+		check_cancelled();
+		std::size_t full_size = 0;
+		for (std::size_t i : idxs)
+			full_size += block_bytes[i];
 
-	auto resolutions = props->get_all_resolutions();
-	if (std::ranges::find(resolutions, _resolution) == end(resolutions) ||
-	    !eq(props->get_img_dimensions(_resolution), img.GetSize()))
-		throw std::logic_error("Size of server and i3d image does not match\n");
+		/* Octet-data (will be send to server) are prepared once the first
+		 * attempt gets a slot, so that workers waiting for one do not hold
+		 * memory */
+		details::BufferPool::Buffer buffer(nullptr, {});
+		std::vector<char>& data = *buffer;
+		bool encoded = false;
 
-	i3d::Vector3d<int> block_dim = props->get_block_dimensions(_resolution);
-	i3d::Vector3d<int> img_dim = props->get_img_dimensions(_resolution);
-	i3d::Vector3d<int> block_count =
-	    (img_dim + block_dim - 1) / block_dim; // Ceiling
+		/* Transform image to octet-data */
+		auto encode = [&]() {
+			auto encode_start = details::MetricsRegistry::now();
+			buffer = _context->buffers.acquire(full_size);
+			std::size_t start_i = 0;
+			for (std::size_t i : idxs) {
+				i3d::Vector3d<int> block_size =
+				    props.get_block_size(coords[i], _resolution);
+				std::size_t data_size =
+				    details::data_manip::get_block_data_size(block_size,
+				                                             props.voxel_type);
+
+				produce(i, std::span<char>(data.data() + start_i, data_size),
+				        block_size);
+
+				start_i += data_size;
+			}
 
-	/* Prepare coordinates of blocks and offsets to write whole image */
-	std::vector<i3d::Vector3d<int>> blocks;
-	std::vector<i3d::Vector3d<int>> offsets;
+			metrics.record("write.encode",
+			               details::MetricsRegistry::now() - encode_start);
+			encoded = true;
+		};
+
+		/* Sending of the body is included in time to first byte */
+		details::requests::RequestTiming timing;
+		std::vector<char> response_body;
+		for (int attempt = 1;; ++attempt) {
+			std::string error;
+			int status = 0;
+			{
+				details::EndpointPool::Lease lease = endpoints.acquire();
+				std::size_t e = lease.index();
+				details::ConcurrencyController& concurrency =
+				    endpoints.concurrency(e);
+				const std::string* endpoint_session =
+				    sessions.try_get(e, error);
+
+				if (!endpoint_session)
+					endpoints.record_failure(e);
+				else {
+					details::ConcurrencyController::Slot slot =
+					    concurrency.acquire(token);
+					metrics.record("write.concurrency", slot.in_flight());
+					if (!encoded)
+						encode();
+
+					auto start = std::chrono::steady_clock::now();
+					status = details::requests::try_request(
+					    *endpoint_session + req.substr(session_url.size()),
+					    response_body, error,
+					    Poco::Net::HTTPRequest::HTTP_POST, data,
+					    {{"Content-Type", "application/octet-stream"}},
+					    &timing, timeouts, token);
+
+					if (status >= 200 && status < 300) {
+						concurrency.record_success(slot, data.size(),
+						                           timing.first_byte, true);
+						endpoints.record_success(e, timing.first_byte);
+						_context->uploads.record(
+						    data.size(),
+						    std::chrono::steady_clock::now() - start);
+					} else if ((status == 0 || status >= 500) &&
+					           !(token && token->cancelled())) {
+						concurrency.record_congestion(slot);
+						endpoints.record_failure(e);
+					}
+				}
+			}
 
-	for (int x = 0; x < block_count.x; ++x)
-		for (int y = 0; y < block_count.y; ++y)
-			for (int z = 0; z < block_count.z; ++z) {
-				blocks.emplace_back(x, y, z);
-				offsets.emplace_back(x * block_dim.x, y * block_dim.y,
-				                     z * block_dim.z);
+			if (status >= 200 && status < 300)
+				break;
+
+			/* Writing of a block is idempotent, the batch is sent again */
+			check_cancelled();
+			if (status != 0) {
+				error = fmt::format("Server responded with status {}", status);
+				if (!details::requests::is_transient(status))
+					throw std::logic_error(error.c_str());
 			}
 
-	/* write whole image */
-	write_blocks(img, blocks, offsets, props);
+			if (attempt >= policy.max_attempts)
+				throw std::logic_error(
+				    fmt::format("Writing of blocks failed after {} attempts: {}",
+				                attempt, error)
+				        .c_str());
+
+			std::chrono::milliseconds delay = _context->retries.delay(attempt);
+			details::log::warning("{}, retrying {} blocks in {} ms", error,
+			                      idxs.size(), delay.count());
+			metrics.add("write.retries", 1);
+			wait_before_retry(delay);
+		}
+
+		metrics.record("write.first_byte", timing.first_byte);
+		metrics.record("write.transfer", timing.transfer);
+		metrics.record("write.request_bytes", data.size());
+		metrics.add("write.bytes", data.size());
+		metrics.add("write.blocks", idxs.size());
+		metrics.add("write.requests", 1);
+	};
+
+	std::size_t workers = std::clamp<std::size_t>(endpoints.max_concurrency(),
+	                                              1, requests.size());
+	details::parallel_for(requests.size(), send, workers);
 }
 
 /* ===================================== Connection */
 
 Connection::Connection(std::string ip, int port, std::string uuid)
-    : _ip(std::move(ip)), _port(port), _uuid(std::move(uuid)) {}
+    : _ip(std::move(ip)), _port(port), _uuid(std::move(uuid)) {
+	_context->endpoints = std::make_shared<details::EndpointPool>(
+	    std::vector<Endpoint>{{_ip, _port}});
+}
+
+inline Connection::Connection(std::vector<Endpoint> endpoints,
+                              std::string uuid)
+    : _ip(endpoints.empty() ? "" : endpoints.front().ip),
+      _port(endpoints.empty() ? 0 : endpoints.front().port),
+      _uuid(std::move(uuid)) {
+	_context->endpoints =
+	    std::make_shared<details::EndpointPool>(std::move(endpoints));
+}
 
 ImageView Connection::get_view(int channel,
                                int timepoint,
                                int angle,
                                i3d::Vector3d<int> resolution,
                                const std::string& version) const {
-	return ImageView(_ip, _port, _uuid, channel, timepoint, angle, resolution,
-	                 version);
+	ImageView view(_ip, _port, _uuid, channel, timepoint, angle, resolution,
+	               version);
+	view._context = _context;
+	return view;
 }
 
 dataset_props_ptr Connection::get_properties() const {
-	return get_dataset_properties(_ip, _port, _uuid);
+	auto start = details::MetricsRegistry::now();
+	details::EndpointPool& endpoints = *_context->endpoints;
+	dataset_props_ptr props =
+	    details::requests::with_failover(endpoints, [&](std::size_t i) {
+		    const Endpoint& endpoint = endpoints.endpoint(i);
+		    return get_dataset_properties(endpoint.ip, endpoint.port, _uuid);
+	    });
+	_context->metrics.record("properties.latency",
+	                         details::MetricsRegistry::now() - start);
+	return props;
+}
+
+inline void Connection::set_batch_limits(const BatchLimits& limits) {
+	_context->downloads.set_limits(limits);
+	_context->uploads.set_limits(limits);
+}
+
+inline BatchLimits Connection::get_batch_limits() const {
+	return _context->uploads.get_limits();
+}
+
+inline void Connection::set_retry_policy(const RetryPolicy& policy) {
+	_context->retries.set_policy(policy);
+}
+
+inline RetryPolicy Connection::get_retry_policy() const {
+	return _context->retries.get_policy();
+}
+
+inline void Connection::set_hedging_policy(const HedgingPolicy& policy) {
+	_context->hedger.set_policy(policy);
+}
+
+inline HedgingPolicy Connection::get_hedging_policy() const {
+	return _context->hedger.get_policy();
+}
+
+inline void
+Connection::set_concurrency_policy(const ConcurrencyPolicy& policy) {
+	const details::EndpointPool& endpoints = *_context->endpoints;
+	for (std::size_t i = 0; i < endpoints.size(); ++i)
+		endpoints.concurrency(i).set_policy(policy);
+}
+
+inline ConcurrencyPolicy Connection::get_concurrency_policy() const {
+	return _context->endpoints->concurrency(0).get_policy();
+}
+
+inline std::size_t Connection::get_concurrency_limit() const {
+	const details::EndpointPool& endpoints = *_context->endpoints;
+	std::size_t out = 0;
+	for (std::size_t i = 0; i < endpoints.size(); ++i)
+		out += endpoints.concurrency(i).limit();
+	return out;
+}
+
+inline void Connection::set_timeouts(const Timeouts& timeouts) {
+	_context->set_timeouts(timeouts);
+}
+
+inline Timeouts Connection::get_timeouts() const {
+	return _context->get_timeouts();
 }
 
+inline Metrics Connection::get_metrics() const {
+	return _context->metrics.snapshot();
+}
+
+inline void Connection::reset_metrics() { _context->metrics.reset(); }
+
 template <cnpts::Scalar T>
 i3d::Image3d<T>
 Connection::read_block(i3d::Vector3d<int> coord,
@@ -1286,6 +3426,19 @@ void Connection::read_region(i3d::Vector3d<int> start_point,
 	    .read_region<T>(start_point, end_point, dest, offset, props);
 }
 
+template <cnpts::Scalar T>
+void Connection::read_region(i3d::Vector3d<int> start_point,
+                             StridedView<T> dest,
+                             int channel,
+                             int timepoint,
+                             int angle,
+                             i3d::Vector3d<int> resolution,
+                             const std::string& version,
+                             dataset_props_ptr props /* = nullptr */) const {
+	get_view(channel, timepoint, angle, resolution, version)
+	    .read_region(start_point, dest, props);
+}
+
 template <cnpts::Scalar T>
 i3d::Image3d<T>
 Connection::read_image(int channel,
@@ -1298,6 +3451,56 @@ Connection::read_image(int channel,
 	    .read_image<T>(props);
 }
 
+inline AnyImage
+Connection::read_region_any(i3d::Vector3d<int> start_point,
+                            i3d::Vector3d<int> end_point,
+                            int channel,
+                            int timepoint,
+                            int angle,
+                            i3d::Vector3d<int> resolution,
+                            const std::string& version,
+                            dataset_props_ptr props /* = nullptr */) const {
+	return get_view(channel, timepoint, angle, resolution, version)
+	    .read_region_any(start_point, end_point, props);
+}
+
+inline AnyImage
+Connection::read_image_any(int channel,
+                           int timepoint,
+                           int angle,
+                           i3d::Vector3d<int> resolution,
+                           const std::string& version,
+                           dataset_props_ptr props /* = nullptr */) const {
+	return get_view(channel, timepoint, angle, resolution, version)
+	    .read_image_any(props);
+}
+
+template <cnpts::Scalar T>
+void Connection::read_image_to_file(const std::string& path,
+                                    FileLayout layout,
+                                    int channel,
+                                    int timepoint,
+                                    int angle,
+                                    i3d::Vector3d<int> resolution,
+                                    const std::string& version,
+                                    dataset_props_ptr props /* = nullptr */
+) const {
+	get_view(channel, timepoint, angle, resolution, version)
+	    .read_image_to_file<T>(path, layout, props);
+}
+
+template <cnpts::FileVoxel T>
+void Connection::export_image(const std::string& path_pattern,
+                              int channel,
+                              int timepoint,
+                              int angle,
+                              i3d::Vector3d<int> resolution,
+                              const std::string& version,
+                              dataset_props_ptr props /* = nullptr */) const {
+	get_view(channel, timepoint, angle, resolution, version)
+	    .export_image<T>(path_pattern, props);
+}
+
 template <cnpts::Scalar T>
 void Connection::write_block(const i3d::Image3d<T>& src,
                              i3d::Vector3d<int> coord,
@@ -1339,6 +3542,58 @@ void Connection::write_image(const i3d::Image3d<T>& img,
 	    .write_image(img, props);
 }
 
+template <cnpts::Scalar T>
+void Connection::write_region(const i3d::Image3d<T>& src,
+                              i3d::Vector3d<int> start_point,
+                              int channel,
+                              int timepoint,
+                              int angle,
+                              i3d::Vector3d<int> resolution,
+                              const std::string& version,
+                              dataset_props_ptr props /* = nullptr */) const {
+	get_view(channel, timepoint, angle, resolution, version)
+	    .write_region(src, start_point, props);
+}
+
+template <cnpts::Scalar T>
+void Connection::write_region(StridedView<T> src,
+                              i3d::Vector3d<int> start_point,
+                              int channel,
+                              int timepoint,
+                              int angle,
+                              i3d::Vector3d<int> resolution,
+                              const std::string& version,
+                              dataset_props_ptr props /* = nullptr */) const {
+	get_view(channel, timepoint, angle, resolution, version)
+	    .write_region(src, start_point, props);
+}
+
+template <cnpts::FileVoxel T>
+void Connection::import_image(const std::string& path_pattern,
+                              int channel,
+                              int timepoint,
+                              int angle,
+                              i3d::Vector3d<int> resolution,
+                              const std::string& version,
+                              dataset_props_ptr props /* = nullptr */) const {
+	get_view(channel, timepoint, angle, resolution, version)
+	    .import_image<T>(path_pattern, props);
+}
+
+inline Statistics
+Connection::compute_statistics(i3d::Vector3d<int> start_point,
+                               i3d::Vector3d<int> end_point,
+                               int channel,
+                               int timepoint,
+                               int angle,
+                               i3d::Vector3d<int> resolution,
+                               const std::string& version,
+                               StatisticsOptions options /* = {} */,
+                               dataset_props_ptr props /* = nullptr */) const {
+	return get_view(channel, timepoint, angle, resolution, version)
+	    .compute_statistics(start_point, end_point, options, props);
+}
+
 template <cnpts::Scalar T>
 void Connection::write_with_pyramids(
     const i3d::Image3d<T>& img,
@@ -1348,19 +3603,448 @@ void Connection::write_with_pyramids(
     const std::string& version,
     SamplingMode m,
     dataset_props_ptr props /* = nullptr */) const {
+	cascade_pyramids(
+	    img, channel, timepoint, angle, version,
+	    [m](const i3d::Image3d<T>& src, i3d::Image3d<T>& dest,
+	        i3d::Vector3d<int> size, i3d::Vector3d<int> factor) {
+		    details::pyramids::downsample(src, dest, size, factor, m);
+	    },
+	    props);
+}
+
+template <cnpts::Scalar T>
+void Connection::write_with_pyramids(
+    const i3d::Image3d<T>& img,
+    int channel,
+    int timepoint,
+    int angle,
+    const std::string& version,
+    ReductionMode m,
+    dataset_props_ptr props /* = nullptr */) const {
+	cascade_pyramids(
+	    img, channel, timepoint, angle, version,
+	    [m](const i3d::Image3d<T>& src, i3d::Image3d<T>& dest,
+	        i3d::Vector3d<int> size, i3d::Vector3d<int> factor) {
+		    details::pyramids::reduce(src, dest, size, factor, m);
+	    },
+	    props);
+}
+
+template <cnpts::Scalar T, typename D>
+void Connection::cascade_pyramids(const i3d::Image3d<T>& img,
+                                  int channel,
+                                  int timepoint,
+                                  int angle,
+                                  const std::string& version,
+                                  D&& downsample,
+                                  dataset_props_ptr props) const {
+	if (!props)
+		props = get_properties();
+
+	/* Levels are generated from the finest to the coarsest one */
+	std::vector<i3d::Vector3d<int>> resolutions =
+	    details::pyramids::get_generation_order(*props);
+
+	/* Already generated levels (std::list keeps references valid) */
+	std::list<std::pair<i3d::Vector3d<int>, i3d::Image3d<T>>> levels;
+	std::vector<std::pair<i3d::Vector3d<int>, const i3d::Image3d<T>*>> sources{
+	    {{1, 1, 1}, &img}};
+
+	/* Upload of one level runs while the next one is being computed */
+	auto upload = [&](const i3d::Image3d<T>* level, i3d::Vector3d<int> res) {
+		return std::async(std::launch::async, [&, level, res]() {
+			write_image(*level, channel, timepoint, angle, res, version, props);
+		});
+	};
+	std::future<void> pending = upload(&img, {1, 1, 1});
+
+	for (const auto& res : resolutions) {
+		if (res == i3d::Vector3d<int>{1, 1, 1})
+			continue;
+
+		/* Select the coarsest level this one can be computed from */
+		auto source = std::ranges::find_if(
+		    sources.rbegin(), sources.rend(), [&](const auto& src) {
+			    return details::pyramids::get_level_ratio(src.first, res)
+			        .has_value();
+		    });
+		assert(source != sources.rend()); // {1, 1, 1} divides everything
+
+		auto& [_, level] = levels.emplace_back(res, i3d::Image3d<T>{});
+		downsample(*source->second, level, props->get_img_dimensions(res),
+		           *details::pyramids::get_level_ratio(source->first, res));
+		sources.emplace_back(res, &level);
+
+		pending.get();
+		pending = upload(&level, res);
+	}
+
+	pending.get();
+}
+
+template <cnpts::Scalar T>
+void Connection::stream_with_pyramids(const block_producer<T>& producer,
+                                      int channel,
+                                      int timepoint,
+                                      int angle,
+                                      const std::string& version,
+                                      ReductionMode m,
+                                      dataset_props_ptr props /* = nullptr */
+) const {
+	if (!props)
+		props = get_properties();
+
+	i3d::Vector3d<int> img_dim = props->get_img_dimensions({1, 1, 1});
+	i3d::Vector3d<int> block_dim = props->get_block_dimensions({1, 1, 1});
+
+	auto fill_tile = [&](i3d::Vector3d<int> tile_start,
+	                     i3d::Image3d<T>& tile) {
+		i3d::Vector3d<int> tile_end =
+		    tile_start + i3d::Vector3d<int>(tile.GetSize());
+
+		for (auto coord : details::get_intercepted_blocks(
+		         tile_start, tile_end, img_dim, block_dim)) {
+			i3d::Image3d<T> block = producer(coord);
+			i3d::Vector3d<int> block_size =
+			    props->get_block_size(coord, {1, 1, 1});
+
+			if (!eq(block_size, block.GetSize()))
+				throw std::logic_error(
+				    fmt::format("Produced block {} has size {}, expected {}",
+				                details::to_string(coord),
+				                details::to_string(block.GetSize()),
+				                details::to_string(block_size))
+				        .c_str());
+
+			i3d::Vector3d<int> offset = coord * block_dim - tile_start;
+			for (int z = 0; z < block_size.z; ++z)
+				for (int y = 0; y < block_size.y; ++y)
+					std::copy_n(block.GetVoxelAddr(0, y, z), block_size.x,
+					            tile.GetVoxelAddr(offset.x, offset.y + y,
+					                              offset.z + z));
+		}
+	};
+
+	stream_tiles<T>(fill_tile, channel, timepoint, angle, version, m, props);
+}
+
+template <cnpts::Scalar T>
+void Connection::stream_with_pyramids(const ImageView& src,
+                                      int channel,
+                                      int timepoint,
+                                      int angle,
+                                      const std::string& version,
+                                      ReductionMode m,
+                                      dataset_props_ptr props /* = nullptr */
+) const {
+	if (!props)
+		props = get_properties();
+
+	dataset_props_ptr src_props = src.get_properties();
+
+	auto fill_tile = [&](i3d::Vector3d<int> tile_start,
+	                     i3d::Image3d<T>& tile) {
+		tile = src.read_region<T>(
+		    tile_start, tile_start + i3d::Vector3d<int>(tile.GetSize()),
+		    src_props);
+	};
+
+	stream_tiles<T>(fill_tile, channel, timepoint, angle, version, m, props);
+}
+
+template <cnpts::Scalar T, typename F>
+void Connection::stream_tiles(F&& fill_tile,
+                              int channel,
+                              int timepoint,
+                              int angle,
+                              const std::string& version,
+                              ReductionMode m,
+                              dataset_props_ptr props) const {
+	std::vector<i3d::Vector3d<int>> resolutions =
+	    details::pyramids::get_generation_order(*props);
+
+	/* Smallest tile producing whole blocks at every tiled level, levels
+	 * (and all coarser ones) that would exceed the limit are deferred */
+	i3d::Vector3d<int> tile_dim = {1, 1, 1};
+	std::vector<i3d::Vector3d<int>> deferred;
+	for (auto res : resolutions) {
+		i3d::Vector3d<int> block_dim = props->get_block_dimensions(res);
+		i3d::Vector3d<int> grown;
+		for (int i = 0; i < 3; ++i)
+			grown[i] = std::lcm(tile_dim[i], block_dim[i] * res[i]);
+
+		if (!deferred.empty() ||
+		    (res != i3d::Vector3d<int>{1, 1, 1} &&
+		     std::size_t(grown.x) * std::size_t(grown.y) *
+		             std::size_t(grown.z) >
+		         details::pyramids::MAX_TILE_VOXELS)) {
+			deferred.push_back(res);
+			continue;
+		}
+		tile_dim = grown;
+	}
+	if (!deferred.empty())
+		details::log::warning("Levels from {} on need too large tiles, they "
+		                      "are generated level by level",
+		                      details::to_string(deferred.front()));
+	std::erase_if(resolutions, [&](auto res) {
+		return std::ranges::find(deferred, res) != deferred.end();
+	});
+
+	i3d::Vector3d<int> img_dim = props->get_img_dimensions({1, 1, 1});
+	i3d::Vector3d<int> tile_count = (img_dim + tile_dim - 1) / tile_dim;
+
+	using level_list = std::list<std::pair<i3d::Vector3d<int>, i3d::Image3d<T>>>;
+
+	/* Upload blocks of all levels covered by one tile */
+	auto upload = [&](std::shared_ptr<level_list> levels,
+	                  i3d::Vector3d<int> tile_start) {
+		for (const auto& [res, level] : *levels) {
+			if (level.GetImageSize() == 0)
+				continue;
+
+			i3d::Vector3d<int> level_start = tile_start / res;
+			i3d::Vector3d<int> block_dim = props->get_block_dimensions(res);
+
+			std::vector<i3d::Vector3d<int>> coords =
+			    details::get_intercepted_blocks(
+			        level_start,
+			        level_start + i3d::Vector3d<int>(level.GetSize()),
+			        props->get_img_dimensions(res), block_dim);
+
+			std::vector<i3d::Vector3d<int>> offsets;
+			for (auto coord : coords)
+				offsets.push_back(coord * block_dim - level_start);
+
+			get_view(channel, timepoint, angle, res, version)
+			    .write_blocks(level, coords, offsets, props);
+		}
+	};
+
+	std::future<void> pending;
+	for (int x = 0; x < tile_count.x; ++x)
+		for (int y = 0; y < tile_count.y; ++y)
+			for (int z = 0; z < tile_count.z; ++z) {
+				i3d::Vector3d<int> tile_start =
+				    i3d::Vector3d<int>{x, y, z} * tile_dim;
+				auto levels = std::make_shared<level_list>();
+
+				/* Full resolution */
+				auto& [_, full] =
+				    levels->emplace_back(i3d::Vector3d<int>{1, 1, 1},
+				                         i3d::Image3d<T>{});
+				full.MakeRoom(min(tile_dim, img_dim - tile_start));
+				fill_tile(tile_start, full);
+
+				/* Coarser levels, each from the coarsest possible source */
+				for (auto res : resolutions) {
+					if (res == i3d::Vector3d<int>{1, 1, 1})
+						continue;
+
+					/* Dereferenced before emplace_back, reverse iterator
+					 * at rbegin would point to the new level afterwards */
+					const auto& source = *std::ranges::find_if(
+					    levels->rbegin(), levels->rend(), [&](const auto& src) {
+						    return details::pyramids::get_level_ratio(
+						               src.first, res)
+						        .has_value();
+					    });
+
+					i3d::Vector3d<int> level_dim =
+					    props->get_img_dimensions(res);
+					i3d::Vector3d<int> level_start = tile_start / res;
+					i3d::Vector3d<int> level_size = max(
+					    i3d::Vector3d<int>{0, 0, 0},
+					    min(tile_dim / res, level_dim - level_start));
+
+					auto& level =
+					    levels->emplace_back(res, i3d::Image3d<T>{}).second;
+					details::pyramids::reduce(
+					    source.second, level, level_size,
+					    *details::pyramids::get_level_ratio(source.first, res),
+					    m);
+				}
+
+				/* Upload this tile while the next one is being produced */
+				if (pending.valid())
+					pending.get();
+				pending = std::async(std::launch::async, upload, levels,
+				                     tile_start);
+			}
+
+	if (pending.valid())
+		pending.get();
+
+	/* Deferred levels, each from the coarsest already uploaded source */
+	for (auto res : deferred) {
+		auto source = std::ranges::find_if(
+		    resolutions.rbegin(), resolutions.rend(), [&](auto src) {
+			    return details::pyramids::get_level_ratio(src, res).has_value();
+		    });
+
+		std::vector<i3d::Vector3d<int>> parents;
+		i3d::Vector3d<int> block_count = props->get_block_count(res);
+		for (int x = 0; x < block_count.x; ++x)
+			for (int y = 0; y < block_count.y; ++y)
+				for (int z = 0; z < block_count.z; ++z)
+					parents.emplace_back(x, y, z);
+
+		update_level<T>(parents, *source, res, channel, timepoint, angle,
+		                version, m, props);
+
+		resolutions.push_back(res);
+	}
+}
+
+template <cnpts::Scalar T>
+void Connection::update_pyramids(const std::vector<i3d::Vector3d<int>>& coords,
+                                 int channel,
+                                 int timepoint,
+                                 int angle,
+                                 const std::string& version,
+                                 ReductionMode m,
+                                 dataset_props_ptr props /* = nullptr */
+) const {
 	if (!props)
 		props = get_properties();
-	write_image(img, channel, timepoint, angle, {1, 1, 1}, version, props);
 
-	for (const auto& res : props->get_all_resolutions()) {
+	std::vector<i3d::Vector3d<int>> resolutions =
+	    details::pyramids::get_generation_order(*props);
+
+	/* Changed blocks of already updated levels */
+	std::vector<std::pair<i3d::Vector3d<int>, std::vector<i3d::Vector3d<int>>>>
+	    updated{{{1, 1, 1}, coords}};
+
+	for (auto res : resolutions) {
 		if (res == i3d::Vector3d<int>{1, 1, 1})
 			continue;
 
-		i3d::Vector3d<int> new_dim = props->get_img_dimensions(res);
-		i3d::Image3d<T> cpy;
-		i3d::Resample(img, cpy, new_dim, m);
-		write_image(cpy, channel, timepoint, angle, res, version, props);
+		/* Same source as used by write_with_pyramids */
+		auto source = std::ranges::find_if(
+		    updated.rbegin(), updated.rend(), [&](const auto& src) {
+			    return details::pyramids::get_level_ratio(src.first, res)
+			        .has_value();
+		    });
+
+		std::vector<i3d::Vector3d<int>> parents =
+		    details::pyramids::get_parent_blocks(source->second,
+		                                         source->first, res, *props);
+		if (!parents.empty())
+			update_level<T>(parents, source->first, res, channel, timepoint,
+			                angle, version, m, props);
+
+		updated.emplace_back(res, std::move(parents));
+	}
+}
+
+template <cnpts::Scalar T>
+void Connection::update_level(const std::vector<i3d::Vector3d<int>>& parents,
+                              i3d::Vector3d<int> source,
+                              i3d::Vector3d<int> resolution,
+                              int channel,
+                              int timepoint,
+                              int angle,
+                              const std::string& version,
+                              ReductionMode m,
+                              dataset_props_ptr props) const {
+	i3d::Vector3d<int> ratio =
+	    *details::pyramids::get_level_ratio(source, resolution);
+	i3d::Vector3d<int> block_dim = props->get_block_dimensions(resolution);
+	i3d::Vector3d<int> child_dim = props->get_block_dimensions(source);
+	i3d::Vector3d<int> source_dim = props->get_img_dimensions(source);
+
+	/* Batches of parents whose finer windows fit into one tile */
+	i3d::Vector3d<int> window = block_dim * ratio;
+	std::size_t batch = std::max<std::size_t>(
+	    1, details::pyramids::MAX_TILE_VOXELS /
+	           (std::size_t(window.x) * std::size_t(window.y) *
+	            std::size_t(window.z)));
+	if (parents.size() > batch) {
+		for (std::size_t i = 0; i < parents.size(); i += batch)
+			update_level<T>(
+			    {parents.begin() + std::ptrdiff_t(i),
+			     parents.begin() +
+			         std::ptrdiff_t(std::min(parents.size(), i + batch))},
+			    source, resolution, channel, timepoint, angle, version, m,
+			    props);
+		return;
+	}
+
+	/* Children of every parent */
+	std::vector<std::vector<i3d::Vector3d<int>>> children;
+	std::vector<i3d::Vector3d<int>> child_coords;
+	for (auto parent : parents) {
+		i3d::Vector3d<int> start = parent * block_dim * ratio;
+		i3d::Vector3d<int> end =
+		    start + props->get_block_size(parent, resolution) * ratio;
+		children.push_back(details::get_intercepted_blocks(
+		    start, end, source_dim, child_dim));
+		child_coords.insert(child_coords.end(), children.back().begin(),
+		                    children.back().end());
+	}
+	details::pyramids::unique_blocks(child_coords);
+
+	/* All children are fetched at once, stacked along z */
+	i3d::Image3d<T> stacked;
+	stacked.MakeRoom(child_dim.x, child_dim.y,
+	                 child_dim.z * child_coords.size());
+	std::vector<i3d::Vector3d<int>> child_offsets;
+	for (std::size_t i = 0; i < child_coords.size(); ++i)
+		child_offsets.emplace_back(0, 0, int(i) * child_dim.z);
+
+	get_view(channel, timepoint, angle, source, version)
+	    .read_blocks(child_coords, stacked, child_offsets, props);
+
+	auto less = [](const auto& lhs, const auto& rhs) {
+		return std::tie(lhs.x, lhs.y, lhs.z) < std::tie(rhs.x, rhs.y, rhs.z);
+	};
+
+	/* Recomputed parents, stacked along z as well */
+	i3d::Image3d<T> out;
+	out.MakeRoom(block_dim.x, block_dim.y, block_dim.z * parents.size());
+	std::vector<i3d::Vector3d<int>> out_offsets;
+
+	for (std::size_t i = 0; i < parents.size(); ++i) {
+		i3d::Vector3d<int> size = props->get_block_size(parents[i], resolution);
+		i3d::Vector3d<int> start = parents[i] * block_dim * ratio;
+		i3d::Vector3d<int> end = start + size * ratio;
+
+		/* Assemble finer window of the parent from its children */
+		i3d::Image3d<T> window;
+		window.MakeRoom(size * ratio);
+		for (auto child : children[i]) {
+			std::size_t idx =
+			    std::ranges::lower_bound(child_coords, child, less) -
+			    child_coords.begin();
+			i3d::Vector3d<int> child_start = child * child_dim;
+			i3d::Vector3d<int> from = max(start, child_start);
+			i3d::Vector3d<int> to =
+			    min(end, child_start + props->get_block_size(child, source));
+
+			for (int z = from.z; z < to.z; ++z)
+				for (int y = from.y; y < to.y; ++y)
+					std::copy_n(
+					    stacked.GetVoxelAddr(from.x - child_start.x,
+					                         y - child_start.y,
+					                         z - child_start.z +
+					                             int(idx) * child_dim.z),
+					    to.x - from.x,
+					    window.GetVoxelAddr(from.x - start.x, y - start.y,
+					                        z - start.z));
+		}
+
+		i3d::Image3d<T> parent;
+		details::pyramids::reduce(window, parent, size, ratio, m);
+
+		out_offsets.emplace_back(0, 0, int(i) * block_dim.z);
+		for (int z = 0; z < size.z; ++z)
+			for (int y = 0; y < size.y; ++y)
+				std::copy_n(parent.GetVoxelAddr(0, y, z), size.x,
+				            out.GetVoxelAddr(0, y, out_offsets.back().z + z));
 	}
+
+	get_view(channel, timepoint, angle, resolution, version)
+	    .write_blocks(out, parents, out_offsets, props);
 }
 
 } // namespace ds
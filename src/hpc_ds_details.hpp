@@ -1,19 +1,49 @@
 #pragma once
 #include "hpc_ds_structs.hpp"
+#include <Poco/Exception.h>
 #include <Poco/JSON/Object.h>
 #include <Poco/JSON/Parser.h>
 #include <Poco/Net/HTTPClientSession.h>
 #include <Poco/Net/HTTPMessage.h>
 #include <Poco/Net/HTTPRequest.h>
 #include <Poco/Net/HTTPResponse.h>
+#include <Poco/Timespan.h>
 #include <Poco/URI.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <cerrno>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <fcntl.h>
+#include <functional>
+#include <i3d/i3dio.h>
 #include <i3d/image3d.h>
+#include <i3d/imgfiles.h>
+#include <i3d/transform.h>
 #include <i3d/vector3d.h>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <numeric>
 #include <optional>
+#include <random>
 #include <source_location>
 #include <span>
 #include <string>
+#include <string_view>
+#include <sys/mman.h>
+#include <system_error>
+#include <thread>
+#include <tuple>
 #include <type_traits>
+#include <unistd.h>
+#include <utility>
+#include <vector>
 /* ==================== DETAILS HEADERS ============================ */
 
 namespace ds {
@@ -48,6 +78,12 @@ constexpr inline bool _WARNING_ = false;
 constexpr inline bool _WARNING_ = _LOG_;
 #endif
 
+#ifdef DATASTORE_NMETRICS
+constexpr inline bool _METRICS_ = false;
+#else
+constexpr inline bool _METRICS_ = true;
+#endif
+
 /**
  * @brief Get the dataset url objimagect
  *
@@ -106,6 +142,639 @@ create_requests(const std::vector<i3d::Vector3d<int>>& coords,
                 int angle,
                 std::size_t max_request_size = MAX_URL_LENGTH);
 
+/**
+ * @brief Create requests respecting URL, octet-data and block count limits
+ *
+ * Block exceeding <max_body_bytes> on its own is sent in a separate request.
+ *
+ * @param coords requested block coordinates
+ * @param block_bytes octet-data size of each block
+ * @param session_url connection session url
+ * @param timepoint
+ * @param channel
+ * @param angle
+ * @param max_url_length maximal length of request url
+ * @param max_body_bytes maximal octet-data size of one request
+ * @param max_blocks maximal number of blocks in one request
+ * @return Vector of pair: {request_url, coord indexes}
+ */
+inline std::vector<std::pair<std::string, std::vector<std::size_t>>>
+create_requests(const std::vector<i3d::Vector3d<int>>& coords,
+                const std::vector<std::size_t>& block_bytes,
+                const std::string& session_url,
+                int timepoint,
+                int channel,
+                int angle,
+                std::size_t max_url_length,
+                std::size_t max_body_bytes,
+                std::size_t max_blocks);
+
+/**
+ * @brief Call <fn>(i) for each i in [0, count) using several threads
+ *
+ * First exception thrown by <fn> is rethrown after all threads have finished.
+ *
+ * @param count number of work items
+ * @param fn callable accepting index of work item
+ * @param threads number of threads (0 = hardware concurrency)
+ */
+template <typename F>
+void parallel_for(std::size_t count, F&& fn, std::size_t threads = 0);
+
+/**
+ * @brief Pool of reusable octet-data buffers
+ *
+ * Buffers are grouped into power-of-two size classes. Released buffers keep
+ * their capacity and are handed out again by the next acquire of the same
+ * class, so steady-state transfers do not allocate. Thread-safe.
+ */
+class BufferPool {
+  public:
+	/* Size of the smallest class */
+	static constexpr std::size_t MIN_BUFFER_SIZE = 4096;
+
+	/* Default limit of bytes kept in released buffers */
+	static constexpr std::size_t DEFAULT_MAX_CACHED = 268435456;
+
+	/**
+	 * @brief Buffer borrowed from the pool, returned back on destruction
+	 */
+	class Buffer {
+	  public:
+		Buffer(BufferPool* pool, std::vector<char> data);
+		Buffer(Buffer&& other) noexcept;
+		Buffer& operator=(Buffer&& other) noexcept;
+		~Buffer();
+
+		std::vector<char>& operator*() { return _data; }
+		std::vector<char>* operator->() { return &_data; }
+
+	  private:
+		BufferPool* _pool;
+		std::vector<char> _data;
+	};
+
+	explicit BufferPool(std::size_t max_cached = DEFAULT_MAX_CACHED);
+
+	/**
+	 * @brief Get buffer of <size> bytes (content is unspecified)
+	 *
+	 * @param size requested size
+	 * @return Buffer with capacity of (at least) the whole size class
+	 */
+	Buffer acquire(std::size_t size);
+
+	/**
+	 * @brief Get number of bytes held by released buffers
+	 */
+	std::size_t cached_bytes() const;
+
+  private:
+	void release(std::vector<char>&& data);
+
+	mutable std::mutex _mutex;
+	std::vector<std::vector<std::vector<char>>> _free;
+	std::size_t _cached = 0;
+	std::size_t _max_cached;
+};
+
+/**
+ * @brief Splits blocks into requests according to BatchLimits
+ *
+ * Keeps moving average of measured throughput to adapt the octet-data limit
+ * (when enabled). Thread-safe.
+ */
+class BatchPlanner {
+  public:
+	explicit BatchPlanner(BatchLimits limits = {});
+
+	BatchLimits get_limits() const;
+	void set_limits(BatchLimits limits);
+
+	/**
+	 * @brief Get current octet-data limit of one request
+	 */
+	std::size_t body_limit() const;
+
+	/**
+	 * @brief Create requests (see create_requests) with current limits
+	 */
+	std::vector<std::pair<std::string, std::vector<std::size_t>>>
+	plan(const std::vector<i3d::Vector3d<int>>& coords,
+	     const std::vector<std::size_t>& block_bytes,
+	     const std::string& session_url,
+	     int timepoint,
+	     int channel,
+	     int angle) const;
+
+	/**
+	 * @brief Record transfer of one request
+	 *
+	 * @param bytes size of transferred octet-data
+	 * @param duration time the request took
+	 */
+	void record(std::size_t bytes, std::chrono::nanoseconds duration);
+
+  private:
+	/* Weight of the newest sample in throughput average */
+	static constexpr double SMOOTHING = 0.3;
+
+	mutable std::mutex _mutex;
+	BatchLimits _limits;
+	double _throughput = 0; // bytes per second, 0 = not measured yet
+};
+
+/**
+ * @brief Schedules retries of failed requests according to RetryPolicy
+ *
+ * Thread-safe.
+ */
+class Retrier {
+  public:
+	explicit Retrier(RetryPolicy policy = {});
+
+	RetryPolicy get_policy() const;
+	void set_policy(RetryPolicy policy);
+
+	/**
+	 * @brief Get delay before given retry (jitter included)
+	 *
+	 * @param retry number of the retry, starting from 1
+	 */
+	std::chrono::milliseconds delay(int retry);
+
+  private:
+	mutable std::mutex _mutex;
+	RetryPolicy _policy;
+	std::mt19937_64 _gen{std::random_device()()};
+};
+
+/**
+ * @brief Decides about hedging of slow read requests (see HedgingPolicy)
+ *
+ * Keeps durations of recent requests and the number of duplicates sent, owns
+ * reused worker threads of hedged requests (destruction waits for them).
+ * Thread-safe.
+ */
+class Hedger {
+  public:
+	explicit Hedger(HedgingPolicy policy = {});
+	Hedger(const Hedger&) = delete;
+	Hedger& operator=(const Hedger&) = delete;
+	~Hedger();
+
+	HedgingPolicy get_policy() const;
+	void set_policy(HedgingPolicy policy);
+
+	/**
+	 * @brief Get time after which a duplicate request should be sent
+	 *
+	 * @return nothing, if hedging is disabled or there is not enough history
+	 */
+	std::optional<std::chrono::nanoseconds> threshold() const;
+
+	/**
+	 * @brief Take one duplicate request from the budget
+	 *
+	 * @return false, if the budget is exhausted
+	 */
+	bool try_hedge();
+
+	/**
+	 * @brief Record duration of one successful request
+	 */
+	void record(std::chrono::nanoseconds duration);
+
+	/**
+	 * @brief Run <fn> on an idle worker thread (a new one is started, if
+	 * none is idle), all of them finish at the latest on destruction
+	 *
+	 * @param fn task, must not throw
+	 */
+	void spawn(std::function<void()> fn);
+
+  private:
+	void work();
+
+	/* Number of recent durations kept */
+	static constexpr std::size_t WINDOW = 128;
+
+	mutable std::mutex _mutex;
+	HedgingPolicy _policy;
+	std::vector<std::chrono::nanoseconds> _samples;
+	std::size_t _next = 0;
+	std::uint64_t _requests = 0;
+	std::uint64_t _hedges = 0;
+
+	/* Workers are kept for reuse, waiting for new tasks while idle */
+	std::mutex _tasks_mutex;
+	std::condition_variable _tasks_cv;
+	std::deque<std::function<void()>> _tasks;
+	std::vector<std::thread> _workers;
+	std::size_t _idle = 0;
+	bool _stopping = false;
+};
+
+/**
+ * @brief AIMD limit of requests in flight to one server (see
+ * ConcurrencyPolicy)
+ *
+ * One instance per ip:port is shared by all connections (see for_host).
+ * Thread-safe.
+ */
+class ConcurrencyController {
+  public:
+	/**
+	 * @brief Permission to send one request, released on destruction
+	 */
+	class Slot {
+	  public:
+		Slot(ConcurrencyController* owner, std::size_t in_flight)
+		    : _owner(owner), _in_flight(in_flight),
+		      _start(std::chrono::steady_clock::now()) {}
+		Slot(Slot&& other) noexcept
+		    : _owner(std::exchange(other._owner, nullptr)),
+		      _in_flight(other._in_flight), _start(other._start) {}
+		Slot& operator=(Slot&& other) = delete;
+		~Slot();
+
+		/**
+		 * @brief Requests in flight (this one included), when acquired
+		 */
+		std::size_t in_flight() const { return _in_flight; }
+
+	  private:
+		ConcurrencyController* _owner;
+		std::size_t _in_flight;
+		std::chrono::steady_clock::time_point _start;
+
+		friend class ConcurrencyController;
+	};
+
+	explicit ConcurrencyController(ConcurrencyPolicy policy = {});
+
+	/**
+	 * @brief Get controller shared by all connections to <ip>:<port>
+	 */
+	static std::shared_ptr<ConcurrencyController>
+	for_host(const std::string& ip, int port);
+
+	ConcurrencyPolicy get_policy() const;
+	void set_policy(ConcurrencyPolicy policy);
+
+	/**
+	 * @brief Get current limit of requests in flight
+	 */
+	std::size_t limit() const;
+
+	/**
+	 * @brief Wait until number of requests in flight is below the limit
+	 *
+	 * @param token cancels the waiting (may be nullptr)
+	 */
+	Slot acquire(const CancellationToken* token = nullptr);
+
+	/**
+	 * @brief Get slot only if number of requests in flight is below the
+	 * limit (never waits)
+	 */
+	std::optional<Slot> try_acquire();
+
+	/**
+	 * @brief Record successful request
+	 *
+	 * Time to first byte is compared only with requests of similar size in
+	 * the same direction, as it grows with the size of the batch (and
+	 * includes sending of the body of uploads).
+	 *
+	 * @param slot slot of the request
+	 * @param bytes size of transferred octet-data
+	 * @param first_byte time to first byte of response
+	 * @param upload whether <bytes> were sent (not received)
+	 */
+	void record_success(const Slot& slot,
+	                    std::size_t bytes,
+	                    std::chrono::nanoseconds first_byte,
+	                    bool upload = false);
+
+	/**
+	 * @brief Record 5xx response, network error or timeout
+	 *
+	 * @param slot slot of the request
+	 */
+	void record_congestion(const Slot& slot);
+
+  private:
+	using clock = std::chrono::steady_clock;
+
+	/* Weight of a sample above the latency baseline (baseline drifts up) */
+	static constexpr double BASELINE_DRIFT = 0.01;
+
+	/* Request sizes are grouped by their bit width */
+	static constexpr std::size_t SIZE_CLASSES =
+	    std::numeric_limits<std::size_t>::digits + 1;
+
+	/* Relative throughput improvement, that lets the limit grow further */
+	static constexpr double MIN_GAIN = 0.05;
+
+	/* Period of checking cancellation, while waiting for a slot */
+	static constexpr std::chrono::milliseconds POLL{50};
+
+	std::size_t cap() const;
+	void release();
+	void decrease(const Slot& slot);
+	void start_round();
+
+	mutable std::mutex _mutex;
+	std::condition_variable _cv;
+	ConcurrencyPolicy _policy;
+	double _limit;
+	std::size_t _in_flight = 0;
+
+	/* Time to first byte without congestion, in seconds (0 = not measured),
+	 * indexed by upload and by bit width of the request size */
+	std::array<std::array<double, SIZE_CLASSES>, 2> _baselines{};
+
+	/* Requests sent before it do not cause another decrease */
+	clock::time_point _last_decrease{};
+
+	/* Round of requests (as many as the limit), ends by growth decision */
+	clock::time_point _round_start = clock::now();
+	std::size_t _round_requests = 0;
+	std::size_t _round_bytes = 0;
+	bool _round_saturated = false;
+	double _throughput = 0; // of the previous round, bytes per second
+	bool _grown = false;    // in the previous round
+};
+
+/**
+ * @brief Servers sharing the same storage, requests are balanced among them
+ *
+ * Each request goes to the endpoint, that is expected to answer first: with
+ * the least outstanding requests weighted by its time to first byte (least
+ * outstanding requests, until latencies are measured). An endpoint that
+ * failed is avoided for a while (doubled with each consecutive failure),
+ * unless all of them failed.
+ * Thread-safe.
+ */
+class EndpointPool {
+  public:
+	/**
+	 * @brief Endpoint chosen for one request, released on destruction
+	 */
+	class Lease {
+	  public:
+		Lease(EndpointPool* owner, std::size_t index)
+		    : _owner(owner), _index(index) {}
+		Lease(Lease&& other) noexcept
+		    : _owner(std::exchange(other._owner, nullptr)),
+		      _index(other._index) {}
+		Lease& operator=(Lease&& other) = delete;
+		~Lease();
+
+		std::size_t index() const { return _index; }
+
+	  private:
+		EndpointPool* _owner;
+		std::size_t _index;
+	};
+
+	/**
+	 * @throws std::logic_error if <endpoints> are empty
+	 */
+	explicit EndpointPool(std::vector<Endpoint> endpoints);
+
+	std::size_t size() const { return _endpoints.size(); }
+	const Endpoint& endpoint(std::size_t i) const { return _endpoints[i]; }
+
+	/**
+	 * @brief Get concurrency controller of endpoint (shared per ip:port)
+	 */
+	ConcurrencyController& concurrency(std::size_t i) const {
+		return *_concurrency[i];
+	}
+
+	/**
+	 * @brief Get sum of maximal concurrency limits of all endpoints
+	 */
+	std::size_t max_concurrency() const;
+
+	/**
+	 * @brief Choose endpoint for next request
+	 */
+	Lease acquire();
+
+	/**
+	 * @brief Get endpoints in order of preference (for one-off requests)
+	 */
+	std::vector<std::size_t> order() const;
+
+	/**
+	 * @brief Record successful request to endpoint <i>
+	 *
+	 * @param first_byte time to first byte of response
+	 */
+	void record_success(std::size_t i, std::chrono::nanoseconds first_byte);
+
+	/**
+	 * @brief Record failure (5xx response, network error or timeout) of
+	 * endpoint <i>
+	 */
+	void record_failure(std::size_t i);
+
+  private:
+	using clock = std::chrono::steady_clock;
+
+	/* Weight of the newest sample in latency average */
+	static constexpr double SMOOTHING = 0.3;
+
+	/* Endpoint is avoided for this long after first failure... */
+	static constexpr std::chrono::milliseconds MIN_DOWN_TIME{500};
+
+	/* ...and at most this long after repeated ones */
+	static constexpr std::chrono::milliseconds MAX_DOWN_TIME{30000};
+
+	struct State {
+		std::size_t outstanding = 0;
+		double latency = 0; // seconds of time to first byte
+		int failures = 0;   // consecutive
+		clock::time_point down_until{};
+	};
+
+	/* Sort key of endpoint <i>, smaller is preferred */
+	std::tuple<bool, double, std::size_t> rank(std::size_t i,
+	                                           clock::time_point now) const;
+	void release(std::size_t i);
+
+	std::vector<Endpoint> _endpoints;
+	std::vector<std::shared_ptr<ConcurrencyController>> _concurrency;
+
+	mutable std::mutex _mutex;
+	std::vector<State> _states;
+};
+
+/**
+ * @brief Thread-safe collection of named histograms and counters
+ */
+template <bool Enabled>
+class BasicMetricsRegistry {
+  public:
+	using clock = std::chrono::steady_clock;
+
+	static clock::time_point now();
+
+	void record(std::string_view name, std::uint64_t value);
+	void record(std::string_view name, clock::duration duration);
+	void add(std::string_view name, std::uint64_t value);
+
+	Metrics snapshot() const;
+	void reset();
+
+  private:
+	mutable std::mutex _mutex;
+	Metrics _metrics;
+};
+
+/**
+ * @brief Disabled registry, empty and with inline no-op methods, so that
+ * recording compiles to nothing (names are never turned into strings)
+ */
+template <>
+class BasicMetricsRegistry<false> {
+  public:
+	using clock = std::chrono::steady_clock;
+
+	/* Epoch, so that measured durations fold to constants */
+	static clock::time_point now() { return {}; }
+
+	void record(std::string_view, std::uint64_t) {}
+	void record(std::string_view, clock::duration) {}
+	void add(std::string_view, std::uint64_t) {}
+
+	Metrics snapshot() const { return {}; }
+	void reset() {}
+};
+
+/* Registry used by the library, disabled by DATASTORE_NMETRICS */
+using MetricsRegistry = BasicMetricsRegistry<_METRICS_>;
+
+/**
+ * @brief State shared by Connection and all ImageViews obtained from it
+ */
+struct Context {
+	BufferPool buffers;
+	BatchPlanner downloads;
+	BatchPlanner uploads;
+	Retrier retries;
+	Hedger hedger;
+	std::atomic<std::chrono::milliseconds> connect_timeout{Timeouts{}.connect};
+	std::atomic<std::chrono::milliseconds> io_timeout{Timeouts{}.io};
+	MetricsRegistry metrics;
+
+	/* Servers of the connection (each with its own concurrency limit) */
+	std::shared_ptr<EndpointPool> endpoints;
+
+	Timeouts get_timeouts() const {
+		return {connect_timeout.load(), io_timeout.load()};
+	}
+
+	void set_timeouts(const Timeouts& timeouts) {
+		if (timeouts.connect.count() <= 0 || timeouts.io.count() <= 0)
+			throw std::logic_error("Timeouts have to be positive");
+
+		connect_timeout = timeouts.connect;
+		io_timeout = timeouts.io;
+	}
+};
+
+/* Timeline of client operations in Chrome trace format */
+namespace trace {
+
+/**
+ * @brief Process-wide collector of trace events
+ *
+ * Disabled by default. While disabled, creating a Span costs a single relaxed
+ * atomic load. Events are kept in memory until the trace is taken.
+ */
+class Tracer {
+  public:
+	using clock = std::chrono::steady_clock;
+
+	struct Event {
+		std::string name;
+		const char* category;
+		std::string args; // JSON object members, e.g. "\"bytes\": 10"
+		clock::time_point start;
+		clock::duration duration;
+		int thread;
+	};
+
+	static Tracer& instance();
+
+	bool enabled() const { return _enabled.load(std::memory_order_relaxed); }
+
+	/**
+	 * @brief Discard collected events and start collecting
+	 */
+	void start();
+
+	/**
+	 * @brief Stop collecting (events are kept)
+	 */
+	void stop();
+
+	void record(Event event);
+
+	/**
+	 * @brief Get collected events as Chrome trace JSON
+	 */
+	std::string to_json() const;
+
+  private:
+	std::atomic<bool> _enabled = false;
+
+	mutable std::mutex _mutex;
+	std::vector<Event> _events;
+	clock::time_point _origin = clock::now();
+};
+
+/**
+ * @brief Small sequential identifier of the calling thread
+ */
+inline int thread_id();
+
+/**
+ * @brief Traces duration of its scope (complete event), if tracing is enabled
+ */
+class Span {
+  public:
+	Span(const char* name, const char* category);
+	Span(const Span&) = delete;
+	Span& operator=(const Span&) = delete;
+	~Span();
+
+	/**
+	 * @brief Whether the span is recorded (build its arguments only if so)
+	 */
+	explicit operator bool() const { return _active; }
+
+	/**
+	 * @brief Set arguments shown with the event
+	 *
+	 * @param args JSON object members (e.g. "\"blocks\": 4")
+	 */
+	void set_args(std::string args) { _args = std::move(args); }
+
+  private:
+	bool _active;
+	const char* _name;
+	const char* _category;
+	std::string _args;
+	Tracer::clock::time_point _start;
+};
+
+} // namespace trace
+
 namespace data_manip {
 inline int get_block_data_size(i3d::Vector3d<int> block_size,
                                const std::string& voxel_type);
@@ -142,6 +811,18 @@ void set_elem_at(std::span<char> data,
                  i3d::Vector3d<int> block_dim,
                  T elem);
 
+/**
+ * @brief Decode one big-endian element of <elem_size> bytes
+ */
+template <typename T>
+T load_big_endian(const char* src, int elem_size);
+
+/**
+ * @brief Encode one element into <elem_size> big-endian bytes
+ */
+template <typename T>
+void store_big_endian(char* dest, int elem_size, T elem);
+
 /**
  * @brief Read data to image
  *
@@ -159,6 +840,46 @@ void read_data(std::span<const char> data,
                i3d::Vector3d<int> offset,
                i3d::Vector3d<int> block_size);
 
+/**
+ * @brief Read data to strided view
+ *
+ * Voxels of the block falling outside of <dest> are skipped.
+ *
+ * @tparam T Voxel type of view
+ * @param data octet-data to read from
+ * @param voxel_type data type of image in <data>
+ * @param dest destination view
+ * @param offset offset to destination view
+ * @param block_size size of expected block
+ */
+template <typename T>
+void read_data(std::span<const char> data,
+               const std::string& voxel_type,
+               StridedView<T> dest,
+               i3d::Vector3d<int> offset,
+               i3d::Vector3d<int> block_size);
+
+/**
+ * @brief Record voxels of data to statistics (without decoding to image)
+ *
+ * Voxels of the block falling outside of region are skipped.
+ *
+ * @tparam T Voxel type of data
+ * @param data octet-data to read from
+ * @param voxel_type data type of image in <data>
+ * @param stats statistics to record to
+ * @param region_size size of region of interest
+ * @param offset offset of block in region
+ * @param block_size size of expected block
+ */
+template <typename T>
+void record_data(std::span<const char> data,
+                 const std::string& voxel_type,
+                 Statistics& stats,
+                 i3d::Vector3d<int> region_size,
+                 i3d::Vector3d<int> offset,
+                 i3d::Vector3d<int> block_size);
+
 /**
  * @brief Write image to data
  *
@@ -175,40 +896,358 @@ void write_data(const i3d::Image3d<T>& src,
                 std::span<char> data,
                 const std::string& voxel_type,
                 i3d::Vector3d<int> block_size);
+
+/**
+ * @brief Write strided view to data
+ *
+ * @tparam T Voxel type of view
+ * @param src source view
+ * @param offset offset to source view
+ * @param data preallocated octet-data (ensure proper size)
+ * @param voxel_type data type of image in <data>
+ * @param block_size regular block size
+ */
+template <typename T>
+void write_data(StridedView<const T> src,
+                i3d::Vector3d<int> offset,
+                std::span<char> data,
+                const std::string& voxel_type,
+                i3d::Vector3d<int> block_size);
+
+/**
+ * @brief Get view of the whole image
+ */
+template <typename T>
+StridedView<T> make_view(i3d::Image3d<T>& img);
+
+template <typename T>
+StridedView<const T> make_view(const i3d::Image3d<T>& img);
 } // namespace data_manip
 
+/* Helpers to generate resolution levels (pyramids) */
+namespace pyramids {
+/* Largest full-resolution tile (in voxels) used when streaming pyramids,
+ * also bounds finer windows of blocks recomputed at once */
+constexpr inline std::size_t MAX_TILE_VOXELS = std::size_t(1) << 27;
+
+/**
+ * @brief Get integer ratio between two resolution levels
+ *
+ * @param fine finer resolution level
+ * @param coarse coarser resolution level
+ * @return coarse / fine (elem-wise) if it is integral, std::nullopt otherwise
+ */
+inline std::optional<i3d::Vector3d<int>>
+get_level_ratio(i3d::Vector3d<int> fine, i3d::Vector3d<int> coarse);
+
+/**
+ * @brief Get order in which resolution levels should be generated
+ *
+ * @param props dataset properties
+ * @return resolutions from the finest ({1, 1, 1}) to the coarsest one
+ */
+inline std::vector<i3d::Vector3d<int>>
+get_generation_order(const DatasetProperties& props);
+
+/**
+ * @brief Get blocks of coarser level computed from given finer blocks
+ *
+ * @param children block coordinates at finer level
+ * @param fine finer resolution level
+ * @param coarse coarser resolution level (integer multiple of <fine>)
+ * @param props dataset properties
+ * @return sorted unique coordinates of affected blocks at <coarse> level
+ */
+inline std::vector<i3d::Vector3d<int>>
+get_parent_blocks(const std::vector<i3d::Vector3d<int>>& children,
+                  i3d::Vector3d<int> fine,
+                  i3d::Vector3d<int> coarse,
+                  const DatasetProperties& props);
+
+/**
+ * @brief Sort block coordinates (lexicographically) and remove duplicates
+ *
+ * @param coords block coordinates
+ */
+inline void unique_blocks(std::vector<i3d::Vector3d<int>>& coords);
+
+/**
+ * @brief Downsample image by integer factor
+ *
+ * Image is processed by z-slabs in parallel. Nearest neighbour picks the
+ * first voxel of each <factor>-sized window, so the downsampling can be
+ * cascaded (level by level) with the same result. Other modes resample each
+ * slab with i3d::Resample, slabs overlap by DOWNSAMPLE_HALO destination
+ * slices, so interpolation near slab seams sees the same neighbourhood as
+ * when resampling the whole (cropped) image.
+ *
+ * @param src source image
+ * @param dest destination image (reallocated to <dest_size>)
+ * @param dest_size size of destination image (<= src size / factor)
+ * @param factor integer downsampling factor
+ * @param m sampling mode
+ */
+template <typename T>
+void downsample(const i3d::Image3d<T>& src,
+                i3d::Image3d<T>& dest,
+                i3d::Vector3d<int> dest_size,
+                i3d::Vector3d<int> factor,
+                SamplingMode m);
+
+/* Overlap of resampled slabs (in destination slices) */
+constexpr inline int DOWNSAMPLE_HALO = 2;
+
+/**
+ * @brief Downsample image by integer factor using window reduction
+ *
+ * Image is processed slice by slice in parallel. Windows are reduced row by
+ * row into contiguous buffers, so the inner loops are vectorised by the
+ * compiler for every voxel type.
+ *
+ * @param src source image
+ * @param dest destination image (reallocated to <dest_size>)
+ * @param dest_size size of destination image (<= src size / factor)
+ * @param factor integer downsampling factor
+ * @param mode window reduction
+ */
+template <typename T>
+void reduce(const i3d::Image3d<T>& src,
+            i3d::Image3d<T>& dest,
+            i3d::Vector3d<int> dest_size,
+            i3d::Vector3d<int> factor,
+            ReductionMode mode);
+} // namespace pyramids
+
+/* Helpers to write images directly to files */
+namespace files {
+/* Number of concurrent download streams when reading to file */
+constexpr inline std::size_t FILE_READ_STREAMS = 4;
+
+/* Number of slice files written or loaded concurrently */
+constexpr inline std::size_t SLICE_FILE_STREAMS = 4;
+
+/**
+ * @brief File of given size mapped to memory (read-write, shared)
+ *
+ * File is created (or truncated) and resized without writing, so it stays
+ * sparse until the data are written. POSIX only.
+ */
+class MappedFile {
+  public:
+	MappedFile(const std::string& path, std::size_t size);
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	~MappedFile();
+
+	char* data() { return _data; }
+	std::size_t size() const { return _size; }
+
+	/**
+	 * @brief Write mapped data to disk
+	 */
+	void sync();
+
+  private:
+	int _fd = -1;
+	char* _data = nullptr;
+	std::size_t _size;
+};
+
+/**
+ * @brief Create attached NRRD header for given resolution level
+ *
+ * Header is padded (by a comment line) to the multiple of 64 bytes, so the
+ * voxels following it are aligned.
+ *
+ * @param props dataset properties
+ * @param resolution resolution level
+ * @return header including the terminating empty line
+ */
+inline std::string get_nrrd_header(const DatasetProperties& props,
+                                   i3d::Vector3d<int> resolution);
+
+/**
+ * @brief Path of z-th slice file of exported image
+ *
+ * @param pattern path with replacement field of slice index (fmt syntax, e.g.
+ * "slice_{:04}.tif")
+ * @param z slice index
+ * @return path of the slice file
+ */
+inline std::string get_slice_path(const std::string& pattern, int z);
+
+/**
+ * @brief i3d voxel type of image files holding voxels of type T
+ */
+template <cnpts::FileVoxel T>
+constexpr i3d::ImgVoxelType get_file_voxel_type();
+
+/**
+ * @brief Write every slice of <slab> into separate 2D file using i3d writer
+ *
+ * Slices are written concurrently (SLICE_FILE_STREAMS files at a time).
+ *
+ * @param slab consecutive slices of the image
+ * @param pattern path pattern (see get_slice_path)
+ * @param first index of the first slice of <slab> in the image
+ * @param format i3d file format of slices
+ */
+template <cnpts::FileVoxel T>
+void write_slices(const i3d::Image3d<T>& slab,
+                  const std::string& pattern,
+                  int first,
+                  i3d::FileFormat format);
+
+/**
+ * @brief Load every slice of <slab> from separate 2D file using i3d reader
+ *
+ * Slices are loaded concurrently (SLICE_FILE_STREAMS files at a time). Each
+ * file has to match the slab in size and voxel type.
+ *
+ * @param slab preallocated image of consecutive slices
+ * @param pattern path pattern (see get_slice_path)
+ * @param first index of the first slice of <slab> in the image
+ */
+template <cnpts::FileVoxel T>
+void read_slices(i3d::Image3d<T>& slab, const std::string& pattern, int first);
+} // namespace files
+
 namespace log {
 
 /**
- * @brief Prints message
+ * @brief Asynchronous logger
+ *
+ * Messages are formatted by the logging thread only when their level is
+ * enabled, then passed through a bounded lock-free ring buffer to a
+ * background thread, which adds level and location and hands them to sinks.
+ * Logging threads never block: when the buffer is full, the message is
+ * dropped (and the number of dropped messages is reported later).
+ */
+class Logger {
+  public:
+	static constexpr std::size_t CAPACITY = 4096; // power of two
+
+	static Logger& instance();
+
+	Logger(const Logger&) = delete;
+	Logger& operator=(const Logger&) = delete;
+	~Logger();
+
+	bool enabled(LogLevel level) const {
+		return level >= _level.load(std::memory_order_relaxed);
+	}
+	void set_level(LogLevel level) { _level = level; }
+
+	void set_sink(LogSink sink);
+	void add_sink(LogSink sink);
+
+	/**
+	 * @brief Enqueue message (dropped when the buffer is full)
+	 */
+	void push(LogLevel level,
+	          std::string msg,
+	          const std::source_location& location);
+
+	/**
+	 * @brief Wait until all enqueued messages are written by sinks
+	 */
+	void flush();
+
+	/**
+	 * @brief Sink printing to standard output (used by default)
+	 */
+	static void stdout_sink(LogLevel level, const std::string& msg);
+
+  private:
+	struct Message {
+		LogLevel level;
+		std::string text;
+		const char* function;
+		std::uint_least32_t line;
+	};
+
+	struct Slot {
+		std::atomic<std::size_t> sequence;
+		Message message;
+	};
+
+	Logger();
+
+	bool pop(Message& out);
+	void run();
+	void write(const Message& message);
+
+	std::atomic<LogLevel> _level = LogLevel::INFO;
+
+	std::unique_ptr<Slot[]> _slots;
+	std::atomic<std::size_t> _enqueue = 0;
+	std::size_t _dequeue = 0; // consumer only
+
+	std::atomic<std::size_t> _pushed = 0;
+	std::atomic<std::size_t> _written = 0;
+	std::atomic<std::size_t> _dropped = 0;
+
+	/* Set by idle consumer, producers wake it up */
+	std::atomic<bool> _idle = false;
+	std::atomic<bool> _stop = false;
+
+	std::mutex _sinks_mutex;
+	std::vector<LogSink> _sinks;
+
+	std::thread _worker;
+};
+
+/**
+ * @brief Format string together with location of the logging call
+ *
+ * Location is captured by the (implicit) conversion from the format string,
+ * so that it does not have to follow the variadic arguments.
+ */
+template <typename... Args>
+struct LocatedFormat {
+	template <typename S>
+	consteval LocatedFormat(
+	    const S& str,
+	    std::source_location location = std::source_location::current())
+	    : str(str), location(location) {}
+
+	fmt::format_string<Args...> str;
+	std::source_location location;
+};
+
+/**
+ * @brief Format message and pass it to the logger, if enabled at compile and
+ * run time (otherwise the arguments are never formatted)
  *
- * @param msg Message
- * @param type Type of message
+ * @param level Type of message
  * @param location Location info about message source
+ * @param format fmt format string
+ * @param args Arguments of the format string
  */
-inline void _log(const std::string& msg,
-                 const std::string& type,
-                 const std::source_location& location);
+template <typename... Args>
+void _log(LogLevel level,
+          const std::source_location& location,
+          fmt::format_string<Args...> format,
+          Args&&... args);
 
 /**
  * @brief Print info message
  *
- * @param msg Message
- * @param location Automaticaly generated location info
+ * @param format fmt format string (with automatically captured location)
+ * @param args Arguments of the format string
  */
-inline void
-info(const std::string& msg,
-     const std::source_location& location = std::source_location::current());
+template <typename... Args>
+void info(LocatedFormat<std::type_identity_t<Args>...> format, Args&&... args);
 
 /**
  * @brief Print warning message
  *
- * @param msg Message
- * @param location Automaticaly generated location info
+ * @param format fmt format string (with automatically captured location)
+ * @param args Arguments of the format string
  */
-inline void
-warning(const std::string& msg,
-        const std::source_location& location = std::source_location::current());
+template <typename... Args>
+void warning(LocatedFormat<std::type_identity_t<Args>...> format,
+             Args&&... args);
 
 } // namespace log
 /* Helpers to parse Dataset Properties from JSON */
@@ -240,6 +1279,10 @@ get_resolution_levels(Object::Ptr root);
 
 /* Helpers providing requests functionality */
 namespace requests {
+/* Bodies are sent and received in chunks of this size (in bytes), so that
+ * deadlines are checked during long transfers */
+constexpr inline std::size_t BODY_CHUNK = std::size_t(64) << 10;
+
 inline std::string session_url_request(const std::string& ds_url,
                                        i3d::Vector3d<int> resolution,
                                        const std::string& version);
@@ -247,19 +1290,168 @@ inline std::string session_url_request(const std::string& ds_url,
 inline std::pair<std::vector<char>, Poco::Net::HTTPResponse>
 make_request(const std::string& url,
              const std::string& type = Poco::Net::HTTPRequest::HTTP_GET,
-             const std::vector<char>& data = {},
+             std::span<const char> data = {},
              const std::map<std::string, std::string>& headers = {});
-} // namespace requests
-} // namespace details
-} // namespace ds
 
-/* ================= IMPLEMENTATION FOLLOWS ======================== */
-namespace ds {
-namespace details {
+/**
+ * @brief Durations of request phases
+ */
+struct RequestTiming {
+	/* From connecting until response header was received */
+	std::chrono::nanoseconds first_byte{0};
 
-/* inline */ std::string
-get_dataset_url(const std::string& ip, int port, const std::string& uuid) {
-	std::string out;
+	/* Reading of the response body */
+	std::chrono::nanoseconds transfer{0};
+};
+
+/**
+ * @brief Endpoint of one request of a hedged race (the original one or its
+ * duplicate)
+ */
+struct HedgeTarget {
+	/* Request url at the chosen endpoint */
+	std::string url;
+
+	/* Called on the thread of the request, when it finishes (unless
+	 * cancelled or failed with exception), with its status, timing and size
+	 * of the response */
+	std::function<void(int, const RequestTiming&, std::size_t)> finish;
+
+	/* Kept until the request finishes (e.g. its concurrency slot), even
+	 * after the race was won by the other request */
+	std::shared_ptr<void> hold;
+};
+
+/**
+ * @brief Send request and read response body into given buffer
+ *
+ * Content of <out> is replaced, its capacity is reused.
+ *
+ * @param timing if set, filled with durations of request phases
+ * @param timeouts socket timeouts (shortened to the deadline of <token>)
+ * @param token if set, its cancellation shuts the socket down
+ * @return Poco::Net::HTTPResponse response header
+ */
+inline Poco::Net::HTTPResponse
+make_request(const std::string& url,
+             std::vector<char>& out,
+             const std::string& type = Poco::Net::HTTPRequest::HTTP_GET,
+             std::span<const char> data = {},
+             const std::map<std::string, std::string>& headers = {},
+             RequestTiming* timing = nullptr,
+             Timeouts timeouts = {},
+             const CancellationToken* token = nullptr);
+
+/**
+ * @brief Check whether request failed with given status may succeed later
+ */
+inline bool is_transient(int status);
+
+/**
+ * @brief Send request (see make_request), network errors are not thrown
+ *
+ * @param error set to description of the error, if the request failed
+ * without response
+ * @return int status of the response, 0 if there is none
+ */
+inline int try_request(const std::string& url,
+                       std::vector<char>& out,
+                       std::string& error,
+                       const std::string& type,
+                       std::span<const char> data,
+                       const std::map<std::string, std::string>& headers,
+                       RequestTiming* timing,
+                       Timeouts timeouts,
+                       const CancellationToken* token);
+
+/**
+ * @brief Send GET request (see try_request), hedged according to <hedger>
+ *
+ * Once the hedger has enough history, the request runs on a worker of the
+ * hedger. If it does not finish in time given by the hedger, the same
+ * request is sent once more to the endpoint given by <hedge_target> and the
+ * response that arrives first is used. The slower request is left to finish
+ * in the background.
+ *
+ * @param primary endpoint of the original request
+ * @param metrics counts duplicates sent ("read.hedges") and used
+ * ("read.hedge_wins")
+ * @param hedge_target chooses endpoint of the duplicate, no duplicate is sent
+ * if it returns nothing (e.g. no concurrency slot is free)
+ * @param hedge_won set to whether the response of the duplicate was used
+ * @return int status of the response, 0 if there is none
+ * @throws exception of the used request other than network error (e.g.
+ * std::bad_alloc)
+ */
+inline int hedged_request(
+    HedgeTarget primary,
+    std::vector<char>& out,
+    std::string& error,
+    RequestTiming* timing,
+    Timeouts timeouts,
+    const CancellationToken* token,
+    Hedger& hedger,
+    MetricsRegistry& metrics,
+    const std::function<std::optional<HedgeTarget>()>& hedge_target,
+    bool& hedge_won);
+
+/**
+ * @brief Call <fn> with endpoints of <pool> (in order of preference) until it
+ * succeeds
+ *
+ * Endpoints, for which <fn> threw, are recorded as failed.
+ *
+ * @return result of the first successful call
+ * @throws exception of the last endpoint, if all of them failed
+ */
+template <typename F>
+auto with_failover(EndpointPool& pool, F&& fn);
+
+/**
+ * @brief Session urls of one operation, obtained from each endpoint when
+ * first needed
+ *
+ * Thread-safe.
+ */
+class Sessions {
+  public:
+	Sessions(const EndpointPool& pool,
+	         std::string uuid,
+	         i3d::Vector3d<int> resolution,
+	         std::string version);
+
+	/**
+	 * @brief Get session url of endpoint <i> (without trailing slash)
+	 */
+	const std::string& get(std::size_t i);
+
+	/**
+	 * @brief Get session url of endpoint <i>, nullptr (and <error>) if it
+	 * could not be obtained
+	 */
+	const std::string* try_get(std::size_t i, std::string& error);
+
+  private:
+	const EndpointPool& _pool;
+	std::string _uuid;
+	i3d::Vector3d<int> _resolution;
+	std::string _version;
+
+	/* One per endpoint, a slow endpoint does not block the others */
+	std::vector<std::mutex> _mutexes;
+	std::vector<std::optional<std::string>> _urls;
+};
+} // namespace requests
+} // namespace details
+} // namespace ds
+
+/* ================= IMPLEMENTATION FOLLOWS ======================== */
+namespace ds {
+namespace details {
+
+/* inline */ std::string
+get_dataset_url(const std::string& ip, int port, const std::string& uuid) {
+	std::string out;
 	if (!ip.starts_with("http://"))
 		out = "https://";
 	return out + fmt::format("{}:{}/datasets/{}", ip, port, uuid);
@@ -268,6 +1460,7 @@ get_dataset_url(const std::string& ip, int port, const std::string& uuid) {
 inline DatasetProperties
 get_dataset_properties(const std::string& dataset_url) {
 	using namespace Poco::JSON;
+	trace::Span span("get_dataset_properties", "properties");
 
 	/* Fetch JSON from server */
 	auto [data, response] = requests::make_request(dataset_url);
@@ -275,8 +1468,8 @@ get_dataset_properties(const std::string& dataset_url) {
 
 	int res_code = response.getStatus();
 	if (res_code != 200)
-		log::warning(fmt::format(
-		    "Request ended with code: {}. json may not be valid", res_code));
+		log::warning("Request ended with code: {}. json may not be valid",
+		             res_code);
 
 	log::info("Parsing dataset properties from JSON string");
 	Parser parser;
@@ -322,75 +1515,716 @@ check_block_coords(const std::vector<i3d::Vector3d<int>>& coords,
 	if constexpr (!_DEBUG_)
 		return true;
 
-	log::info("Checking validity of given block coordinates");
+	log::info("Checking validity of given block coordinates");
+
+	for (i3d::Vector3d<int> coord : coords)
+		if (data_manip::get_block_size(coord, block_dim, img_dim) ==
+		    i3d::Vector3d(0, 0, 0)) {
+			log::warning("Block coordinate {} is out of valid range",
+			             to_string(coord));
+
+			return false;
+		}
+	log::info("Check successfullly finished");
+	return true;
+}
+
+/* inline */ std::vector<i3d::Vector3d<int>>
+get_intercepted_blocks(i3d::Vector3d<int> start_point,
+                       i3d::Vector3d<int> end_point,
+                       i3d::Vector3d<int> img_dim,
+                       i3d::Vector3d<int> block_dim) {
+	assert(lt(start_point, end_point));
+
+	i3d::Vector3d<int> block_count = (img_dim + block_dim - 1) / block_dim;
+	std::vector<i3d::Vector3d<int>> out;
+
+	/* Visit only blocks within bounding box of the region */
+	i3d::Vector3d<int> first, last;
+	for (int i = 0; i < 3; ++i) {
+		first[i] = std::max(0, start_point[i] / block_dim[i]);
+		last[i] = std::min(block_count[i],
+		                   (end_point[i] + block_dim[i] - 1) / block_dim[i]);
+	}
+
+	for (int x = first.x; x < last.x; ++x)
+		for (int y = first.y; y < last.y; ++y)
+			for (int z = first.z; z < last.z; ++z) {
+				i3d::Vector3d<int> coord = {x, y, z};
+				if (lt(start_point, (coord + 1) * block_dim) &&
+				    lt(coord * block_dim, end_point))
+					out.push_back(coord);
+			}
+
+	return out;
+}
+
+/* inline */ std::vector<std::pair<std::string, std::vector<std::size_t>>>
+create_requests(const std::vector<i3d::Vector3d<int>>& coords,
+                const std::string& session_url,
+                int timepoint,
+                int channel,
+                int angle,
+                std::size_t max_request_size /* = MAX_URL_LENGTH*/) {
+	return create_requests(coords, std::vector<std::size_t>(coords.size()),
+	                       session_url, timepoint, channel, angle,
+	                       max_request_size,
+	                       std::numeric_limits<std::size_t>::max(),
+	                       std::numeric_limits<std::size_t>::max());
+}
+
+/* inline */ std::vector<std::pair<std::string, std::vector<std::size_t>>>
+create_requests(const std::vector<i3d::Vector3d<int>>& coords,
+                const std::vector<std::size_t>& block_bytes,
+                const std::string& session_url,
+                int timepoint,
+                int channel,
+                int angle,
+                std::size_t max_url_length,
+                std::size_t max_body_bytes,
+                std::size_t max_blocks) {
+	assert(coords.size() == block_bytes.size());
+	std::vector<std::pair<std::string, std::vector<std::size_t>>> out;
+
+	std::string final_url = session_url;
+	std::vector<std::size_t> indexes;
+	std::size_t body_bytes = 0;
+
+	for (std::size_t i = 0; i < coords.size(); ++i) {
+		const auto& coord = coords[i];
+		std::string to_append =
+		    fmt::format("/{}/{}/{}/{}/{}/{}", coord.x, coord.y, coord.z,
+		                timepoint, channel, angle);
+
+		if (!indexes.empty() &&
+		    (final_url.size() + to_append.size() > max_url_length ||
+		     body_bytes + block_bytes[i] > max_body_bytes ||
+		     indexes.size() >= max_blocks)) {
+			out.emplace_back(final_url, indexes);
+			final_url = session_url;
+			indexes.clear();
+			body_bytes = 0;
+		}
+
+		final_url += to_append;
+		indexes.push_back(i);
+		body_bytes += block_bytes[i];
+	}
+
+	if (!indexes.empty()) {
+		out.emplace_back(final_url, indexes);
+	}
+
+	return out;
+}
+
+template <typename F>
+void parallel_for(std::size_t count, F&& fn, std::size_t threads /* = 0 */) {
+	if (threads == 0)
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	threads = std::min(threads, count);
+
+	if (threads <= 1) {
+		for (std::size_t i = 0; i < count; ++i)
+			fn(i);
+		return;
+	}
+
+	std::atomic<std::size_t> next = 0;
+	std::exception_ptr error;
+	std::mutex error_mtx;
+
+	auto worker = [&]() {
+		for (std::size_t i = next++; i < count; i = next++) {
+			try {
+				fn(i);
+			} catch (...) {
+				std::scoped_lock lock(error_mtx);
+				if (!error)
+					error = std::current_exception();
+				next = count;
+			}
+		}
+	};
+
+	std::vector<std::jthread> pool;
+	for (std::size_t t = 0; t < threads; ++t)
+		pool.emplace_back(worker);
+	pool.clear(); // join
+
+	if (error)
+		std::rethrow_exception(error);
+}
+
+inline BufferPool::Buffer::Buffer(BufferPool* pool, std::vector<char> data)
+    : _pool(pool), _data(std::move(data)) {}
+
+inline BufferPool::Buffer::Buffer(Buffer&& other) noexcept
+    : _pool(std::exchange(other._pool, nullptr)),
+      _data(std::move(other._data)) {}
+
+inline BufferPool::Buffer&
+BufferPool::Buffer::operator=(Buffer&& other) noexcept {
+	if (this != &other) {
+		if (_pool)
+			_pool->release(std::move(_data));
+		_pool = std::exchange(other._pool, nullptr);
+		_data = std::move(other._data);
+	}
+	return *this;
+}
+
+inline BufferPool::Buffer::~Buffer() {
+	if (_pool)
+		_pool->release(std::move(_data));
+}
+
+inline BufferPool::BufferPool(
+    std::size_t max_cached /* = DEFAULT_MAX_CACHED */)
+    : _max_cached(max_cached) {}
+
+inline BufferPool::Buffer BufferPool::acquire(std::size_t size) {
+	/* Smallest class, whose buffers can hold <size> bytes */
+	std::size_t cls =
+	    std::bit_width(std::max(size, MIN_BUFFER_SIZE) - 1) -
+	    std::bit_width(MIN_BUFFER_SIZE - 1);
+
+	std::vector<char> data;
+	{
+		std::scoped_lock lock(_mutex);
+		if (cls < _free.size() && !_free[cls].empty()) {
+			data = std::move(_free[cls].back());
+			_free[cls].pop_back();
+			_cached -= data.capacity();
+		}
+	}
+
+	if (data.capacity() == 0)
+		data.reserve(MIN_BUFFER_SIZE << cls);
+	data.resize(size);
+	return Buffer(this, std::move(data));
+}
+
+inline BatchPlanner::BatchPlanner(BatchLimits limits /* = {} */)
+    : _limits(limits) {}
+
+inline BatchLimits BatchPlanner::get_limits() const {
+	std::scoped_lock lock(_mutex);
+	return _limits;
+}
+
+inline void BatchPlanner::set_limits(BatchLimits limits) {
+	std::scoped_lock lock(_mutex);
+	_limits = limits;
+}
+
+inline std::size_t BatchPlanner::body_limit() const {
+	std::scoped_lock lock(_mutex);
+	if (!_limits.adaptive)
+		return _limits.max_body_bytes;
+
+	/* Start small, grow with measured throughput */
+	double target = _throughput *
+	                std::chrono::duration<double>(_limits.target_duration).count();
+	std::size_t lower = std::min(_limits.min_body_bytes, _limits.max_body_bytes);
+	if (target <= double(lower))
+		return lower;
+	if (target >= double(_limits.max_body_bytes))
+		return _limits.max_body_bytes;
+	return std::size_t(target);
+}
+
+inline std::vector<std::pair<std::string, std::vector<std::size_t>>>
+BatchPlanner::plan(const std::vector<i3d::Vector3d<int>>& coords,
+                   const std::vector<std::size_t>& block_bytes,
+                   const std::string& session_url,
+                   int timepoint,
+                   int channel,
+                   int angle) const {
+	BatchLimits limits = get_limits();
+	return create_requests(coords, block_bytes, session_url, timepoint,
+	                       channel, angle, limits.max_url_length, body_limit(),
+	                       limits.max_blocks);
+}
+
+inline void BatchPlanner::record(std::size_t bytes,
+                                 std::chrono::nanoseconds duration) {
+	double seconds = std::chrono::duration<double>(duration).count();
+	if (bytes == 0 || seconds <= 0)
+		return;
+
+	double sample = double(bytes) / seconds;
+	std::scoped_lock lock(_mutex);
+	_throughput = _throughput == 0
+	                  ? sample
+	                  : SMOOTHING * sample + (1 - SMOOTHING) * _throughput;
+}
+
+inline Retrier::Retrier(RetryPolicy policy /* = {} */) : _policy(policy) {}
+
+inline RetryPolicy Retrier::get_policy() const {
+	std::scoped_lock lock(_mutex);
+	return _policy;
+}
+
+inline void Retrier::set_policy(RetryPolicy policy) {
+	std::scoped_lock lock(_mutex);
+	_policy = policy;
+}
+
+inline std::chrono::milliseconds Retrier::delay(int retry) {
+	std::scoped_lock lock(_mutex);
+
+	double base = double(_policy.initial_backoff.count()) *
+	              std::pow(_policy.multiplier, std::max(retry - 1, 0));
+	base = std::min(base, double(_policy.max_backoff.count()));
+
+	/* Randomize part of the delay, so that clients do not retry in sync */
+	double jitter = std::clamp(_policy.jitter, 0.0, 1.0);
+	std::uniform_real_distribution<double> dist(1.0 - jitter, 1.0);
+	return std::chrono::milliseconds((long long)(base * dist(_gen)));
+}
+
+inline Hedger::Hedger(HedgingPolicy policy /* = {} */) : _policy(policy) {}
+
+inline Hedger::~Hedger() {
+	{
+		std::scoped_lock lock(_tasks_mutex);
+		_stopping = true;
+		_tasks_cv.notify_all();
+	}
+
+	for (std::thread& worker : _workers)
+		worker.join();
+}
+
+inline HedgingPolicy Hedger::get_policy() const {
+	std::scoped_lock lock(_mutex);
+	return _policy;
+}
+
+inline void Hedger::set_policy(HedgingPolicy policy) {
+	std::scoped_lock lock(_mutex);
+	_policy = policy;
+}
+
+inline std::optional<std::chrono::nanoseconds> Hedger::threshold() const {
+	std::scoped_lock lock(_mutex);
+	if (!_policy.enabled || _samples.empty() ||
+	    _samples.size() < _policy.min_samples)
+		return {};
+
+	std::vector<std::chrono::nanoseconds> sorted = _samples;
+	double rank = std::clamp(_policy.percentile, 0.0, 100.0) / 100.0 *
+	              double(sorted.size() - 1);
+	auto nth = sorted.begin() + std::ptrdiff_t(rank);
+	std::ranges::nth_element(sorted, nth);
+
+	return std::max<std::chrono::nanoseconds>(*nth, _policy.min_delay);
+}
+
+inline bool Hedger::try_hedge() {
+	std::scoped_lock lock(_mutex);
+	if (double(_hedges + 1) > _policy.budget * double(_requests))
+		return false;
+
+	++_hedges;
+	return true;
+}
+
+inline void Hedger::record(std::chrono::nanoseconds duration) {
+	std::scoped_lock lock(_mutex);
+	++_requests;
+
+	if (_samples.size() < WINDOW)
+		_samples.push_back(duration);
+	else
+		_samples[_next] = duration;
+	_next = (_next + 1) % WINDOW;
+}
+
+inline void Hedger::spawn(std::function<void()> fn) {
+	std::scoped_lock lock(_tasks_mutex);
+	_tasks.push_back(std::move(fn));
+	if (_tasks.size() > _idle)
+		_workers.emplace_back([this]() { work(); });
+	else
+		_tasks_cv.notify_one();
+}
+
+inline void Hedger::work() {
+	std::unique_lock lock(_tasks_mutex);
+	for (;;) {
+		++_idle;
+		_tasks_cv.wait(lock, [&]() { return _stopping || !_tasks.empty(); });
+		--_idle;
+
+		/* Queued tasks are finished even when stopping */
+		if (_tasks.empty())
+			return;
+
+		std::function<void()> task = std::move(_tasks.front());
+		_tasks.pop_front();
+		lock.unlock();
+		task();
+		lock.lock();
+	}
+}
+
+inline ConcurrencyController::Slot::~Slot() {
+	if (_owner)
+		_owner->release();
+}
+
+inline ConcurrencyController::ConcurrencyController(
+    ConcurrencyPolicy policy /* = {} */)
+    : _policy(policy), _limit(double(policy.initial_limit)) {}
+
+inline std::shared_ptr<ConcurrencyController>
+ConcurrencyController::for_host(const std::string& ip, int port) {
+	static std::mutex mutex;
+	static std::map<std::string, std::weak_ptr<ConcurrencyController>> hosts;
+
+	std::scoped_lock lock(mutex);
+	std::weak_ptr<ConcurrencyController>& host =
+	    hosts[fmt::format("{}:{}", ip, port)];
+
+	std::shared_ptr<ConcurrencyController> out = host.lock();
+	if (!out) {
+		out = std::make_shared<ConcurrencyController>();
+		host = out;
+	}
+	return out;
+}
+
+inline ConcurrencyPolicy ConcurrencyController::get_policy() const {
+	std::scoped_lock lock(_mutex);
+	return _policy;
+}
+
+inline void ConcurrencyController::set_policy(ConcurrencyPolicy policy) {
+	std::scoped_lock lock(_mutex);
+	_policy = policy;
+	_limit = double(policy.initial_limit);
+	start_round();
+	_cv.notify_all();
+}
+
+inline std::size_t ConcurrencyController::limit() const {
+	std::scoped_lock lock(_mutex);
+	return cap();
+}
+
+inline ConcurrencyController::Slot
+ConcurrencyController::acquire(const CancellationToken* token /* = nullptr */) {
+	std::unique_lock lock(_mutex);
+	while (_in_flight >= cap()) {
+		if (!token) {
+			_cv.wait(lock);
+			continue;
+		}
+
+		token->throw_if_cancelled();
+		_cv.wait_for(lock, POLL);
+	}
+
+	++_in_flight;
+	if (_in_flight >= cap())
+		_round_saturated = true;
+	return Slot(this, _in_flight);
+}
+
+inline std::optional<ConcurrencyController::Slot>
+ConcurrencyController::try_acquire() {
+	std::scoped_lock lock(_mutex);
+	if (_in_flight >= cap())
+		return std::nullopt;
+
+	++_in_flight;
+	if (_in_flight >= cap())
+		_round_saturated = true;
+	return Slot(this, _in_flight);
+}
+
+inline void
+ConcurrencyController::record_success(const Slot& slot,
+                                      std::size_t bytes,
+                                      std::chrono::nanoseconds first_byte,
+                                      bool upload /* = false */) {
+	std::scoped_lock lock(_mutex);
+	double latency = std::chrono::duration<double>(first_byte).count();
+	double& baseline = _baselines[upload][std::bit_width(bytes)];
+	if (baseline == 0 || latency < baseline)
+		baseline = latency;
+	else
+		baseline += (latency - baseline) * BASELINE_DRIFT;
+
+	if (!_policy.adaptive)
+		return;
+
+	if (latency > baseline * _policy.latency_tolerance) {
+		decrease(slot);
+		return;
+	}
+
+	_round_bytes += bytes;
+	if (++_round_requests < cap())
+		return;
+
+	/* Grow, while it helps (after a round without gain, probe once more) */
+	double elapsed =
+	    std::chrono::duration<double>(clock::now() - _round_start).count();
+	double throughput = elapsed > 0 ? double(_round_bytes) / elapsed : 0;
+	bool gain = throughput > _throughput * (1 + MIN_GAIN);
+
+	_grown = _round_saturated && (gain || !_grown);
+	if (_grown)
+		_limit = std::min(_limit + 1, double(_policy.max_limit));
+	_throughput = throughput;
+	start_round();
+}
+
+inline void ConcurrencyController::record_congestion(const Slot& slot) {
+	std::scoped_lock lock(_mutex);
+	if (_policy.adaptive)
+		decrease(slot);
+}
+
+inline std::size_t ConcurrencyController::cap() const {
+	double limit = std::clamp(_limit, double(_policy.min_limit),
+	                          double(_policy.max_limit));
+	return std::max<std::size_t>(1, std::size_t(limit));
+}
+
+inline void ConcurrencyController::release() {
+	std::scoped_lock lock(_mutex);
+	--_in_flight;
+	_cv.notify_all();
+}
+
+inline void ConcurrencyController::decrease(const Slot& slot) {
+	/* Requests sent before the last decrease saw the same congestion */
+	if (slot._start < _last_decrease)
+		return;
+
+	_limit = std::max(_limit * _policy.backoff, double(_policy.min_limit));
+	_last_decrease = clock::now();
+	_throughput = 0;
+	_grown = false;
+	start_round();
+}
+
+inline EndpointPool::Lease::~Lease() {
+	if (_owner)
+		_owner->release(_index);
+}
+
+inline EndpointPool::EndpointPool(std::vector<Endpoint> endpoints)
+    : _endpoints(std::move(endpoints)), _states(_endpoints.size()) {
+	if (_endpoints.empty())
+		throw std::logic_error("No endpoints given");
+
+	for (const Endpoint& e : _endpoints)
+		_concurrency.push_back(ConcurrencyController::for_host(e.ip, e.port));
+}
+
+inline std::size_t EndpointPool::max_concurrency() const {
+	std::size_t out = 0;
+	for (const auto& concurrency : _concurrency)
+		out += concurrency->get_policy().max_limit;
+	return out;
+}
+
+inline EndpointPool::Lease EndpointPool::acquire() {
+	std::scoped_lock lock(_mutex);
+	clock::time_point now = clock::now();
+
+	std::size_t best = 0;
+	for (std::size_t i = 1; i < _states.size(); ++i)
+		if (rank(i, now) < rank(best, now))
+			best = i;
+
+	++_states[best].outstanding;
+	return Lease(this, best);
+}
+
+inline std::vector<std::size_t> EndpointPool::order() const {
+	std::scoped_lock lock(_mutex);
+	clock::time_point now = clock::now();
+
+	std::vector<std::size_t> out(_states.size());
+	std::iota(out.begin(), out.end(), 0);
+	std::ranges::stable_sort(out, [&](std::size_t a, std::size_t b) {
+		return rank(a, now) < rank(b, now);
+	});
+	return out;
+}
+
+inline void
+EndpointPool::record_success(std::size_t i,
+                             std::chrono::nanoseconds first_byte) {
+	std::scoped_lock lock(_mutex);
+	State& state = _states[i];
+	double latency = std::chrono::duration<double>(first_byte).count();
+
+	state.latency = state.latency == 0
+	                    ? latency
+	                    : state.latency + (latency - state.latency) * SMOOTHING;
+	state.failures = 0;
+	state.down_until = {};
+}
+
+inline void EndpointPool::record_failure(std::size_t i) {
+	std::scoped_lock lock(_mutex);
+	State& state = _states[i];
+
+	auto down_time = std::min<std::chrono::milliseconds>(
+	    MIN_DOWN_TIME * (1 << std::min(state.failures, 16)), MAX_DOWN_TIME);
+	++state.failures;
+	state.down_until = clock::now() + down_time;
+}
+
+inline std::tuple<bool, double, std::size_t>
+EndpointPool::rank(std::size_t i, clock::time_point now) const {
+	const State& state = _states[i];
+	return {state.down_until > now,
+	        double(state.outstanding + 1) * state.latency, state.outstanding};
+}
+
+inline void EndpointPool::release(std::size_t i) {
+	std::scoped_lock lock(_mutex);
+	--_states[i].outstanding;
+}
+
+inline void ConcurrencyController::start_round() {
+	_round_start = clock::now();
+	_round_requests = 0;
+	_round_bytes = 0;
+	_round_saturated = _in_flight >= cap();
+}
+
+namespace trace {
+inline Tracer& Tracer::instance() {
+	static Tracer tracer;
+	return tracer;
+}
+
+inline void Tracer::start() {
+	std::scoped_lock lock(_mutex);
+	_events.clear();
+	_origin = clock::now();
+	_enabled = true;
+}
+
+inline void Tracer::stop() { _enabled = false; }
+
+inline void Tracer::record(Event event) {
+	std::scoped_lock lock(_mutex);
+	_events.push_back(std::move(event));
+}
+
+inline std::string Tracer::to_json() const {
+	using std::chrono::duration;
+	using micros = duration<double, std::micro>;
+
+	std::scoped_lock lock(_mutex);
+	std::string out = "{\"traceEvents\": [";
+	for (std::size_t i = 0; i < _events.size(); ++i) {
+		const Event& e = _events[i];
+		out += fmt::format(
+		    "{}\n{{\"name\": \"{}\", \"cat\": \"{}\", \"ph\": \"X\", "
+		    "\"ts\": {:.3f}, \"dur\": {:.3f}, \"pid\": 1, \"tid\": {}, "
+		    "\"args\": {{{}}}}}",
+		    i == 0 ? "" : ",", e.name, e.category,
+		    micros(e.start - _origin).count(), micros(e.duration).count(),
+		    e.thread, e.args);
+	}
+	out += "\n], \"displayTimeUnit\": \"ms\"}\n";
+	return out;
+}
+
+/* inline */ int thread_id() {
+	static std::atomic<int> next = 0;
+	thread_local int id = next++;
+	return id;
+}
 
-	for (i3d::Vector3d<int> coord : coords)
-		if (data_manip::get_block_size(coord, block_dim, img_dim) ==
-		    i3d::Vector3d(0, 0, 0)) {
-			log::warning(fmt::format(
-			    "Block coordinate {} is out of valid range", to_string(coord)));
+inline Span::Span(const char* name, const char* category)
+    : _active(Tracer::instance().enabled()), _name(name),
+      _category(category) {
+	if (_active)
+		_start = Tracer::clock::now();
+}
 
-			return false;
-		}
-	log::info("Check successfullly finished");
-	return true;
+inline Span::~Span() {
+	if (!_active)
+		return;
+
+	Tracer::instance().record({_name, _category, std::move(_args), _start,
+	                           Tracer::clock::now() - _start, thread_id()});
 }
+} // namespace trace
 
-/* inline */ std::vector<i3d::Vector3d<int>>
-get_intercepted_blocks(i3d::Vector3d<int> start_point,
-                       i3d::Vector3d<int> end_point,
-                       i3d::Vector3d<int> img_dim,
-                       i3d::Vector3d<int> block_dim) {
-	assert(lt(start_point, end_point));
+template <bool Enabled>
+typename BasicMetricsRegistry<Enabled>::clock::time_point
+BasicMetricsRegistry<Enabled>::now() {
+	return clock::now();
+}
 
-	i3d::Vector3d<int> block_count = (img_dim + block_dim - 1) / block_dim;
-	std::vector<i3d::Vector3d<int>> out;
+template <bool Enabled>
+void BasicMetricsRegistry<Enabled>::record(std::string_view name,
+                                           std::uint64_t value) {
+	std::scoped_lock lock(_mutex);
+	_metrics.histograms[std::string(name)].record(value);
+}
 
-	for (int x = 0; x < block_count.x; ++x)
-		for (int y = 0; y < block_count.y; ++y)
-			for (int z = 0; z < block_count.z; ++z) {
-				i3d::Vector3d<int> coord = {x, y, z};
-				if (lt(start_point, (coord + 1) * block_dim) &&
-				    lt(coord * block_dim, end_point))
-					out.push_back(coord);
-			}
+template <bool Enabled>
+void BasicMetricsRegistry<Enabled>::record(std::string_view name,
+                                           clock::duration duration) {
+	auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(duration);
+	record(name, std::uint64_t(std::max<std::int64_t>(0, ns.count())));
+}
 
-	return out;
+template <bool Enabled>
+void BasicMetricsRegistry<Enabled>::add(std::string_view name,
+                                        std::uint64_t value) {
+	std::scoped_lock lock(_mutex);
+	_metrics.counters[std::string(name)] += value;
 }
 
-/* inline */ std::vector<std::pair<std::string, std::vector<std::size_t>>>
-create_requests(const std::vector<i3d::Vector3d<int>>& coords,
-                const std::string& session_url,
-                int timepoint,
-                int channel,
-                int angle,
-                std::size_t max_request_size /* = MAX_URL_LENGTH*/) {
-	std::vector<std::pair<std::string, std::vector<std::size_t>>> out;
+template <bool Enabled>
+Metrics BasicMetricsRegistry<Enabled>::snapshot() const {
+	std::scoped_lock lock(_mutex);
+	return _metrics;
+}
 
-	std::string final_url = session_url;
-	std::vector<std::size_t> indexes;
+template <bool Enabled>
+void BasicMetricsRegistry<Enabled>::reset() {
+	std::scoped_lock lock(_mutex);
+	_metrics = {};
+}
 
-	for (std::size_t i = 0; i < coords.size(); ++i) {
-		const auto& coord = coords[i];
-		std::string to_append =
-		    fmt::format("/{}/{}/{}/{}/{}/{}", coord.x, coord.y, coord.z,
-		                timepoint, channel, angle);
+inline std::size_t BufferPool::cached_bytes() const {
+	std::scoped_lock lock(_mutex);
+	return _cached;
+}
 
-		if (final_url.size() + to_append.size() > max_request_size) {
-			out.emplace_back(final_url, indexes);
-			final_url = session_url;
-			indexes.clear();
-		}
+inline void BufferPool::release(std::vector<char>&& data) {
+	if (data.capacity() < MIN_BUFFER_SIZE)
+		return;
 
-		final_url += to_append;
-		indexes.push_back(i);
-	}
+	/* Largest class, whose size the buffer can hold */
+	std::size_t cls = std::bit_width(data.capacity()) -
+	                  std::bit_width(MIN_BUFFER_SIZE);
 
-	if (!indexes.empty()) {
-		out.emplace_back(final_url, indexes);
-	}
+	std::scoped_lock lock(_mutex);
+	if (_cached + data.capacity() > _max_cached)
+		return;
 
-	return out;
+	if (_free.size() <= cls)
+		_free.resize(cls + 1);
+	_cached += data.capacity();
+	_free[cls].push_back(std::move(data));
 }
 
 namespace data_manip {
@@ -478,30 +2312,100 @@ void set_elem_at(std::span<char> data,
 	set_elem_at(data, voxel_type, index, elem);
 }
 
+template <typename T>
+T load_big_endian(const char* src, int elem_size) {
+	std::array<char, sizeof(T)> buffer{};
+	std::reverse_copy(src, src + elem_size, buffer.begin());
+	return std::bit_cast<T>(buffer);
+}
+
+template <typename T>
+void store_big_endian(char* dest, int elem_size, T elem) {
+	auto buffer = std::bit_cast<std::array<char, sizeof(T)>>(elem);
+	std::reverse_copy(buffer.begin(), buffer.begin() + elem_size, dest);
+}
+
 template <typename T>
 void read_data(std::span<const char> data,
                const std::string& voxel_type,
                i3d::Image3d<T>& dest,
                i3d::Vector3d<int> offset,
                i3d::Vector3d<int> block_size) {
+	read_data(data, voxel_type, make_view(dest), offset, block_size);
+}
+
+template <typename T>
+void read_data(std::span<const char> data,
+               const std::string& voxel_type,
+               StridedView<T> dest,
+               i3d::Vector3d<int> offset,
+               i3d::Vector3d<int> block_size) {
+	trace::Span span("read_data", "codec");
+	if (span)
+		span.set_args(fmt::format("\"block_size\": \"{}\"",
+		                          to_string(block_size)));
 
 	assert(std::size_t(get_block_data_size(block_size, voxel_type)) ==
 	       data.size());
 
-	for (int x = 0; x < block_size.x; ++x)
-		for (int y = 0; y < block_size.y; ++y)
-			for (int z = 0; z < block_size.z; ++z) {
-				i3d::Vector3d<int> coord{x + offset.x, y + offset.y,
-				                         z + offset.z};
+	/* Part of the block within destination */
+	i3d::Vector3d<int> from, to;
+	for (int i = 0; i < 3; ++i) {
+		from[i] = std::max(0, -offset[i]);
+		to[i] = std::min(block_size[i], dest.size[i] - offset[i]);
+		if (from[i] >= to[i])
+			return;
+	}
+
+	int elem_size = type_byte_size.at(voxel_type);
+	for (int z = from.z; z < to.z; ++z)
+		for (int y = from.y; y < to.y; ++y) {
+			const char* src =
+			    data.data() +
+			    get_linear_index({from.x, y, z}, block_size, voxel_type);
+			T* out = &dest.at(offset.x + from.x, offset.y + y, offset.z + z);
+
+			for (int x = 0; x < to.x - from.x; ++x)
+				out[x * dest.strides.x] =
+				    load_big_endian<T>(src + x * elem_size, elem_size);
+		}
+}
+
+template <typename T>
+void record_data(std::span<const char> data,
+                 const std::string& voxel_type,
+                 Statistics& stats,
+                 i3d::Vector3d<int> region_size,
+                 i3d::Vector3d<int> offset,
+                 i3d::Vector3d<int> block_size) {
+	trace::Span span("record_data", "codec");
+	if (span)
+		span.set_args(fmt::format("\"block_size\": \"{}\"",
+		                          to_string(block_size)));
 
-				if (!(0 <= coord.x && coord.x < int(dest.GetSizeX())) ||
-				    !(0 <= coord.y && coord.y < int(dest.GetSizeY())) ||
-				    !(0 <= coord.z && coord.z < int(dest.GetSizeZ())))
-					continue;
+	assert(std::size_t(get_block_data_size(block_size, voxel_type)) ==
+	       data.size());
 
-				dest.SetVoxel(coord, get_elem_at<T>(data, voxel_type, {x, y, z},
-				                                    block_size));
-			}
+	/* Part of the block within region */
+	i3d::Vector3d<int> from, to;
+	for (int i = 0; i < 3; ++i) {
+		from[i] = std::max(0, -offset[i]);
+		to[i] = std::min(block_size[i], region_size[i] - offset[i]);
+		if (from[i] >= to[i])
+			return;
+	}
+
+	int elem_size = type_byte_size.at(voxel_type);
+	for (int z = from.z; z < to.z; ++z)
+		for (int y = from.y; y < to.y; ++y) {
+			const char* src =
+			    data.data() +
+			    get_linear_index({from.x, y, z}, block_size, voxel_type);
+
+			for (int x = 0; x < to.x - from.x; ++x)
+				stats.record(
+				    double(load_big_endian<T>(src + x * elem_size, elem_size)));
+		}
 }
 
 template <typename T>
@@ -510,54 +2414,638 @@ void write_data(const i3d::Image3d<T>& src,
                 std::span<char> data,
                 const std::string& voxel_type,
                 i3d::Vector3d<int> block_size) {
+	write_data(make_view(src), offset, data, voxel_type, block_size);
+}
+
+template <typename T>
+void write_data(StridedView<const T> src,
+                i3d::Vector3d<int> offset,
+                std::span<char> data,
+                const std::string& voxel_type,
+                i3d::Vector3d<int> block_size) {
+	trace::Span span("write_data", "codec");
+	if (span)
+		span.set_args(fmt::format("\"block_size\": \"{}\"",
+		                          to_string(block_size)));
 
 	assert(data.size() ==
 	       std::size_t(get_block_data_size(block_size, voxel_type)));
+	assert(lt(offset + block_size, src.size + 1));
 
 	set_elem_at(data, "int32", 0, block_size.x);
 	set_elem_at(data, "int32", 4, block_size.y);
 	set_elem_at(data, "int32", 8, block_size.z);
 
-	for (int x = 0; x < block_size.x; ++x)
-		for (int y = 0; y < block_size.y; ++y)
-			for (int z = 0; z < block_size.z; ++z) {
-				assert(x + offset.x < int(src.GetSizeX()));
-				assert(y + offset.y < int(src.GetSizeY()));
-				assert(z + offset.z < int(src.GetSizeZ()));
+	int elem_size = type_byte_size.at(voxel_type);
+	for (int z = 0; z < block_size.z; ++z)
+		for (int y = 0; y < block_size.y; ++y) {
+			char* out = data.data() +
+			            get_linear_index({0, y, z}, block_size, voxel_type);
+			const T* in = &src.at(offset.x, offset.y + y, offset.z + z);
+
+			for (int x = 0; x < block_size.x; ++x)
+				store_big_endian(out + x * elem_size, elem_size,
+				                 in[x * src.strides.x]);
+		}
+}
 
-				set_elem_at(
-				    data, voxel_type, {x, y, z}, block_size,
-				    src.GetVoxel(x + offset.x, y + offset.y, z + offset.z));
-			}
+template <typename T>
+StridedView<T> make_view(i3d::Image3d<T>& img) {
+	return StridedView<T>::contiguous(
+	    std::span<T>(img.GetFirstVoxelAddr(), img.GetImageSize()),
+	    img.GetSize());
+}
+
+template <typename T>
+StridedView<const T> make_view(const i3d::Image3d<T>& img) {
+	return StridedView<const T>::contiguous(
+	    std::span<const T>(img.GetFirstVoxelAddr(), img.GetImageSize()),
+	    img.GetSize());
 }
 } // namespace data_manip
 
+namespace pyramids {
+/* inline */ std::optional<i3d::Vector3d<int>>
+get_level_ratio(i3d::Vector3d<int> fine, i3d::Vector3d<int> coarse) {
+	for (int i = 0; i < 3; ++i)
+		if (fine[i] <= 0 || coarse[i] % fine[i] != 0)
+			return std::nullopt;
+	return coarse / fine;
+}
+
+/* inline */ std::vector<i3d::Vector3d<int>>
+get_generation_order(const DatasetProperties& props) {
+	std::vector<i3d::Vector3d<int>> out = props.get_all_resolutions();
+	if (std::ranges::find(out, i3d::Vector3d<int>{1, 1, 1}) == out.end())
+		out.emplace_back(1, 1, 1);
+
+	std::ranges::sort(out, [](auto lhs, auto rhs) {
+		return std::tuple(lhs.x * lhs.y * lhs.z, lhs.x, lhs.y, lhs.z) <
+		       std::tuple(rhs.x * rhs.y * rhs.z, rhs.x, rhs.y, rhs.z);
+	});
+	return out;
+}
+
+/* inline */ std::vector<i3d::Vector3d<int>>
+get_parent_blocks(const std::vector<i3d::Vector3d<int>>& children,
+                  i3d::Vector3d<int> fine,
+                  i3d::Vector3d<int> coarse,
+                  const DatasetProperties& props) {
+	i3d::Vector3d<int> ratio = get_level_ratio(fine, coarse).value();
+	i3d::Vector3d<int> child_dim = props.get_block_dimensions(fine);
+	i3d::Vector3d<int> parent_dim = props.get_block_dimensions(coarse);
+	i3d::Vector3d<int> level_dim = props.get_img_dimensions(coarse);
+
+	std::vector<i3d::Vector3d<int>> out;
+	for (auto child : children) {
+		i3d::Vector3d<int> size = props.get_block_size(child, fine);
+		if (size.x <= 0 || size.y <= 0 || size.z <= 0)
+			continue;
+
+		/* Coarser voxels whose window overlaps the child block */
+		i3d::Vector3d<int> start = child * child_dim;
+		i3d::Vector3d<int> end = start + size;
+		for (auto parent : get_intercepted_blocks(
+		         start / ratio, (end + ratio - 1) / ratio, level_dim,
+		         parent_dim))
+			out.push_back(parent);
+	}
+
+	unique_blocks(out);
+	return out;
+}
+
+/* inline */ void unique_blocks(std::vector<i3d::Vector3d<int>>& coords) {
+	auto less = [](const auto& lhs, const auto& rhs) {
+		return std::tie(lhs.x, lhs.y, lhs.z) < std::tie(rhs.x, rhs.y, rhs.z);
+	};
+	std::ranges::sort(coords, less);
+	auto [first, last] = std::ranges::unique(coords);
+	coords.erase(first, last);
+}
+
+template <typename T>
+void downsample(const i3d::Image3d<T>& src,
+                i3d::Image3d<T>& dest,
+                i3d::Vector3d<int> dest_size,
+                i3d::Vector3d<int> factor,
+                SamplingMode m) {
+	assert(lt(dest_size * factor, i3d::Vector3d<int>(src.GetSize()) + 1));
+
+	if (m == SamplingMode::NEAREST_NEIGHBOUR) {
+		reduce(src, dest, dest_size, factor, ReductionMode::NEAREST);
+		return;
+	}
+
+	dest.MakeRoom(dest_size);
+	if (dest.GetImageSize() == 0)
+		return;
+
+	/* Resample slabs of approximately the same thickness */
+	std::size_t threads = std::max(1u, std::thread::hardware_concurrency());
+	int slab_depth = std::max(1, dest_size.z / int(threads));
+	int slab_count = (dest_size.z + slab_depth - 1) / slab_depth;
+
+	parallel_for(std::size_t(slab_count), [&](std::size_t s) {
+		int z_from = int(s) * slab_depth;
+		int z_to = std::min(dest_size.z, z_from + slab_depth);
+
+		/* Slab is resampled together with its halo, which is then dropped */
+		int halo_from = std::max(0, z_from - DOWNSAMPLE_HALO);
+		int halo_to = std::min(dest_size.z, z_to + DOWNSAMPLE_HALO);
+
+		i3d::Image3d<T> src_slab;
+		src_slab.MakeRoom(dest_size.x * factor.x, dest_size.y * factor.y,
+		                  (halo_to - halo_from) * factor.z);
+		for (std::size_t z = 0; z < src_slab.GetSizeZ(); ++z)
+			for (std::size_t y = 0; y < src_slab.GetSizeY(); ++y)
+				std::copy_n(
+				    src.GetVoxelAddr(0, y,
+				                     z + std::size_t(halo_from * factor.z)),
+				    src_slab.GetSizeX(), src_slab.GetVoxelAddr(0, y, z));
+
+		i3d::Image3d<T> dest_slab;
+		i3d::Resample(src_slab, dest_slab, dest_size.x, dest_size.y,
+		              halo_to - halo_from, m);
+		std::copy_n(
+		    dest_slab.GetVoxelAddr(0, 0, std::size_t(z_from - halo_from)),
+		    std::size_t(dest_size.x) * std::size_t(dest_size.y) *
+		        std::size_t(z_to - z_from),
+		    dest.GetVoxelAddr(0, 0, std::size_t(z_from)));
+	});
+}
+
+/* Type used to sum up voxels of one window */
+template <typename T>
+using window_sum_t = std::conditional_t<
+    std::is_floating_point_v<T>,
+    T,
+    std::conditional_t<
+        (sizeof(T) < 4),
+        std::conditional_t<std::is_signed_v<T>, int32_t, uint32_t>,
+        std::conditional_t<(sizeof(T) == 4),
+                           std::conditional_t<std::is_signed_v<T>,
+                                              int64_t,
+                                              uint64_t>,
+                           long double>>>;
+
+template <typename T>
+void reduce(const i3d::Image3d<T>& src,
+            i3d::Image3d<T>& dest,
+            i3d::Vector3d<int> dest_size,
+            i3d::Vector3d<int> factor,
+            ReductionMode mode) {
+	assert(lt(dest_size * factor, i3d::Vector3d<int>(src.GetSize()) + 1));
+
+	dest.MakeRoom(dest_size);
+	if (dest.GetImageSize() == 0)
+		return;
+
+	using sum_t = window_sum_t<T>;
+	const std::size_t row_len = std::size_t(dest_size.x * factor.x);
+	const std::size_t fx = std::size_t(factor.x);
+	const std::size_t window = std::size_t(factor.x * factor.y * factor.z);
+
+	/* Rows of source image contributing to one row of destination */
+	auto src_rows = [&](std::size_t y, std::size_t z) {
+		std::vector<const T*> rows;
+		for (int dz = 0; dz < factor.z; ++dz)
+			for (int dy = 0; dy < factor.y; ++dy)
+				rows.push_back(src.GetVoxelAddr(
+				    0, y * std::size_t(factor.y) + std::size_t(dy),
+				    z * std::size_t(factor.z) + std::size_t(dz)));
+		return rows;
+	};
+
+	/* One z-slice of destination per work item */
+	parallel_for(std::size_t(dest_size.z), [&](std::size_t z) {
+		std::vector<sum_t> sums(row_len);
+		std::vector<T> acc(row_len);
+		std::vector<T> values(window);
+
+		for (std::size_t y = 0; y < std::size_t(dest_size.y); ++y) {
+			T* out = dest.GetVoxelAddr(0, y, z);
+			std::vector<const T*> rows = src_rows(y, z);
+
+			switch (mode) {
+			case ReductionMode::NEAREST:
+				for (std::size_t x = 0; x < std::size_t(dest_size.x); ++x)
+					out[x] = rows[0][x * fx];
+				break;
+
+			case ReductionMode::AVERAGE:
+				std::fill(sums.begin(), sums.end(), sum_t(0));
+				for (const T* row : rows)
+					for (std::size_t i = 0; i < row_len; ++i)
+						sums[i] += sum_t(row[i]);
+
+				for (std::size_t x = 0; x < std::size_t(dest_size.x); ++x) {
+					sum_t sum = 0;
+					for (std::size_t i = 0; i < fx; ++i)
+						sum += sums[x * fx + i];
+
+					if constexpr (std::is_integral_v<sum_t>) {
+						/* Round half away from zero */
+						sum_t n = sum_t(window);
+						if constexpr (std::is_signed_v<T>)
+							out[x] = T(sum < 0 ? -((-sum + n / 2) / n)
+							                   : (sum + n / 2) / n);
+						else
+							out[x] = T((sum + n / 2) / n);
+					} else if constexpr (std::is_integral_v<T>)
+						out[x] = T(std::round(sum / sum_t(window)));
+					else
+						out[x] = T(sum / sum_t(window));
+				}
+				break;
+
+			case ReductionMode::MAX:
+			case ReductionMode::MIN: {
+				bool is_max = mode == ReductionMode::MAX;
+				std::copy_n(rows[0], row_len, acc.begin());
+				for (std::size_t r = 1; r < rows.size(); ++r) {
+					const T* row = rows[r];
+					if (is_max)
+						for (std::size_t i = 0; i < row_len; ++i)
+							acc[i] = std::max(acc[i], row[i]);
+					else
+						for (std::size_t i = 0; i < row_len; ++i)
+							acc[i] = std::min(acc[i], row[i]);
+				}
+
+				for (std::size_t x = 0; x < std::size_t(dest_size.x); ++x) {
+					T val = acc[x * fx];
+					for (std::size_t i = 1; i < fx; ++i)
+						val = is_max ? std::max(val, acc[x * fx + i])
+						             : std::min(val, acc[x * fx + i]);
+					out[x] = val;
+				}
+				break;
+			}
+
+			case ReductionMode::MODE:
+				for (std::size_t x = 0; x < std::size_t(dest_size.x); ++x) {
+					std::size_t n = 0;
+					for (const T* row : rows)
+						for (std::size_t i = 0; i < fx; ++i)
+							values[n++] = row[x * fx + i];
+
+					/* Homogeneous windows are the most common in labels */
+					if (std::all_of(values.begin(), values.end(),
+					                [&](T v) { return v == values[0]; })) {
+						out[x] = values[0];
+						continue;
+					}
+
+					/* Ties are resolved in favour of the smallest value */
+					std::sort(values.begin(), values.end());
+					T best = values[0];
+					std::size_t best_count = 0;
+					for (std::size_t i = 0; i < n;) {
+						std::size_t j = i;
+						while (j < n && values[j] == values[i])
+							++j;
+						if (j - i > best_count) {
+							best = values[i];
+							best_count = j - i;
+						}
+						i = j;
+					}
+					out[x] = best;
+				}
+				break;
+			}
+		}
+	});
+}
+} // namespace pyramids
+
+namespace files {
+inline MappedFile::MappedFile(const std::string& path, std::size_t size)
+    : _size(size) {
+	_fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (_fd < 0)
+		throw std::system_error(errno, std::generic_category(),
+		                        fmt::format("Cannot open {}", path));
+
+	if (::ftruncate(_fd, off_t(size)) != 0) {
+		int err = errno;
+		::close(_fd);
+		throw std::system_error(err, std::generic_category(),
+		                        fmt::format("Cannot resize {}", path));
+	}
+
+	if (size == 0)
+		return;
+
+	void* addr =
+	    ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+	if (addr == MAP_FAILED) {
+		int err = errno;
+		::close(_fd);
+		throw std::system_error(err, std::generic_category(),
+		                        fmt::format("Cannot map {}", path));
+	}
+	_data = static_cast<char*>(addr);
+}
+
+inline MappedFile::~MappedFile() {
+	if (_data)
+		::munmap(_data, _size);
+	::close(_fd);
+}
+
+inline void MappedFile::sync() {
+	if (_data && ::msync(_data, _size, MS_SYNC) != 0)
+		throw std::system_error(errno, std::generic_category(),
+		                        "Cannot write mapped file");
+}
+
+/* inline */ std::string get_nrrd_header(const DatasetProperties& props,
+                                         i3d::Vector3d<int> resolution) {
+	static const std::map<std::string, std::string> nrrd_types{
+	    {"float32", "float"}, {"float64", "double"}};
+
+	auto type = nrrd_types.find(props.voxel_type);
+	i3d::Vector3d<int> dim = props.get_img_dimensions(resolution);
+
+	std::string out = "NRRD0004\n";
+	out += fmt::format("type: {}\n", type == nrrd_types.end()
+	                                      ? props.voxel_type
+	                                      : type->second);
+	out += "dimension: 3\n";
+	out += fmt::format("sizes: {} {} {}\n", dim.x, dim.y, dim.z);
+	if (props.voxel_resolution) {
+		i3d::Vector3d<double> spacing = *props.voxel_resolution;
+		out += fmt::format("spacings: {} {} {}\n", spacing.x * resolution.x,
+		                   spacing.y * resolution.y, spacing.z * resolution.z);
+	}
+	out += fmt::format("endian: {}\n",
+	                   std::endian::native == std::endian::little ? "little"
+	                                                              : "big");
+	out += "encoding: raw\n";
+
+	/* Pad by comment, so the header ends at aligned offset */
+	std::size_t padded = (out.size() + 3 + 63) / 64 * 64;
+	out += "#" + std::string(padded - out.size() - 3, ' ') + "\n\n";
+	return out;
+}
+
+/* inline */ std::string get_slice_path(const std::string& pattern, int z) {
+	try {
+		return fmt::format(fmt::runtime(pattern), z);
+	} catch (const std::runtime_error& e) {
+		throw std::logic_error(
+		    fmt::format("Invalid slice path pattern {}: {}", pattern, e.what()));
+	}
+}
+
+template <cnpts::FileVoxel T>
+constexpr i3d::ImgVoxelType get_file_voxel_type() {
+	if constexpr (std::is_same_v<T, uint8_t>)
+		return i3d::Gray8Voxel;
+	else if constexpr (std::is_same_v<T, uint16_t>)
+		return i3d::Gray16Voxel;
+	else
+		return i3d::FloatVoxel;
+}
+
+template <cnpts::FileVoxel T>
+void write_slices(const i3d::Image3d<T>& slab,
+                  const std::string& pattern,
+                  int first,
+                  i3d::FileFormat format) {
+	i3d::Vector3d<std::size_t> slice_size(slab.GetSizeX(), slab.GetSizeY(), 1);
+
+	parallel_for(
+	    slab.GetSizeZ(),
+	    [&](std::size_t z) {
+		    std::string path = get_slice_path(pattern, first + int(z));
+		    std::unique_ptr<i3d::ImageWriter, void (*)(i3d::ImageWriter*)>
+		        writer(i3d::CreateWriter(path.c_str(), format, slice_size),
+		               i3d::DestroyWriter);
+		    if (!writer)
+			    throw std::logic_error(
+			        fmt::format("Cannot create image writer for {}", path));
+
+		    try {
+			    writer->SetDim(slice_size);
+			    writer->SetVoxelType(get_file_voxel_type<T>());
+			    writer->SaveImageInfo();
+			    writer->SaveImageData(slab.GetVoxelAddr(0, 0, z));
+		    } catch (const i3d::LibException& e) {
+			    throw std::logic_error(
+			        fmt::format("Cannot write {}: {}", path, e.what));
+		    }
+	    },
+	    SLICE_FILE_STREAMS);
+}
+
+template <cnpts::FileVoxel T>
+void read_slices(i3d::Image3d<T>& slab,
+                 const std::string& pattern,
+                 int first) {
+	i3d::Vector3d<std::size_t> slice_size(slab.GetSizeX(), slab.GetSizeY(), 1);
+
+	parallel_for(
+	    slab.GetSizeZ(),
+	    [&](std::size_t z) {
+		    std::string path = get_slice_path(pattern, first + int(z));
+		    try {
+			    std::unique_ptr<i3d::ImageReader, void (*)(i3d::ImageReader*)>
+			        reader(i3d::CreateReader(path.c_str()), i3d::DestroyReader);
+			    if (!reader)
+				    throw std::logic_error(
+				        fmt::format("Cannot create image reader for {}", path));
+
+			    reader->LoadImageInfo();
+			    if (reader->GetDim() != slice_size)
+				    throw std::logic_error(fmt::format(
+				        "Slice {} has size {}, expected {}", path,
+				        to_string(i3d::Vector3d<int>(reader->GetDim())),
+				        to_string(i3d::Vector3d<int>(slice_size))));
+
+			    if (reader->GetVoxelType() != get_file_voxel_type<T>())
+				    throw std::logic_error(
+				        fmt::format("Slice {} has voxel type {}", path,
+				                    i3d::VoxelTypeToString(
+				                        reader->GetVoxelType())));
+
+			    reader->LoadImageData(slab.GetVoxelAddr(0, 0, z));
+		    } catch (const i3d::LibException& e) {
+			    throw std::logic_error(
+			        fmt::format("Cannot read {}: {}", path, e.what));
+		    }
+	    },
+	    SLICE_FILE_STREAMS);
+}
+} // namespace files
+
 namespace log {
-/* inline */ void _log(const std::string& msg,
-                       const std::string& type,
-                       const std::source_location& location) {
+inline Logger& Logger::instance() {
+	static Logger logger;
+	return logger;
+}
+
+inline Logger::Logger() : _slots(new Slot[CAPACITY]), _sinks{stdout_sink} {
+	for (std::size_t i = 0; i < CAPACITY; ++i)
+		_slots[i].sequence.store(i, std::memory_order_relaxed);
+
+	_worker = std::thread([this] { run(); });
+}
+
+inline Logger::~Logger() {
+	_stop = true;
+	_idle = false;
+	_idle.notify_one();
+	_worker.join();
+}
+
+inline void Logger::set_sink(LogSink sink) {
+	std::scoped_lock lock(_sinks_mutex);
+	_sinks.clear();
+	if (sink)
+		_sinks.push_back(std::move(sink));
+}
+
+inline void Logger::add_sink(LogSink sink) {
+	std::scoped_lock lock(_sinks_mutex);
+	_sinks.push_back(std::move(sink));
+}
+
+inline void Logger::push(LogLevel level,
+                         std::string msg,
+                         const std::source_location& location) {
+	/* Multi-producer part of bounded MPMC queue (D. Vyukov) */
+	std::size_t pos = _enqueue.load(std::memory_order_relaxed);
+	Slot* slot;
+	for (;;) {
+		slot = &_slots[pos & (CAPACITY - 1)];
+		std::size_t seq = slot->sequence.load(std::memory_order_acquire);
+		auto diff = std::ptrdiff_t(seq) - std::ptrdiff_t(pos);
+
+		if (diff == 0) {
+			if (_enqueue.compare_exchange_weak(pos, pos + 1,
+			                                   std::memory_order_relaxed))
+				break;
+		} else if (diff < 0) {
+			_dropped.fetch_add(1, std::memory_order_relaxed);
+			return;
+		} else
+			pos = _enqueue.load(std::memory_order_relaxed);
+	}
+
+	slot->message = {level, std::move(msg), location.function_name(),
+	                 location.line()};
+	_pushed.fetch_add(1, std::memory_order_relaxed);
+	slot->sequence.store(pos + 1, std::memory_order_release);
+
+	if (_idle.exchange(false))
+		_idle.notify_one();
+}
+
+inline bool Logger::pop(Message& out) {
+	Slot& slot = _slots[_dequeue & (CAPACITY - 1)];
+	if (slot.sequence.load(std::memory_order_acquire) != _dequeue + 1)
+		return false;
+
+	out = std::move(slot.message);
+	slot.sequence.store(_dequeue + CAPACITY, std::memory_order_release);
+	++_dequeue;
+	return true;
+}
+
+inline void Logger::run() {
+	Message message;
+	for (;;) {
+		bool any = false;
+		while (pop(message)) {
+			write(message);
+			any = true;
+			_written.fetch_add(1, std::memory_order_release);
+			_written.notify_all();
+		}
+
+		if (std::size_t dropped = _dropped.exchange(0)) {
+			write({LogLevel::WARNING,
+			       fmt::format("{} log messages were dropped", dropped),
+			       "ds::details::log::Logger", 0});
+			continue;
+		}
+
+		if (any)
+			continue;
+		if (_stop)
+			return;
+
+		/* Sleep until a producer (or destructor) resets the flag */
+		_idle = true;
+		if (_slots[_dequeue & (CAPACITY - 1)].sequence.load(
+		        std::memory_order_acquire) == _dequeue + 1 ||
+		    _stop) {
+			_idle = false;
+			continue;
+		}
+		_idle.wait(true);
+	}
+}
+
+inline void Logger::write(const Message& message) {
+	std::string text = fmt::format(
+	    "[{}] {} at row {}:\n{} \n\n",
+	    message.level == LogLevel::INFO ? "INFO" : "WARNING", message.function,
+	    message.line, message.text);
+
+	std::scoped_lock lock(_sinks_mutex);
+	for (const auto& sink : _sinks)
+		sink(message.level, text);
+}
+
+inline void Logger::flush() {
+	std::size_t target = _pushed.load(std::memory_order_relaxed);
+	for (;;) {
+		std::size_t written = _written.load(std::memory_order_acquire);
+		if (written >= target)
+			return;
+		_written.wait(written);
+	}
+}
+
+inline void Logger::stdout_sink(LogLevel, const std::string& msg) {
+	std::cout << msg << std::flush;
+}
+
+template <typename... Args>
+void _log(LogLevel level,
+          const std::source_location& location,
+          fmt::format_string<Args...> format,
+          Args&&... args) {
 	if constexpr (!_LOG_)
 		return;
 
-	std::cout << fmt::format("[{}] {} at row {}:\n{} \n\n", type,
-	                         location.function_name(), location.line(), msg);
+	/* Level is checked first, disabled messages are never formatted */
+	Logger& logger = Logger::instance();
+	if (logger.enabled(level))
+		logger.push(level, fmt::format(format, std::forward<Args>(args)...),
+		            location);
 }
 
-/* inline */ void info(const std::string& msg,
-                       const std::source_location&
-                           location /* = std::source_location::current() */) {
+template <typename... Args>
+void info(LocatedFormat<std::type_identity_t<Args>...> format,
+          Args&&... args) {
 	if constexpr (!_INFO_)
 		return;
-	_log(msg, "INFO", location);
+	_log(LogLevel::INFO, format.location, format.str,
+	     std::forward<Args>(args)...);
 }
 
-/* inline */ void
-warning(const std::string& msg,
-        const std::source_location&
-            location /* = std::source_location::current() */) {
+template <typename... Args>
+void warning(LocatedFormat<std::type_identity_t<Args>...> format,
+             Args&&... args) {
 	if constexpr (!_WARNING_)
 		return;
-	_log(msg, "WARNING", location);
+	_log(LogLevel::WARNING, format.location, format.str,
+	     std::forward<Args>(args)...);
 }
 } // namespace log
 
@@ -566,7 +3054,7 @@ namespace props_parser {
 template <cnpts::Basic T>
 T get_elem(Object::Ptr root, const std::string& name) {
 	if (!root->has(name)) {
-		log::warning(fmt::format("{} was not found", name));
+		log::warning("{} was not found", name);
 		return {};
 	}
 	return root->getValue<T>(name);
@@ -576,7 +3064,7 @@ template <cnpts::Vector3d T>
 T get_elem(Object::Ptr root, const std::string& name) {
 	using V = decltype(T{}.x);
 	if (!root->has(name)) {
-		log::warning(fmt::format("{} were not found", name));
+		log::warning("{} were not found", name);
 		return {};
 	}
 
@@ -597,7 +3085,7 @@ template <cnpts::Vector T>
 T get_elem(Object::Ptr root, const std::string& name) {
 	using V = typename T::value_type;
 	if (!root->has(name)) {
-		log::warning(fmt::format("{} were not found", name));
+		log::warning("{} were not found", name);
 		return {};
 	}
 
@@ -615,7 +3103,7 @@ template <cnpts::Set T>
 T get_elem(Object::Ptr root, const std::string& name) {
 	using V = typename T::value_type;
 	if (!root->has(name)) {
-		log::warning(fmt::format("{} were not found", name));
+		log::warning("{} were not found", name);
 		return {};
 	}
 
@@ -632,7 +3120,7 @@ T get_elem(Object::Ptr root, const std::string& name) {
 template <cnpts::ResolutionUnit T>
 T get_elem(Object::Ptr root, const std::string& name) {
 	if (!root->has(name)) {
-		log::warning(fmt::format("{} was not found", name));
+		log::warning("{} was not found", name);
 		return {};
 	}
 
@@ -653,7 +3141,7 @@ T get_elem(Object::Ptr root, const std::string& name) {
 template <cnpts::Optional T>
 T get_elem(Object::Ptr root, const std::string& name) {
 	if (!root->has(name)) {
-		log::warning(fmt::format("{} were not found", name));
+		log::warning("{} were not found", name);
 		return {};
 	}
 
@@ -697,10 +3185,14 @@ namespace requests {
 /* inline */ std::string session_url_request(const std::string& ds_url,
                                              i3d::Vector3d<int> resolution,
                                              const std::string& version) {
-
-	log::info(
-	    fmt::format("Obtaining session url for resolution: {}, version: {}",
-	                to_string(resolution), version));
+	trace::Span span("session_url_request", "session");
+	if (span)
+		span.set_args(fmt::format("\"resolution\": \"{}\", \"version\": \"{}\"",
+		                          to_string(resolution), version));
+
+	log::info("Obtaining session url for resolution: ({}, {}, {}), "
+	          "version: {}",
+	          resolution.x, resolution.y, resolution.z, version);
 	std::string req_url =
 	    fmt::format("{}/{}/{}/{}/{}/read-write", ds_url, resolution.x,
 	                resolution.y, resolution.z, version);
@@ -709,9 +3201,9 @@ namespace requests {
 
 	int res_code = response.getStatus();
 	if (res_code != 307)
-		log::warning(fmt::format(
-		    "Request ended with status: {}, redirection may be incorrect",
-		    res_code));
+		log::warning("Request ended with status: {}, redirection may be "
+		             "incorrect",
+		             res_code);
 
 	return response.get("Location");
 }
@@ -719,13 +3211,80 @@ namespace requests {
 /* inline */ std::pair<std::vector<char>, Poco::Net::HTTPResponse>
 make_request(const std::string& url,
              const std::string& type /*  = Poco::Net::HTTPRequest::HTTP_GET */,
-             const std::vector<char>& data /*  = {} */,
+             std::span<const char> data /*  = {} */,
              const std::map<std::string, std::string>& headers /* = {} */) {
+	std::vector<char> out;
+	Poco::Net::HTTPResponse response =
+	    make_request(url, out, type, data, headers);
+	return {std::move(out), std::move(response)};
+}
+
+/* inline */ Poco::Net::HTTPResponse
+make_request(const std::string& url,
+             std::vector<char>& out,
+             const std::string& type /*  = Poco::Net::HTTPRequest::HTTP_GET */,
+             std::span<const char> data /*  = {} */,
+             const std::map<std::string, std::string>& headers /* = {} */,
+             RequestTiming* timing /* = nullptr */,
+             Timeouts timeouts /* = {} */,
+             const CancellationToken* token /* = nullptr */) {
+	using clock = std::chrono::steady_clock;
+	clock::time_point start = timing ? clock::now() : clock::time_point{};
+	trace::Span span("make_request", "net");
+
 	Poco::URI uri(url);
 	std::string path(uri.getPathAndQuery());
 
 	Poco::Net::HTTPClientSession session(uri.getHost(), uri.getPort());
 
+	/* Socket operations must not outlast the deadline (but at least 1 ms
+	 * is left to them, as zero timeout would mean blocking forever) */
+	using std::chrono::microseconds;
+	auto bounded = [token](microseconds limit) {
+		if (!token)
+			return limit;
+		microseconds left =
+		    std::chrono::duration_cast<microseconds>(token->remaining());
+		return std::min(limit, std::max(left, microseconds(1000)));
+	};
+
+	if (token)
+		token->throw_if_cancelled();
+	microseconds io = timeouts.io;
+	session.setTimeout(Poco::Timespan(bounded(timeouts.connect).count()),
+	                   Poco::Timespan(bounded(io).count()),
+	                   Poco::Timespan(bounded(io).count()));
+
+	/* Single receive is bounded by the timeout, but long bodies consist of
+	 * many of them, so they are transferred in chunks and the deadline is
+	 * checked (and the timeouts shortened) before each chunk */
+	bool has_deadline = token && token->deadline();
+	auto next_chunk = [&]() {
+		if (!has_deadline)
+			return;
+		token->throw_if_cancelled();
+		Poco::Timespan left(bounded(io).count());
+		session.socket().setSendTimeout(left);
+		session.socket().setReceiveTimeout(left);
+	};
+
+	/* Cancellation interrupts blocking socket calls */
+	struct Subscription {
+		const CancellationToken* token;
+		std::size_t id;
+
+		~Subscription() {
+			if (token)
+				token->unsubscribe(id);
+		}
+	} subscription{token, token ? token->subscribe([&session]() {
+		try {
+			session.socket().shutdown();
+		} catch (const Poco::Exception&) {
+			/* Not connected yet */
+		}
+	}) : 0};
+
 	Poco::Net::HTTPRequest request(type, path,
 	                               Poco::Net::HTTPMessage::HTTP_1_1);
 
@@ -734,22 +3293,272 @@ make_request(const std::string& url,
 
 	request.setContentLength(data.size());
 
-	log::info(fmt::format("Sending {} request to url: {}", type, url));
+	log::info("Sending {} request to url: {}", type, url);
 	std::ostream& os = session.sendRequest(request);
-	for (char ch : data)
-		os << ch;
+	for (std::size_t sent = 0; sent < data.size() && os; sent += BODY_CHUNK) {
+		next_chunk();
+		os.write(data.data() + sent,
+		         std::streamsize(std::min(BODY_CHUNK, data.size() - sent)));
+	}
 
+	next_chunk();
 	Poco::Net::HTTPResponse response;
 	std::istream& rs = session.receiveResponse(response);
 
-	std::vector<char> out{std::istreambuf_iterator<char>(rs),
-	                      std::istreambuf_iterator<char>()};
+	clock::time_point first_byte = timing ? clock::now() : clock::time_point{};
+
+	/* Allocated at once, when the size is known */
+	out.clear();
+	bool known_size = response.getContentLength() !=
+	                  Poco::Net::HTTPMessage::UNKNOWN_CONTENT_LENGTH;
+	if (known_size)
+		out.resize(std::size_t(response.getContentLength()));
+
+	std::size_t received = 0;
+	for (;;) {
+		if (!known_size)
+			out.resize(received + BODY_CHUNK);
+		std::size_t count = std::min(BODY_CHUNK, out.size() - received);
+		if (count == 0)
+			break;
+
+		next_chunk();
+		rs.read(out.data() + received, std::streamsize(count));
+		received += std::size_t(rs.gcount());
+		if (std::size_t(rs.gcount()) < count)
+			break;
+	}
+	out.resize(received);
+
+	/* Cancellation (or deadline) may have cut the body short */
+	if (token)
+		token->throw_if_cancelled();
+
+	if (timing) {
+		timing->first_byte = first_byte - start;
+		timing->transfer = clock::now() - first_byte;
+	}
+
+	if (span)
+		span.set_args(fmt::format(
+		    "\"method\": \"{}\", \"status\": {}, \"sent\": {}, "
+		    "\"received\": {}, \"url_length\": {}",
+		    type, int(response.getStatus()), data.size(), out.size(),
+		    url.size()));
 
-	log::info(fmt::format(
+	log::info(
 	    "Fetched response with status: {}, reason: {}, content size: {}",
-	    response.getStatus(), response.getReason(), out.size()));
+	    response.getStatus(), response.getReason(), out.size());
+
+	return response;
+}
+
+/* inline */ bool is_transient(int status) {
+	return status == 408 || status == 429 || status == 500 || status == 502 ||
+	       status == 503 || status == 504;
+}
+
+/* inline */ int try_request(const std::string& url,
+                             std::vector<char>& out,
+                             std::string& error,
+                             const std::string& type,
+                             std::span<const char> data,
+                             const std::map<std::string, std::string>& headers,
+                             RequestTiming* timing,
+                             Timeouts timeouts,
+                             const CancellationToken* token) {
+	try {
+		return int(make_request(url, out, type, data, headers, timing,
+		                        timeouts, token)
+		               .getStatus());
+	} catch (const Poco::IOException& e) {
+		error = e.displayText();
+	} catch (const Poco::TimeoutException& e) {
+		error = e.displayText();
+	}
+
+	out.clear();
+	return 0;
+}
+
+/* inline */ int hedged_request(
+    HedgeTarget primary,
+    std::vector<char>& out,
+    std::string& error,
+    RequestTiming* timing,
+    Timeouts timeouts,
+    const CancellationToken* token,
+    Hedger& hedger,
+    MetricsRegistry& metrics,
+    const std::function<std::optional<HedgeTarget>()>& hedge_target,
+    bool& hedge_won) {
+	using clock = std::chrono::steady_clock;
+	auto start = clock::now();
+	hedge_won = false;
+
+	std::optional<std::chrono::nanoseconds> threshold = hedger.threshold();
+	if (!threshold) {
+		int status = try_request(primary.url, out, error,
+		                         Poco::Net::HTTPRequest::HTTP_GET, {}, {},
+		                         timing, timeouts, token);
+		if (primary.finish && !(token && token->cancelled()))
+			primary.finish(status, timing ? *timing : RequestTiming{},
+			               out.size());
+		if (status == 200)
+			hedger.record(clock::now() - start);
+		return status;
+	}
+
+	/* Shared with the requests, which may outlive this call */
+	struct Race {
+		std::mutex mutex;
+		std::condition_variable done;
+		int running = 1;
+		bool finished = false;
+
+		int winner = 0;
+		int status = 0;
+		std::vector<char> data;
+		std::string error;
+		RequestTiming timing;
+		std::exception_ptr exception;
+	};
+	auto race = std::make_shared<Race>();
+
+	/* Requests may outlive the token passed by pointer */
+	std::optional<CancellationToken> shared_token;
+	if (token)
+		shared_token = *token;
+
+	auto launch = [&hedger, race, timeouts, shared_token](int id,
+	                                                      HedgeTarget target) {
+		hedger.spawn([target, race, id, timeouts, shared_token]() {
+			std::vector<char> data;
+			std::string error;
+			RequestTiming timing;
+			int status = 0;
+			std::exception_ptr exception;
+			try {
+				status = try_request(target.url, data, error,
+				                     Poco::Net::HTTPRequest::HTTP_GET, {}, {},
+				                     &timing, timeouts,
+				                     shared_token ? &*shared_token : nullptr);
+			} catch (const OperationCancelled& e) {
+				error = e.what();
+			} catch (...) {
+				exception = std::current_exception();
+			}
 
-	return {out, response};
+			try {
+				if (!exception && target.finish &&
+				    !(shared_token && shared_token->cancelled()))
+					target.finish(status, timing, data.size());
+			} catch (...) {
+				exception = std::current_exception();
+			}
+
+			/* Failure is used only when no other request is running */
+			std::scoped_lock lock(race->mutex);
+			--race->running;
+			if (race->finished || (status != 200 && race->running > 0))
+				return;
+
+			race->finished = true;
+			race->winner = id;
+			race->status = status;
+			race->data = std::move(data);
+			race->error = std::move(error);
+			race->timing = timing;
+			race->exception = exception;
+			race->done.notify_all();
+		});
+	};
+
+	launch(0, std::move(primary));
+
+	std::unique_lock lock(race->mutex);
+	if (!race->done.wait_for(lock, *threshold,
+	                         [&]() { return race->finished; }) &&
+	    hedger.try_hedge()) {
+		/* Chosen without the lock, opening of a session may take a while */
+		lock.unlock();
+		std::optional<HedgeTarget> target =
+		    hedge_target ? hedge_target() : std::nullopt;
+		lock.lock();
+
+		if (target && !race->finished) {
+			++race->running;
+			launch(1, std::move(*target));
+			metrics.add("read.hedges", 1);
+		}
+	}
+	race->done.wait(lock, [&]() { return race->finished; });
+	if (race->exception)
+		std::rethrow_exception(race->exception);
+
+	hedge_won = race->winner == 1;
+	if (hedge_won)
+		metrics.add("read.hedge_wins", 1);
+
+	out.swap(race->data);
+	error = std::move(race->error);
+	if (timing)
+		*timing = race->timing;
+
+	if (race->status == 200)
+		hedger.record(clock::now() - start);
+	return race->status;
+}
+
+template <typename F>
+auto with_failover(EndpointPool& pool, F&& fn) {
+	std::vector<std::size_t> order = pool.order();
+	for (std::size_t n = 0;; ++n) {
+		try {
+			return fn(order[n]);
+		} catch (const std::exception& e) {
+			pool.record_failure(order[n]);
+			if (n + 1 == order.size())
+				throw;
+
+			const Endpoint& endpoint = pool.endpoint(order[n]);
+			log::warning("Endpoint {}:{} failed ({}), trying next",
+			             endpoint.ip, endpoint.port, e.what());
+		}
+	}
+}
+
+inline Sessions::Sessions(const EndpointPool& pool,
+                          std::string uuid,
+                          i3d::Vector3d<int> resolution,
+                          std::string version)
+    : _pool(pool), _uuid(std::move(uuid)), _resolution(resolution),
+      _version(std::move(version)), _mutexes(pool.size()),
+      _urls(pool.size()) {}
+
+inline const std::string& Sessions::get(std::size_t i) {
+	std::scoped_lock lock(_mutexes[i]);
+	if (!_urls[i]) {
+		const Endpoint& endpoint = _pool.endpoint(i);
+		std::string url = session_url_request(
+		    get_dataset_url(endpoint.ip, endpoint.port, _uuid), _resolution,
+		    _version);
+
+		if (url.ends_with('/'))
+			url.pop_back();
+		_urls[i] = std::move(url);
+	}
+	return *_urls[i];
+}
+
+inline const std::string* Sessions::try_get(std::size_t i,
+                                            std::string& error) {
+	try {
+		return &get(i);
+	} catch (const std::exception& e) {
+		error = e.what();
+		return nullptr;
+	}
 }
 
 } // namespace requests
@@ -1,18 +1,30 @@
 #pragma once
+#include <algorithm>
 #include <array>
+#include <bit>
 #include <cassert>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
 #include <fmt/core.h>
+#include <functional>
 #include <i3d/image3d.h>
 #include <i3d/transform.h>
 #include <i3d/vector3d.h>
+#include <limits>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <optional>
 #include <ostream>
 #include <set>
+#include <span>
 #include <sstream>
 #include <stdexcept>
 #include <string>
+#include <type_traits>
+#include <variant>
 #include <vector>
 
 template <typename T, typename U>
@@ -43,6 +55,46 @@ namespace ds {
 
 using i3d::SamplingMode;
 
+/**
+ * @brief Reduction used to downsample image by integer factor
+ *
+ * Each voxel of downsampled image is computed from the window of
+ * <factor> voxels of the finer image.
+ *
+ * Pyramids are cascaded, every level is reduced from the coarsest already
+ * generated level with integer ratio. NEAREST, MAX and MIN give the same
+ * result as the window of the full-resolution image, whereas AVERAGE is
+ * an average of (rounded) averages, within 1 of the exact mean for
+ * integral types, and MODE is a mode of modes.
+ */
+enum class ReductionMode {
+	NEAREST, /* first voxel of the window */
+	AVERAGE, /* mean of the window (rounded for integral types) */
+	MAX,     /* maximum of the window */
+	MIN,     /* minimum of the window */
+	MODE     /* most frequent value of the window (for label images) */
+};
+
+/**
+ * @brief Layout of image written to file
+ */
+enum class FileLayout {
+	RAW, /* bare voxels, x is the fastest axis, native byte order */
+	NRRD /* the same, preceded by attached NRRD header */
+};
+
+/**
+ * @brief Severity of log messages (see set_log_level)
+ */
+enum class LogLevel {
+	INFO,    /* all messages */
+	WARNING, /* only warnings */
+	NONE     /* nothing */
+};
+
+/* Receives formatted log messages (see set_log_sink) */
+using LogSink = std::function<void(LogLevel, const std::string&)>;
+
 /* dataset 'voxel_type' to 'byte_size' map*/
 const inline std::map<std::string, int> type_byte_size{
     {"uint8", 1}, {"uint16", 2}, {"uint32", 4}, {"uint64", 8},  {"int8", 1},
@@ -51,6 +103,542 @@ const inline std::map<std::string, int> type_byte_size{
 /* Maximal legal URL length */
 constexpr inline std::size_t MAX_URL_LENGTH = 2048;
 
+/**
+ * @brief Limits used to split blocks into HTTP requests
+ *
+ * Each request is bounded by its URL length, the size of its octet-data and
+ * the number of blocks. With <adaptive> set, the data limit is tuned between
+ * <min_body_bytes> and <max_body_bytes> so that one request takes about
+ * <target_duration> at measured throughput.
+ */
+struct BatchLimits {
+	std::size_t max_url_length = MAX_URL_LENGTH;
+	std::size_t max_body_bytes = 134217728;
+	std::size_t max_blocks = std::numeric_limits<std::size_t>::max();
+
+	bool adaptive = true;
+	std::size_t min_body_bytes = 4194304;
+	std::chrono::milliseconds target_duration{500};
+};
+
+/**
+ * @brief Retrying of failed block requests
+ *
+ * A request failing on network error, with transient status (408, 429, 500,
+ * 502, 503, 504) or with incomplete body is repeated up to <max_attempts>
+ * times in total. The delay before n-th retry is <initial_backoff> *
+ * <multiplier>^(n-1), at most <max_backoff>, of which the <jitter> part is
+ * randomized. Blocks received completely are kept, only the rest is requested
+ * again.
+ */
+struct RetryPolicy {
+	int max_attempts = 5;
+	std::chrono::milliseconds initial_backoff{100};
+	std::chrono::milliseconds max_backoff{10000};
+	double multiplier = 2.0;
+	double jitter = 0.5;
+};
+
+/**
+ * @brief Hedging of slow block reads
+ *
+ * When enabled, a read request running longer than <percentile> of recent
+ * request durations (but at least <min_delay>) is sent once more over a new
+ * connection, the response that arrives first is used. Hedging starts after
+ * <min_samples> requests were measured and at most <budget> (fraction of all
+ * read requests) duplicates are sent.
+ */
+struct HedgingPolicy {
+	bool enabled = false;
+	double percentile = 95.0;
+	std::chrono::milliseconds min_delay{10};
+	std::size_t min_samples = 20;
+	double budget = 0.05;
+};
+
+/**
+ * @brief Adaptive limit of block requests in flight to one server
+ *
+ * The limit is shared by all connections to the same ip:port. It starts at
+ * <initial_limit> and grows additively (by one per round of requests), while
+ * the throughput improves and time to first byte stays below
+ * <latency_tolerance> times its baseline (kept separately for reads and
+ * writes of similar size). On 5xx responses, network errors, timeouts or
+ * latency spikes it is multiplied by <backoff> (at most once per round). It
+ * always stays between <min_limit> and <max_limit>. When not <adaptive>,
+ * <initial_limit> is used all the time.
+ */
+struct ConcurrencyPolicy {
+	bool adaptive = true;
+	std::size_t initial_limit = 4;
+	std::size_t min_limit = 1;
+	std::size_t max_limit = 32;
+	double backoff = 0.5;
+	double latency_tolerance = 2.0;
+};
+
+/**
+ * @brief Socket timeouts of HTTP requests
+ *
+ * <connect> bounds establishing of connection, <io> each single send or
+ * receive on it (not the whole request). Both have to be positive. Deadline
+ * of a cancellation token is enforced also during long transfers.
+ */
+struct Timeouts {
+	std::chrono::milliseconds connect{10000};
+	std::chrono::milliseconds io{60000};
+};
+
+/**
+ * @brief Address of datastore server
+ */
+struct Endpoint {
+	std::string ip;
+	int port;
+};
+
+/**
+ * @brief Partitioning of image into work items of block-parallel filters
+ *
+ * Each tile covers <tile_blocks> blocks and is read together with <halo>
+ * voxels on every side (clamped to the image). At most <threads> tiles are
+ * processed at once (0 = hardware concurrency), which bounds the memory.
+ */
+struct TilingPolicy {
+	i3d::Vector3d<int> halo{0, 0, 0};
+	i3d::Vector3d<int> tile_blocks{1, 1, 1};
+	std::size_t threads = 0;
+};
+
+/**
+ * @brief Settings of ImageView::compute_statistics
+ *
+ * Histogram has <bins> equal-width bins over <range>. Without <range>, the
+ * whole value range of 8 and 16-bit integer voxels is used and other voxel
+ * types get no histogram. When <resolution> is given, statistics are
+ * computed at that (coarser) resolution level, which is faster, but only
+ * approximate.
+ */
+struct StatisticsOptions {
+	std::size_t bins = 256;
+	std::optional<std::pair<double, double>> range;
+	std::optional<i3d::Vector3d<int>> resolution;
+};
+
+/**
+ * @brief Histogram, extremes, mean and variance of voxel values
+ *
+ * Values outside of histogram range [low, high] are counted to the edge bins.
+ * Statistics of disjoint voxel sets with the same histogram range can be
+ * merged in any order.
+ */
+class Statistics {
+  public:
+	Statistics() = default;
+	Statistics(std::size_t bins, double low, double high)
+	    : _counts(bins), _low(low), _high(high),
+	      _scale(high > low ? double(bins) / (high - low) : 0.0) {}
+
+	void record(double value) {
+		if (_count++ == 0)
+			_shift = value;
+
+		/* Sums are shifted by the first value to avoid cancellation */
+		double shifted = value - _shift;
+		_sum += shifted;
+		_sum_sq += shifted * shifted;
+		_min = std::min(_min, value);
+		_max = std::max(_max, value);
+
+		if (!_counts.empty()) {
+			double bin = std::floor((value - _low) * _scale);
+			_counts[std::size_t(
+			    std::clamp(bin, 0.0, double(_counts.size() - 1)))] += 1;
+		}
+	}
+
+	void merge(const Statistics& other) {
+		if (other._count == 0)
+			return;
+		if (_counts.empty() && _count == 0)
+			*this = Statistics(other._counts.size(), other._low, other._high);
+
+		for (std::size_t i = 0; i < _counts.size(); ++i)
+			_counts[i] += other._counts[i];
+
+		/* Pairwise combination of means and squared deviations */
+		double count = double(_count + other._count);
+		double delta = other.mean() - mean();
+		double m2 = squared_deviation() + other.squared_deviation() +
+		            delta * delta * double(_count) * double(other._count) /
+		                count;
+		_shift = mean() + delta * double(other._count) / count;
+		_sum = 0;
+		_sum_sq = m2;
+
+		_count += other._count;
+		_min = std::min(_min, other._min);
+		_max = std::max(_max, other._max);
+	}
+
+	std::uint64_t count() const { return _count; }
+	double min() const { return _count == 0 ? 0.0 : _min; }
+	double max() const { return _count == 0 ? 0.0 : _max; }
+	double mean() const {
+		return _count == 0 ? 0.0 : _shift + _sum / double(_count);
+	}
+
+	/**
+	 * @brief Population variance
+	 */
+	double variance() const {
+		return _count == 0 ? 0.0 : squared_deviation() / double(_count);
+	}
+	double stddev() const { return std::sqrt(variance()); }
+
+	double low() const { return _low; }
+	double high() const { return _high; }
+	const std::vector<std::uint64_t>& histogram() const { return _counts; }
+
+	/**
+	 * @brief Get value below which lies given percentage of voxels
+	 *
+	 * @param percentile percentile in range [0, 100]
+	 * @return double upper edge of the bin (clamped to [min(), max()]), or
+	 * 0 if there is no histogram
+	 */
+	double percentile(double percentile) const {
+		if (_count == 0 || _counts.empty())
+			return 0.0;
+
+		double rank = std::clamp(percentile, 0.0, 100.0) / 100.0 *
+		              double(_count);
+		std::uint64_t seen = 0;
+		for (std::size_t i = 0; i < _counts.size(); ++i) {
+			seen += _counts[i];
+			if (seen > 0 && double(seen) >= rank)
+				return std::clamp(_low + double(i + 1) / _scale, _min, _max);
+		}
+		return _max;
+	}
+
+  private:
+	double squared_deviation() const {
+		return _count == 0
+		           ? 0.0
+		           : std::max(0.0, _sum_sq - _sum * _sum / double(_count));
+	}
+
+	std::vector<std::uint64_t> _counts;
+	double _low = 0;
+	double _high = 0;
+	double _scale = 0;
+	std::uint64_t _count = 0;
+	double _shift = 0;
+	double _sum = 0;
+	double _sum_sq = 0;
+	double _min = std::numeric_limits<double>::infinity();
+	double _max = -std::numeric_limits<double>::infinity();
+};
+
+/**
+ * @brief Thrown when operation was cancelled or its deadline has passed
+ */
+class OperationCancelled : public std::runtime_error {
+  public:
+	using std::runtime_error::runtime_error;
+};
+
+/**
+ * @brief Cooperative cancellation of reads and writes
+ *
+ * Copies share the same state, so the token can be cancelled from any thread
+ * while an operation runs (see ImageView::with_cancellation). Once its
+ * optional deadline passes, the token behaves as cancelled.
+ */
+class CancellationToken {
+  public:
+	using clock = std::chrono::steady_clock;
+
+	CancellationToken() : _state(std::make_shared<State>()) {}
+
+	/**
+	 * @brief Create token cancelled after <timeout> from now
+	 */
+	static CancellationToken with_timeout(clock::duration timeout) {
+		return with_deadline(clock::now() + timeout);
+	}
+
+	/**
+	 * @brief Create token cancelled at <deadline>
+	 */
+	static CancellationToken with_deadline(clock::time_point deadline) {
+		CancellationToken out;
+		out._state->deadline = deadline;
+		return out;
+	}
+
+	/**
+	 * @brief Cancel all operations using this token
+	 *
+	 * Requests in progress are aborted by shutting their sockets down.
+	 */
+	void cancel() {
+		std::scoped_lock lock(_state->mutex);
+		if (_state->cancelled)
+			return;
+
+		_state->cancelled = true;
+		for (auto& [_, callback] : _state->callbacks)
+			callback();
+		_state->cv.notify_all();
+	}
+
+	bool cancelled() const {
+		std::scoped_lock lock(_state->mutex);
+		return _state->cancelled ||
+		       (_state->deadline && clock::now() >= *_state->deadline);
+	}
+
+	std::optional<clock::time_point> deadline() const {
+		std::scoped_lock lock(_state->mutex);
+		return _state->deadline;
+	}
+
+	/**
+	 * @brief Get time left until the deadline (maximal duration if none)
+	 */
+	clock::duration remaining() const {
+		std::optional<clock::time_point> until = deadline();
+		if (!until)
+			return clock::duration::max();
+		return std::max(*until - clock::now(), clock::duration::zero());
+	}
+
+	/**
+	 * @brief Throw OperationCancelled, if the token is cancelled
+	 */
+	void throw_if_cancelled() const {
+		std::scoped_lock lock(_state->mutex);
+		if (_state->cancelled)
+			throw OperationCancelled("Operation was cancelled");
+		if (_state->deadline && clock::now() >= *_state->deadline)
+			throw OperationCancelled("Deadline of operation has passed");
+	}
+
+	/**
+	 * @brief Sleep for <duration>, wakes up early on cancellation
+	 *
+	 * @return true, if the token is cancelled
+	 */
+	bool wait_for(clock::duration duration) const {
+		std::unique_lock lock(_state->mutex);
+		clock::time_point until = clock::now() + duration;
+		if (_state->deadline)
+			until = std::min(until, *_state->deadline);
+
+		_state->cv.wait_until(lock, until, [&]() { return _state->cancelled; });
+		return _state->cancelled ||
+		       (_state->deadline && clock::now() >= *_state->deadline);
+	}
+
+	/**
+	 * @brief Register <callback> called (under lock) on cancellation
+	 *
+	 * Used by requests in progress, the callback is called immediately when
+	 * the token is already cancelled.
+	 *
+	 * @return id to unsubscribe with
+	 */
+	std::size_t subscribe(std::function<void()> callback) const {
+		std::scoped_lock lock(_state->mutex);
+		if (_state->cancelled)
+			callback();
+
+		std::size_t id = _state->next_id++;
+		_state->callbacks.emplace(id, std::move(callback));
+		return id;
+	}
+
+	/**
+	 * @brief Remove callback, waits if it is being called
+	 */
+	void unsubscribe(std::size_t id) const {
+		std::scoped_lock lock(_state->mutex);
+		_state->callbacks.erase(id);
+	}
+
+  private:
+	struct State {
+		std::mutex mutex;
+		std::condition_variable cv;
+		bool cancelled = false;
+		std::optional<clock::time_point> deadline;
+		std::map<std::size_t, std::function<void()>> callbacks;
+		std::size_t next_id = 0;
+	};
+
+	std::shared_ptr<State> _state;
+};
+
+/**
+ * @brief Histogram of non-negative values with bounded relative error
+ *
+ * Values are counted in log-linear buckets (HDR-style): values below
+ * 2 * SUB_BUCKETS are exact, larger ones are grouped in buckets of relative
+ * width at most 1 / SUB_BUCKETS (~3 %).
+ */
+class Histogram {
+  public:
+	static constexpr int SUB_BUCKET_BITS = 5;
+	static constexpr std::uint64_t SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+	static constexpr std::size_t BUCKETS =
+	    SUB_BUCKETS * (64 - SUB_BUCKET_BITS) + SUB_BUCKETS;
+
+	void record(std::uint64_t value, std::uint64_t count = 1) {
+		if (_counts.empty())
+			_counts.resize(BUCKETS);
+
+		_counts[bucket_index(value)] += count;
+		_count += count;
+		_sum += double(value) * double(count);
+		_min = std::min(_min, value);
+		_max = std::max(_max, value);
+	}
+
+	void merge(const Histogram& other) {
+		if (other._count == 0)
+			return;
+		if (_counts.empty())
+			_counts.resize(BUCKETS);
+
+		for (std::size_t i = 0; i < BUCKETS; ++i)
+			_counts[i] += other._counts[i];
+		_count += other._count;
+		_sum += other._sum;
+		_min = std::min(_min, other._min);
+		_max = std::max(_max, other._max);
+	}
+
+	std::uint64_t count() const { return _count; }
+	double sum() const { return _sum; }
+	std::uint64_t min() const { return _count == 0 ? 0 : _min; }
+	std::uint64_t max() const { return _max; }
+	double mean() const { return _count == 0 ? 0.0 : _sum / double(_count); }
+
+	/**
+	 * @brief Get value below which lies given percentage of recorded values
+	 *
+	 * @param percentile percentile in range [0, 100]
+	 * @return std::uint64_t upper bound of the bucket (clamped to max())
+	 */
+	std::uint64_t percentile(double percentile) const {
+		if (_count == 0)
+			return 0;
+
+		double rank = std::clamp(percentile, 0.0, 100.0) / 100.0 *
+		              double(_count);
+		std::uint64_t seen = 0;
+		for (std::size_t i = 0; i < BUCKETS; ++i) {
+			seen += _counts[i];
+			if (seen > 0 && double(seen) >= rank)
+				return std::clamp(bucket_value(i + 1) - 1, min(), _max);
+		}
+		return _max;
+	}
+
+	/**
+	 * @brief Get non-empty buckets as (lowest value, count) pairs
+	 */
+	std::vector<std::pair<std::uint64_t, std::uint64_t>> buckets() const {
+		std::vector<std::pair<std::uint64_t, std::uint64_t>> out;
+		for (std::size_t i = 0; i < _counts.size(); ++i)
+			if (_counts[i] != 0)
+				out.emplace_back(bucket_value(i), _counts[i]);
+		return out;
+	}
+
+	static std::size_t bucket_index(std::uint64_t value) {
+		if (value < 2 * SUB_BUCKETS)
+			return std::size_t(value);
+
+		int shift = int(std::bit_width(value)) - 1 - SUB_BUCKET_BITS;
+		return std::size_t(SUB_BUCKETS * std::uint64_t(shift) +
+		                   (value >> shift));
+	}
+
+	static std::uint64_t bucket_value(std::size_t index) {
+		if (index < 2 * SUB_BUCKETS)
+			return index;
+
+		std::uint64_t shift = index / SUB_BUCKETS - 1;
+		return (index - SUB_BUCKETS * shift) << shift;
+	}
+
+  private:
+	std::vector<std::uint64_t> _counts;
+	std::uint64_t _count = 0;
+	double _sum = 0;
+	std::uint64_t _min = std::numeric_limits<std::uint64_t>::max();
+	std::uint64_t _max = 0;
+};
+
+/**
+ * @brief Snapshot of metrics recorded by Connection (see get_metrics)
+ *
+ * Histograms are named "<operation>.<phase>", where operation is one of
+ * "properties", "read", "write" and phases are "latency" (properties),
+ * "session" (read-write redirect), "first_byte", "transfer", "decode",
+ * "encode" (in nanoseconds), "request_bytes" (bytes per request) and
+ * "concurrency" (requests in flight to the server, when one was sent).
+ * Counters are named "<operation>.bytes", "<operation>.blocks",
+ * "<operation>.requests" and "<operation>.retries", hedged reads are counted by
+ * "read.hedges" (duplicates sent) and "read.hedge_wins" (duplicates that
+ * arrived first).
+ */
+struct Metrics {
+	std::map<std::string, Histogram> histograms;
+	std::map<std::string, std::uint64_t> counters;
+
+	/**
+	 * @brief Serialize to JSON
+	 *
+	 * @param with_buckets include non-empty buckets of each histogram
+	 * @return std::string JSON
+	 */
+	std::string to_json(bool with_buckets = false) const {
+		std::string out = "{\"counters\": {";
+		for (auto it = counters.begin(); it != counters.end(); ++it)
+			out += fmt::format("{}\"{}\": {}",
+			                   it == counters.begin() ? "" : ", ", it->first,
+			                   it->second);
+
+		out += "}, \"histograms\": {";
+		for (auto it = histograms.begin(); it != histograms.end(); ++it) {
+			const Histogram& h = it->second;
+			out += fmt::format(
+			    "{}\"{}\": {{\"count\": {}, \"min\": {}, \"max\": {}, "
+			    "\"mean\": {}, \"p50\": {}, \"p90\": {}, \"p99\": {}, "
+			    "\"p999\": {}",
+			    it == histograms.begin() ? "" : ", ", it->first, h.count(),
+			    h.min(), h.max(), h.mean(), h.percentile(50),
+			    h.percentile(90), h.percentile(99), h.percentile(99.9));
+
+			if (with_buckets) {
+				out += ", \"buckets\": [";
+				auto buckets = h.buckets();
+				for (std::size_t i = 0; i < buckets.size(); ++i)
+					out += fmt::format("{}[{}, {}]", i == 0 ? "" : ", ",
+					                   buckets[i].first, buckets[i].second);
+				out += "]";
+			}
+			out += "}";
+		}
+		out += "}}";
+		return out;
+	}
+};
+
 /**
  * @brief Class representing resolution unit (in DatasetProperties)
  *
@@ -115,8 +703,77 @@ template <typename T>
 concept ResolutionUnit = requires(T) {
 	requires std::is_same_v<T, ds::ResolutionUnit>;
 };
+
+/* Voxel types accepted by i3d image file writers */
+template <typename T>
+concept FileVoxel = requires(T) {
+	requires std::is_same_v<T, uint8_t> || std::is_same_v<T, uint16_t> ||
+	             std::is_same_v<T, float>;
+};
 } // namespace cnpts
 
+/**
+ * @brief Non-owning view of strided 3D voxel buffer
+ *
+ * Voxel (x, y, z) is stored at
+ * data[origin + x * strides.x + y * strides.y + z * strides.z].
+ * Strides are given in elements and may be negative.
+ *
+ * @tparam T Voxel type (const-qualified for read-only views)
+ */
+template <typename T>
+requires cnpts::Scalar<T>
+struct StridedView {
+	std::span<T> data;
+	i3d::Vector3d<int> size;
+	i3d::Vector3d<std::ptrdiff_t> strides;
+	std::ptrdiff_t origin = 0;
+
+	/**
+	 * @brief View of densely packed buffer (x is the fastest axis)
+	 */
+	static StridedView contiguous(std::span<T> data, i3d::Vector3d<int> size) {
+		return {data, size,
+		        i3d::Vector3d<std::ptrdiff_t>(
+		            1, size.x, std::ptrdiff_t(size.x) * size.y),
+		        0};
+	}
+
+	std::ptrdiff_t index(int x, int y, int z) const {
+		return origin + x * strides.x + y * strides.y + z * strides.z;
+	}
+
+	T& at(int x, int y, int z) const { return data[index(x, y, z)]; }
+
+	/**
+	 * @brief View of the region [start, start + region_size)
+	 */
+	StridedView subview(i3d::Vector3d<int> start,
+	                    i3d::Vector3d<int> region_size) const {
+		return {data, region_size, strides, index(start.x, start.y, start.z)};
+	}
+
+	/**
+	 * @brief Check whether all voxels are within <data>
+	 */
+	bool fits() const {
+		if (size.x <= 0 || size.y <= 0 || size.z <= 0)
+			return true;
+
+		std::ptrdiff_t lo = origin, hi = origin;
+		for (int i = 0; i < 3; ++i) {
+			std::ptrdiff_t span = (size[i] - 1) * strides[i];
+			(span < 0 ? lo : hi) += span;
+		}
+		return lo >= 0 && hi < std::ptrdiff_t(data.size());
+	}
+
+	operator StridedView<const T>() const
+	    requires(!std::is_const_v<T>) {
+		return {data, size, strides, origin};
+	}
+};
+
 namespace details {
 /** Type match checks **/
 inline bool matches_image_type(const i3d::Image3d<uint8_t>&,
@@ -297,8 +954,9 @@ class DatasetProperties {
 
 	i3d::Vector3d<int> get_block_count(i3d::Vector3d<int> resolution) const {
 		i3d::Vector3d<int> block_dim = get_block_dimensions(resolution);
+		i3d::Vector3d<int> img_dim = get_img_dimensions(resolution);
 
-		return (dimensions + block_dim - 1) / block_dim;
+		return (img_dim + block_dim - 1) / block_dim;
 	}
 
 	i3d::Vector3d<int> get_img_dimensions(i3d::Vector3d<int> resolution) const {
@@ -346,4 +1004,81 @@ class DatasetProperties {
 };
 using dataset_props_ptr = std::shared_ptr<DatasetProperties>;
 
+/**
+ * @brief Image of any voxel type supported by datastore
+ *
+ * Holds i3d::Image3d with voxels of DatasetProperties::voxel_type (see
+ * visit_voxel_type for the mapping). Process it by std::visit (several
+ * lambdas can be combined by Overloaded) or take it by std::get.
+ */
+using AnyImage = std::variant<i3d::Image3d<uint8_t>,
+                              i3d::Image3d<uint16_t>,
+                              i3d::Image3d<uint32_t>,
+                              i3d::Image3d<uint64_t>,
+                              i3d::Image3d<int8_t>,
+                              i3d::Image3d<int16_t>,
+                              i3d::Image3d<int32_t>,
+                              i3d::Image3d<int64_t>,
+                              i3d::Image3d<float>,
+                              i3d::Image3d<double>>;
+
+/**
+ * @brief Visitor combining several callables (e.g. one lambda per type)
+ */
+template <typename... Fs>
+struct Overloaded : Fs... {
+	using Fs::operator()...;
+};
+
+/**
+ * @brief Call <fn> with std::type_identity of C++ type of <voxel_type>
+ *
+ * Runtime selection of template type, e.g.
+ * visit_voxel_type(props->voxel_type, [&](auto type) {
+ *     using T = typename decltype(type)::type;
+ *     ...
+ * });
+ *
+ * "uint8" ... "int64" map to fixed-width integers, "float32" to float and
+ * "float64" to double. All calls of <fn> must return the same type.
+ *
+ * @throws std::logic_error if voxel type is not supported
+ */
+template <typename F>
+decltype(auto) visit_voxel_type(const std::string& voxel_type, F&& fn) {
+	if (voxel_type == "uint8")
+		return fn(std::type_identity<uint8_t>{});
+	if (voxel_type == "uint16")
+		return fn(std::type_identity<uint16_t>{});
+	if (voxel_type == "uint32")
+		return fn(std::type_identity<uint32_t>{});
+	if (voxel_type == "uint64")
+		return fn(std::type_identity<uint64_t>{});
+	if (voxel_type == "int8")
+		return fn(std::type_identity<int8_t>{});
+	if (voxel_type == "int16")
+		return fn(std::type_identity<int16_t>{});
+	if (voxel_type == "int32")
+		return fn(std::type_identity<int32_t>{});
+	if (voxel_type == "int64")
+		return fn(std::type_identity<int64_t>{});
+	if (voxel_type == "float32")
+		return fn(std::type_identity<float>{});
+	if (voxel_type == "float64")
+		return fn(std::type_identity<double>{});
+
+	throw std::logic_error(
+	    fmt::format("Voxel type {} is not supported", voxel_type).c_str());
+}
+
+/**
+ * @brief Get voxel type (as in DatasetProperties) of image held by <img>
+ */
+inline std::string voxel_type_of(const AnyImage& img) {
+	static const std::array<std::string, std::variant_size_v<AnyImage>>
+	    names = {"uint8", "uint16", "uint32", "uint64", "int8",
+	             "int16", "int32",  "int64",  "float32", "float64"};
+	return names[img.index()];
+}
+
 } // namespace ds
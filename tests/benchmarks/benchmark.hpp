@@ -0,0 +1,184 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <fmt/core.h>
+#include <functional>
+#include <limits>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Minimal microbenchmark harness (no server needed).
+ *
+ * Each benchmark is repeated until it ran for at least the minimal time, the
+ * best of several such repetitions is reported. Results are written as JSON
+ * compatible with the output of Google Benchmark, so existing tools for
+ * comparing runs can be used.
+ */
+namespace bench {
+
+#ifndef BENCHMARK_REVISION
+#define BENCHMARK_REVISION "unknown"
+#endif
+
+/**
+ * @brief Result of single benchmark
+ */
+struct Result {
+	std::string name;
+	std::size_t iterations = 0;
+	double ns_per_op = 0.0;
+	double bytes_per_second = 0.0;
+	double items_per_second = 0.0;
+};
+
+/**
+ * @brief Settings of benchmark runs
+ */
+struct Settings {
+	/* Minimal duration of one repetition */
+	std::chrono::milliseconds min_time{200};
+
+	/* Number of repetitions, the fastest one is reported */
+	int repetitions = 3;
+
+	/* Run only benchmarks whose name contains this string */
+	std::string filter;
+};
+
+/**
+ * @brief Prevent compiler from optimizing the value away
+ */
+template <typename T>
+inline void do_not_optimize(const T& value) {
+	asm volatile("" : : "r,m"(value) : "memory");
+}
+
+/**
+ * @brief Collection of benchmarks and their results
+ */
+class Suite {
+  public:
+	explicit Suite(Settings settings = {}) : _settings(std::move(settings)) {}
+
+	/**
+	 * @brief Run benchmark
+	 *
+	 * @param name unique name (e.g. "read_data/uint16/64x64x64")
+	 * @param bytes bytes processed by one call of fn (0 if not applicable)
+	 * @param items items processed by one call of fn (0 if not applicable)
+	 * @param fn benchmarked operation
+	 */
+	void run(const std::string& name,
+	         std::size_t bytes,
+	         std::size_t items,
+	         const std::function<void()>& fn);
+
+	const std::vector<Result>& results() const { return _results; }
+
+	/**
+	 * @brief Write results as JSON
+	 */
+	void write_json(std::ostream& os) const;
+
+  private:
+	Settings _settings;
+	std::vector<Result> _results;
+};
+
+/* ================= IMPLEMENTATION FOLLOWS ======================== */
+
+inline void Suite::run(const std::string& name,
+                       std::size_t bytes,
+                       std::size_t items,
+                       const std::function<void()>& fn) {
+	using clock = std::chrono::steady_clock;
+
+	if (!_settings.filter.empty() &&
+	    name.find(_settings.filter) == std::string::npos)
+		return;
+
+	/* Warm up caches and estimate iteration count */
+	std::size_t iterations = 1;
+	for (;;) {
+		auto start = clock::now();
+		for (std::size_t i = 0; i < iterations; ++i)
+			fn();
+		auto elapsed = clock::now() - start;
+
+		if (elapsed >= _settings.min_time / 10 || iterations >= (1u << 30))
+			break;
+		iterations *= 2;
+	}
+
+	double best = std::numeric_limits<double>::max();
+	std::size_t best_iterations = 0;
+	for (int r = 0; r < _settings.repetitions; ++r) {
+		std::size_t count = 0;
+		auto start = clock::now();
+		auto elapsed = clock::duration::zero();
+
+		while (elapsed < _settings.min_time) {
+			for (std::size_t i = 0; i < iterations; ++i)
+				fn();
+			count += iterations;
+			elapsed = clock::now() - start;
+		}
+
+		double ns =
+		    double(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed)
+		               .count()) /
+		    double(count);
+		if (ns < best) {
+			best = ns;
+			best_iterations = count;
+		}
+	}
+
+	Result result;
+	result.name = name;
+	result.iterations = best_iterations;
+	result.ns_per_op = best;
+	result.bytes_per_second = double(bytes) * 1e9 / best;
+	result.items_per_second = double(items) * 1e9 / best;
+	_results.push_back(result);
+
+	fmt::print(stderr, "{:<60} {:>14.1f} ns {:>12.1f} MB/s\n", name, best,
+	           result.bytes_per_second / 1e6);
+}
+
+inline void Suite::write_json(std::ostream& os) const {
+	std::time_t now = std::time(nullptr);
+	char date[32];
+	std::strftime(date, sizeof(date), "%FT%T%z", std::localtime(&now));
+
+	os << "{\n  \"context\": {\n";
+	os << fmt::format("    \"date\": \"{}\",\n", date);
+	os << fmt::format("    \"revision\": \"{}\",\n", BENCHMARK_REVISION);
+	os << fmt::format("    \"num_cpus\": {},\n",
+	                  std::thread::hardware_concurrency());
+	os << fmt::format("    \"min_time_ms\": {},\n",
+	                  _settings.min_time.count());
+	os << fmt::format("    \"repetitions\": {}\n", _settings.repetitions);
+	os << "  },\n  \"benchmarks\": [";
+
+	for (std::size_t i = 0; i < _results.size(); ++i) {
+		const Result& r = _results[i];
+		os << (i == 0 ? "\n" : ",\n");
+		os << fmt::format(
+		    "    {{\"name\": \"{}\", \"run_type\": \"iteration\", "
+		    "\"iterations\": {}, \"real_time\": {}, \"cpu_time\": {}, "
+		    "\"time_unit\": \"ns\", \"bytes_per_second\": {}, "
+		    "\"items_per_second\": {}}}",
+		    r.name, r.iterations, r.ns_per_op, r.ns_per_op,
+		    r.bytes_per_second, r.items_per_second);
+	}
+
+	os << "\n  ]\n}\n";
+}
+
+} // namespace bench
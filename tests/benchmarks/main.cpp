@@ -0,0 +1,252 @@
+#include "../../src/hpc_ds_api.hpp"
+#include "benchmark.hpp"
+#include <fstream>
+#include <iostream>
+#include <random>
+
+/**
+ * Microbenchmarks of client hot paths, no server is needed.
+ *
+ * usage: benchmarks [--out=<file.json>] [--filter=<substring>]
+ *                   [--min-time=<ms>] [--repetitions=<count>]
+ *
+ * JSON results are written to the given file (or standard output),
+ * human readable summary is printed to standard error.
+ */
+
+namespace {
+
+using Vec = i3d::Vector3d<int>;
+
+const std::vector<Vec> BLOCK_SIZES = {
+    {32, 32, 32}, {64, 64, 64}, {256, 256, 16}};
+
+std::string to_string(Vec v) { return fmt::format("{}x{}x{}", v.x, v.y, v.z); }
+
+template <typename T>
+std::vector<T> random_data(std::size_t count) {
+	std::mt19937_64 gen{42};
+	std::uniform_int_distribution<long long> dist;
+
+	std::vector<T> out(count);
+	for (auto& value : out)
+		value = T(dist(gen));
+	return out;
+}
+
+ds::DatasetProperties make_properties(Vec dimensions, Vec block_dim) {
+	ds::DatasetProperties props;
+	props.voxel_type = "uint16";
+	props.dimensions = dimensions;
+	for (Vec resolution : {Vec{1, 1, 1}, Vec{2, 2, 1}, Vec{4, 4, 2}})
+		props.resolution_levels.push_back(
+		    {{"resolutions", resolution}, {"blockDimensions", block_dim}});
+	return props;
+}
+
+/* read_data/write_data of whole block */
+template <typename T>
+void bench_codec(bench::Suite& suite, const std::string& type) {
+	using namespace ds::details::data_manip;
+
+	for (Vec size : BLOCK_SIZES) {
+		std::size_t voxels = std::size_t(size.x) * size.y * size.z;
+		std::size_t bytes = voxels * sizeof(T);
+
+		std::vector<T> img = random_data<T>(voxels);
+		std::vector<char> data(std::size_t(get_block_data_size(size, type)));
+		auto view = ds::StridedView<T>::contiguous(img, size);
+
+		write_data(ds::StridedView<const T>(view), {0, 0, 0}, data, type,
+		           size);
+
+		suite.run(fmt::format("write_data/{}/{}", type, to_string(size)),
+		          bytes, voxels, [&] {
+			          write_data(ds::StridedView<const T>(view), {0, 0, 0},
+			                     data, type, size);
+			          bench::do_not_optimize(data.data());
+		          });
+
+		suite.run(fmt::format("read_data/{}/{}", type, to_string(size)),
+		          bytes, voxels, [&] {
+			          read_data(data, type, view, {0, 0, 0}, size);
+			          bench::do_not_optimize(img.data());
+		          });
+
+		suite.run(fmt::format("record_data/{}/{}", type, to_string(size)),
+		          bytes, voxels, [&] {
+			          ds::Statistics stats(256, 0, 256);
+			          record_data<T>(data, type, stats, size, {0, 0, 0}, size);
+			          bench::do_not_optimize(stats.mean());
+		          });
+	}
+}
+
+/* get_elem_at/set_elem_at over every voxel of a block */
+template <typename T>
+void bench_elem_access(bench::Suite& suite, const std::string& type) {
+	using namespace ds::details::data_manip;
+
+	Vec size = BLOCK_SIZES.front();
+	std::size_t voxels = std::size_t(size.x) * size.y * size.z;
+	std::vector<char> data(std::size_t(get_block_data_size(size, type)));
+
+	suite.run(fmt::format("set_elem_at/{}/{}", type, to_string(size)),
+	          voxels * sizeof(T), voxels, [&] {
+		          for (int z = 0; z < size.z; ++z)
+			          for (int y = 0; y < size.y; ++y)
+				          for (int x = 0; x < size.x; ++x)
+					          set_elem_at(data, type, {x, y, z}, size,
+					                      T(x + y + z));
+		          bench::do_not_optimize(data.data());
+	          });
+
+	suite.run(fmt::format("get_elem_at/{}/{}", type, to_string(size)),
+	          voxels * sizeof(T), voxels, [&] {
+		          T sum{};
+		          for (int z = 0; z < size.z; ++z)
+			          for (int y = 0; y < size.y; ++y)
+				          for (int x = 0; x < size.x; ++x)
+					          sum += get_elem_at<T>(data, type, {x, y, z},
+					                                size);
+		          bench::do_not_optimize(sum);
+	          });
+}
+
+template <typename T>
+void bench_type(bench::Suite& suite, const std::string& type) {
+	bench_codec<T>(suite, type);
+	bench_elem_access<T>(suite, type);
+}
+
+/* Splitting of block lists into URLs */
+void bench_create_requests(bench::Suite& suite) {
+	const std::string session_url =
+	    "http://127.0.0.1:9080/datasets/029453eb-729e-451f-a722-195b06eb107c/"
+	    "1/1/1/0/session";
+
+	for (Vec size : BLOCK_SIZES) {
+		for (std::size_t count : {64, 1024, 16384}) {
+			std::vector<Vec> coords;
+			for (std::size_t i = 0; i < count; ++i)
+				coords.emplace_back(int(i % 64), int(i / 64 % 64),
+				                    int(i / 4096));
+
+			std::size_t block_bytes = std::size_t(
+			    ds::details::data_manip::get_block_data_size(size, "uint16"));
+			std::vector<std::size_t> sizes(count, block_bytes);
+			ds::BatchLimits limits;
+
+			suite.run(
+			    fmt::format("create_requests/{}/{}", to_string(size), count), 0,
+			    count, [&] {
+				    auto requests = ds::details::create_requests(
+				        coords, sizes, session_url, 0, 0, 0,
+				        limits.max_url_length, limits.max_body_bytes,
+				        limits.max_blocks);
+				    bench::do_not_optimize(requests.data());
+			    });
+		}
+	}
+}
+
+/* Search of blocks intercepting a region */
+void bench_intercepted_blocks(bench::Suite& suite) {
+	Vec img_dim = {4096, 4096, 512};
+
+	for (Vec block_dim : BLOCK_SIZES)
+		for (Vec region : {Vec{100, 100, 10}, Vec{1000, 1000, 100}, img_dim}) {
+			Vec start = (img_dim - region) / 2;
+			std::size_t blocks =
+			    ds::details::get_intercepted_blocks(start, start + region,
+			                                        img_dim, block_dim)
+			        .size();
+
+			suite.run(fmt::format("get_intercepted_blocks/{}/{}",
+			                      to_string(block_dim), to_string(region)),
+			          0, blocks, [&] {
+				          auto out = ds::details::get_intercepted_blocks(
+				              start, start + region, img_dim, block_dim);
+				          bench::do_not_optimize(out.data());
+			          });
+		}
+}
+
+/* Block sizes of all blocks of an image */
+void bench_block_size(bench::Suite& suite) {
+	Vec img_dim = {2048, 2048, 256};
+
+	for (Vec block_dim : BLOCK_SIZES)
+		for (Vec resolution : {Vec{1, 1, 1}, Vec{4, 4, 2}}) {
+			ds::DatasetProperties props = make_properties(img_dim, block_dim);
+			Vec count = (props.get_img_dimensions(resolution) + block_dim - 1) /
+			            block_dim;
+			std::size_t blocks = std::size_t(count.x) * count.y * count.z;
+
+			suite.run(fmt::format("get_block_size/{}/{}", to_string(block_dim),
+			                      to_string(resolution)),
+			          0, blocks, [&] {
+				          Vec sum = {0, 0, 0};
+				          for (int x = 0; x < count.x; ++x)
+					          for (int y = 0; y < count.y; ++y)
+						          for (int z = 0; z < count.z; ++z)
+							          sum += props.get_block_size({x, y, z},
+							                                      resolution);
+				          bench::do_not_optimize(sum);
+			          });
+		}
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+	bench::Settings settings;
+	std::string out_path;
+
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		auto value = [&](const std::string& prefix) {
+			return arg.substr(prefix.size());
+		};
+
+		if (arg.starts_with("--out="))
+			out_path = value("--out=");
+		else if (arg.starts_with("--filter="))
+			settings.filter = value("--filter=");
+		else if (arg.starts_with("--min-time="))
+			settings.min_time =
+			    std::chrono::milliseconds(std::stoll(value("--min-time=")));
+		else if (arg.starts_with("--repetitions="))
+			settings.repetitions = std::stoi(value("--repetitions="));
+		else {
+			std::cerr << "Unknown argument: " << arg << '\n';
+			return 1;
+		}
+	}
+
+	bench::Suite suite(settings);
+
+	bench_type<uint8_t>(suite, "uint8");
+	bench_type<uint16_t>(suite, "uint16");
+	bench_type<uint32_t>(suite, "uint32");
+	bench_type<uint64_t>(suite, "uint64");
+	bench_type<int8_t>(suite, "int8");
+	bench_type<int16_t>(suite, "int16");
+	bench_type<int32_t>(suite, "int32");
+	bench_type<int64_t>(suite, "int64");
+	bench_type<float>(suite, "float32");
+	bench_type<double>(suite, "float64");
+
+	bench_create_requests(suite);
+	bench_intercepted_blocks(suite);
+	bench_block_size(suite);
+
+	if (out_path.empty()) {
+		suite.write_json(std::cout);
+		return 0;
+	}
+
+	std::ofstream file(out_path);
+	suite.write_json(file);
+	return file ? 0 : 1;
+}
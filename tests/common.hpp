@@ -1,9 +1,13 @@
 #pragma once
+#include <algorithm>
+#include <cmath>
 #include <i3d/image3d.h>
 #include <i3d/vector3d.h>
+#include <limits>
 #include <random>
 #include <string>
 #include <utility>
+#include <vector>
 
 /** DO NOT FORGET TO CHANGE THESE TO MATCH YOUR SERVER **/
 
@@ -28,11 +32,13 @@ const std::string IMG_VERSION = "latest";
  *
  * @tparam T Scalar image element type
  * @param img image
+ * @param max largest generated value
  */
 template <typename T>
-void fill_random(i3d::Image3d<T>& img) {
+void fill_random(i3d::Image3d<T>& img,
+                 long long max = std::numeric_limits<long long>::max()) {
 	std::mt19937_64 gen{std::random_device()()};
-	std::uniform_int_distribution<long long> dist;
+	std::uniform_int_distribution<long long> dist(0, max);
 
 	for (auto& voxel : img)
 		voxel = T(dist(gen));
@@ -108,6 +114,153 @@ i3d::Image3d<T> get_subimage(const i3d::Image3d<T>& src,
 	return out;
 }
 
+template <typename T>
+i3d::Image3d<T> downsample_nearest(const i3d::Image3d<T>& src,
+                                   i3d::Vector3d<int> factor,
+                                   i3d::Vector3d<int> size) {
+	i3d::Image3d<T> out;
+	out.MakeRoom(size);
+
+	for (std::size_t x = 0; x < out.GetSizeX(); ++x)
+		for (std::size_t y = 0; y < out.GetSizeY(); ++y)
+			for (std::size_t z = 0; z < out.GetSizeZ(); ++z) {
+				i3d::Vector3d<std::size_t> coord = {x, y, z};
+				out.SetVoxel(coord, src.GetVoxel(
+				                        coord * i3d::Vector3d<std::size_t>(factor)));
+			}
+
+	return out;
+}
+
+template <typename T>
+i3d::Image3d<T> downsample_max(const i3d::Image3d<T>& src,
+                               i3d::Vector3d<int> factor,
+                               i3d::Vector3d<int> size) {
+	i3d::Image3d<T> out;
+	out.MakeRoom(size);
+
+	for (std::size_t x = 0; x < out.GetSizeX(); ++x)
+		for (std::size_t y = 0; y < out.GetSizeY(); ++y)
+			for (std::size_t z = 0; z < out.GetSizeZ(); ++z) {
+				i3d::Vector3d<std::size_t> start =
+				    i3d::Vector3d<std::size_t>{x, y, z} *
+				    i3d::Vector3d<std::size_t>(factor);
+				T val = src.GetVoxel(start);
+				for (int dx = 0; dx < factor.x; ++dx)
+					for (int dy = 0; dy < factor.y; ++dy)
+						for (int dz = 0; dz < factor.z; ++dz)
+							val = std::max(val, src.GetVoxel(start.x + dx,
+							                                 start.y + dy,
+							                                 start.z + dz));
+				out.SetVoxel(x, y, z, val);
+			}
+
+	return out;
+}
+
+/* Maximum of 3x3x3 neighbourhood of every voxel (clamped to the image) */
+template <typename T>
+void max_filter(const i3d::Image3d<T>& in, i3d::Image3d<T>& out) {
+	i3d::Vector3d<int> size = in.GetSize();
+	out.MakeRoom(in.GetSize());
+
+	for (int x = 0; x < size.x; ++x)
+		for (int y = 0; y < size.y; ++y)
+			for (int z = 0; z < size.z; ++z) {
+				i3d::Vector3d<int> from{std::max(x - 1, 0), std::max(y - 1, 0),
+				                        std::max(z - 1, 0)};
+				i3d::Vector3d<int> to{std::min(x + 2, size.x),
+				                      std::min(y + 2, size.y),
+				                      std::min(z + 2, size.z)};
+				T val = in.GetVoxel(x, y, z);
+				for (int nx = from.x; nx < to.x; ++nx)
+					for (int ny = from.y; ny < to.y; ++ny)
+						for (int nz = from.z; nz < to.z; ++nz)
+							val = std::max(val, in.GetVoxel(nx, ny, nz));
+				out.SetVoxel(x, y, z, val);
+			}
+}
+
+/* Reduces every window of <factor> voxels by <reduce>(window values) */
+template <typename T, typename F>
+i3d::Image3d<T> downsample_window(const i3d::Image3d<T>& src,
+                                  i3d::Vector3d<int> factor,
+                                  i3d::Vector3d<int> size,
+                                  F reduce) {
+	i3d::Image3d<T> out;
+	out.MakeRoom(size);
+
+	std::vector<T> values;
+	for (std::size_t x = 0; x < out.GetSizeX(); ++x)
+		for (std::size_t y = 0; y < out.GetSizeY(); ++y)
+			for (std::size_t z = 0; z < out.GetSizeZ(); ++z) {
+				i3d::Vector3d<std::size_t> start =
+				    i3d::Vector3d<std::size_t>{x, y, z} *
+				    i3d::Vector3d<std::size_t>(factor);
+				values.clear();
+				for (int dx = 0; dx < factor.x; ++dx)
+					for (int dy = 0; dy < factor.y; ++dy)
+						for (int dz = 0; dz < factor.z; ++dz)
+							values.push_back(src.GetVoxel(
+							    start.x + dx, start.y + dy, start.z + dz));
+				out.SetVoxel(x, y, z, reduce(values));
+			}
+
+	return out;
+}
+
+template <typename T>
+i3d::Image3d<T> downsample_average(const i3d::Image3d<T>& src,
+                                   i3d::Vector3d<int> factor,
+                                   i3d::Vector3d<int> size) {
+	return downsample_window(
+	    src, factor, size, [](const std::vector<T>& values) {
+		    double sum = 0;
+		    for (T v : values)
+			    sum += double(v);
+
+		    double mean = sum / double(values.size());
+		    return T(std::is_integral_v<T> ? std::round(mean) : mean);
+	    });
+}
+
+template <typename T>
+i3d::Image3d<T> downsample_mode(const i3d::Image3d<T>& src,
+                                i3d::Vector3d<int> factor,
+                                i3d::Vector3d<int> size) {
+	return downsample_window(
+	    src, factor, size, [](std::vector<T> values) {
+		    /* Smallest of the most frequent values */
+		    std::sort(values.begin(), values.end());
+		    T best = values[0];
+		    long best_count = 0;
+		    for (T v : values) {
+			    long count = std::count(values.begin(), values.end(), v);
+			    if (count > best_count) {
+				    best = v;
+				    best_count = count;
+			    }
+		    }
+		    return best;
+	    });
+}
+
+/* Voxel-wise comparison with absolute tolerance */
+template <typename T>
+bool near(const i3d::Image3d<T>& rhs,
+          const i3d::Image3d<T>& lhs,
+          double tolerance) {
+	if (rhs.GetSize() != lhs.GetSize())
+		return false;
+
+	for (std::size_t i = 0; i < rhs.GetImageSize(); ++i)
+		if (std::abs(double(rhs.GetVoxel(i)) - double(lhs.GetVoxel(i))) >
+		    tolerance)
+			return false;
+
+	return true;
+}
+
 template <typename T>
 bool operator==(const i3d::Image3d<T>& rhs, const i3d::Image3d<T>& lhs) {
 	if (rhs.GetSize() != lhs.GetSize())
@@ -120,12 +273,12 @@ bool operator==(const i3d::Image3d<T>& rhs, const i3d::Image3d<T>& lhs) {
 	return true;
 }
 
-#define SELECT_TYPE(type, func)                                                \
+#define SELECT_TYPE(type, func, ...)                                           \
 	if (type == "uint8")                                                       \
-		func<uint8_t>();                                                       \
+		func<uint8_t>(__VA_ARGS__);                                            \
 	else if (type == "uint16")                                                 \
-		func<uint16_t>();                                                      \
+		func<uint16_t>(__VA_ARGS__);                                           \
 	else if (type == "float32")                                                \
-		func<float>();                                                         \
+		func<float>(__VA_ARGS__);                                              \
 	else                                                                       \
 		std::cout << "Image type is not supported !! \n";
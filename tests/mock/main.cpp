@@ -0,0 +1,48 @@
+#include "../common.hpp"
+#include "mock_server.hpp"
+#include <iostream>
+
+/**
+ * Standalone mock datastore for running unit and speed tests offline.
+ *
+ * Serves dataset DS_UUID on SERVER_PORT (see tests/common.hpp) until
+ * standard input is closed or a line is entered.
+ *
+ * usage: mock_server [voxel_type] [latency_ms] [bandwidth_MBps] [storage_dir]
+ */
+int main(int argc, char** argv) {
+	std::string voxel_type = argc > 1 ? argv[1] : "uint16";
+
+	mock::MockSettings settings;
+	settings.port = SERVER_PORT;
+	if (argc > 2)
+		settings.latency = std::chrono::milliseconds(std::stoll(argv[2]));
+	if (argc > 3)
+		settings.bandwidth = std::size_t(std::stod(argv[3]) * 1'000'000.0);
+	if (argc > 4)
+		settings.storage_dir = argv[4];
+
+	if (!ds::type_byte_size.contains(voxel_type)) {
+		std::cerr << "Unknown voxel type: " << voxel_type << '\n';
+		return 1;
+	}
+
+	mock::MockDatastore server(mock::make_properties(DS_UUID, voxel_type),
+	                           settings);
+	server.start();
+
+	std::cout << "Serving dataset " << DS_UUID << " (" << voxel_type
+	          << ") on port " << server.port() << ", press Enter to stop"
+	          << std::endl;
+	std::string line;
+	std::getline(std::cin, line);
+
+	server.stop();
+
+	mock::MockStats stats = server.get_stats();
+	std::cout << "Requests: " << stats.requests
+	          << ", blocks read: " << stats.blocks_read
+	          << ", blocks written: " << stats.blocks_written
+	          << ", sent: " << stats.bytes_sent
+	          << " bytes, received: " << stats.bytes_received << " bytes\n";
+}
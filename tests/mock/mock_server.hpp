@@ -0,0 +1,865 @@
+#pragma once
+#include "../../src/hpc_ds_api.hpp"
+#include <Poco/Dynamic/Var.h>
+#include <Poco/JSON/Array.h>
+#include <Poco/JSON/Object.h>
+#include <Poco/Net/HTTPRequestHandler.h>
+#include <Poco/Net/HTTPRequestHandlerFactory.h>
+#include <Poco/Net/HTTPServer.h>
+#include <Poco/Net/HTTPServerParams.h>
+#include <Poco/Net/HTTPServerRequest.h>
+#include <Poco/Net/HTTPServerResponse.h>
+#include <Poco/Net/ServerSocket.h>
+#include <Poco/URI.h>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Local stand-in for the HPC Datastore server.
+ *
+ * Implements only the subset of the protocol used by this client:
+ *  - GET  /datasets/<uuid>                                   (dataset JSON)
+ *  - GET  /datasets/<uuid>/<rx>/<ry>/<rz>/<version>/read-write  (307 redirect)
+ *  - GET  <session>(/<x>/<y>/<z>/<time>/<channel>/<angle>)+  (read blocks)
+ *  - POST <session>(/<x>/<y>/<z>/<time>/<channel>/<angle>)+  (write blocks)
+ *
+ * Blocks are stored as sent (12 byte header + big-endian data) either in
+ * memory or, when a storage directory is given, one file per block. Blocks
+ * that were never written are returned filled with zeros.
+ */
+namespace mock {
+
+/**
+ * @brief Settings of the mock server
+ */
+struct MockSettings {
+	/* Port to listen on (0 picks any free port) */
+	int port = 9080;
+
+	/* Delay applied before answering each request */
+	std::chrono::milliseconds latency{0};
+
+	/* Bytes per second in each direction of a request (0 = unlimited) */
+	std::size_t bandwidth = 0;
+
+	/* Directory to store blocks in (empty = keep them in memory) */
+	std::filesystem::path storage_dir;
+
+	/* Maximal number of requests served at the same time */
+	int max_threads = 16;
+};
+
+/**
+ * @brief Counters of the traffic served by the mock server
+ */
+struct MockStats {
+	std::size_t requests = 0;
+	std::size_t blocks_read = 0;
+	std::size_t blocks_written = 0;
+	std::size_t faults = 0;
+	std::size_t bytes_sent = 0;
+	std::size_t bytes_received = 0;
+};
+
+/**
+ * @brief Create properties of a dataset served by the mock server
+ *
+ * The dataset has versions 0 and 1 ("latest" is 1).
+ *
+ * @param uuid dataset uuid
+ * @param voxel_type type of voxels (see ds::type_byte_size)
+ * @param dimensions dimensions of the image at full resolution
+ * @param block_dim block dimensions used at every resolution level
+ * @param resolutions available resolution levels
+ * @return ds::DatasetProperties
+ */
+inline ds::DatasetProperties
+make_properties(const std::string& uuid,
+                const std::string& voxel_type = "uint16",
+                i3d::Vector3d<int> dimensions = {300, 200, 50},
+                i3d::Vector3d<int> block_dim = {64, 64, 16},
+                const std::vector<i3d::Vector3d<int>>& resolutions = {
+                    {1, 1, 1}, {2, 2, 1}, {4, 4, 2}});
+
+/**
+ * @brief Serialize properties to the JSON sent by the datastore server
+ *
+ * @param props properties to serialize
+ * @return std::string JSON
+ */
+inline std::string to_json(const ds::DatasetProperties& props);
+
+/**
+ * @brief Embeddable mock of the HPC Datastore server
+ *
+ * The server runs on background threads between start() and stop() (or
+ * destruction), so it can be started directly by the test executable.
+ */
+class MockDatastore {
+  public:
+	/**
+	 * @brief Construct a new mock server (not listening until started)
+	 *
+	 * @param props properties of the only dataset served
+	 * @param settings server settings
+	 */
+	MockDatastore(ds::DatasetProperties props, MockSettings settings = {});
+
+	MockDatastore(const MockDatastore&) = delete;
+	MockDatastore& operator=(const MockDatastore&) = delete;
+
+	~MockDatastore();
+
+	/**
+	 * @brief Start listening on the configured port
+	 */
+	void start();
+
+	/**
+	 * @brief Stop listening, waits for running requests to finish
+	 */
+	void stop();
+
+	/**
+	 * @brief Port the server listens on (valid after start())
+	 */
+	int port() const;
+
+	/**
+	 * @brief Change delay applied before answering each request
+	 */
+	void set_latency(std::chrono::milliseconds latency);
+
+	/**
+	 * @brief Change bandwidth limit in bytes per second (0 = unlimited)
+	 */
+	void set_bandwidth(std::size_t bandwidth);
+
+	/**
+	 * @brief Make the next <count> block requests fail
+	 *
+	 * Requests are answered with <status>. With HTTP_OK, reads send only a
+	 * part of the requested blocks, or all of them followed by extra bytes
+	 * when <overlong> (writes are not affected).
+	 */
+	void inject_faults(std::size_t count,
+	                   Poco::Net::HTTPResponse::HTTPStatus status,
+	                   bool overlong = false);
+
+	/**
+	 * @brief Get counters of the traffic served since start
+	 */
+	MockStats get_stats() const;
+
+	/**
+	 * @brief Handle single HTTP request (called by server threads)
+	 */
+	void handle(Poco::Net::HTTPServerRequest& request,
+	            Poco::Net::HTTPServerResponse& response);
+
+  private:
+	/* resolution x, y, z, version, time, channel, angle, block x, y, z */
+	using BlockKey = std::array<int, 10>;
+
+	/* Body of a block read */
+	enum class Body { COMPLETE, TRUNCATED, OVERLONG };
+
+	/* Injected fault of one block request */
+	struct Fault {
+		Poco::Net::HTTPResponse::HTTPStatus status;
+		bool overlong;
+	};
+
+	/* Data needed to serve one session (resolution + version) */
+	struct Session {
+		i3d::Vector3d<int> resolution;
+		int version;
+	};
+
+	/* Sleeps so that transferred bytes do not exceed the bandwidth */
+	class Throttle {
+	  public:
+		explicit Throttle(std::size_t bandwidth);
+		void consume(std::size_t bytes);
+
+	  private:
+		std::size_t _bandwidth;
+		std::size_t _total = 0;
+		std::chrono::steady_clock::time_point _start;
+	};
+
+	static constexpr std::size_t CHUNK_SIZE = 64 * 1024;
+
+	ds::DatasetProperties _props;
+	MockSettings _settings;
+	std::unique_ptr<Poco::Net::HTTPServer> _server;
+
+	std::atomic<long long> _latency;
+	std::atomic<std::size_t> _bandwidth;
+
+	mutable std::mutex _faults_mutex;
+	std::size_t _faults = 0;
+	Poco::Net::HTTPResponse::HTTPStatus _fault_status =
+	    Poco::Net::HTTPResponse::HTTP_OK;
+	bool _fault_overlong = false;
+
+	mutable std::shared_mutex _blocks_mutex;
+	std::map<BlockKey, std::vector<char>> _blocks;
+
+	mutable std::mutex _stats_mutex;
+	MockStats _stats;
+
+	void send_properties(Poco::Net::HTTPServerResponse& response);
+	void redirect_to_session(const std::vector<std::string>& path,
+	                         Poco::Net::HTTPServerRequest& request,
+	                         Poco::Net::HTTPServerResponse& response);
+	void read_blocks(const Session& session,
+	                 const std::vector<std::array<int, 6>>& coords,
+	                 Poco::Net::HTTPServerResponse& response,
+	                 Body body);
+	void write_blocks(const Session& session,
+	                  const std::vector<std::array<int, 6>>& coords,
+	                  Poco::Net::HTTPServerRequest& request,
+	                  Poco::Net::HTTPServerResponse& response);
+	void send_error(Poco::Net::HTTPServerResponse& response,
+	                Poco::Net::HTTPResponse::HTTPStatus status,
+	                const std::string& message);
+
+	std::optional<Fault> take_fault();
+	std::optional<int> parse_version(const std::string& version) const;
+	bool valid_block(const Session& session,
+	                 const std::array<int, 6>& coord) const;
+	static BlockKey make_key(const Session& session,
+	                         const std::array<int, 6>& coord);
+
+	std::optional<std::vector<char>> load_block(const BlockKey& key) const;
+	void store_block(const BlockKey& key, std::vector<char> data);
+	std::filesystem::path block_path(const BlockKey& key) const;
+};
+
+} // namespace mock
+
+/* ================= IMPLEMENTATION FOLLOWS ======================== */
+
+namespace mock {
+
+namespace details {
+/* Splits path into its non-empty segments */
+inline std::vector<std::string> split_path(const std::string& path) {
+	std::vector<std::string> out;
+	std::istringstream stream(path);
+	std::string segment;
+
+	while (std::getline(stream, segment, '/'))
+		if (!segment.empty())
+			out.push_back(segment);
+
+	return out;
+}
+
+/* Parses whole string as integer */
+inline std::optional<int> parse_int(const std::string& str) {
+	try {
+		std::size_t pos = 0;
+		int out = std::stoi(str, &pos);
+		if (pos != str.size())
+			return {};
+		return out;
+	} catch (const std::exception&) {
+		return {};
+	}
+}
+
+template <typename T>
+Poco::JSON::Array::Ptr to_array(i3d::Vector3d<T> vec) {
+	Poco::JSON::Array::Ptr out(new Poco::JSON::Array);
+	for (int i = 0; i < 3; ++i)
+		out->add(vec[i]);
+	return out;
+}
+
+inline Poco::Dynamic::Var to_var(const std::optional<ds::ResolutionUnit>& res) {
+	if (!res)
+		return {};
+
+	Poco::JSON::Object::Ptr out(new Poco::JSON::Object);
+	out->set("value", res->value);
+	out->set("unit", res->unit);
+	return out;
+}
+
+/* Forwards requests to the mock server */
+class RequestHandler : public Poco::Net::HTTPRequestHandler {
+  public:
+	explicit RequestHandler(MockDatastore& server) : _server(server) {}
+
+	void handleRequest(Poco::Net::HTTPServerRequest& request,
+	                   Poco::Net::HTTPServerResponse& response) override {
+		_server.handle(request, response);
+	}
+
+  private:
+	MockDatastore& _server;
+};
+
+class RequestHandlerFactory : public Poco::Net::HTTPRequestHandlerFactory {
+  public:
+	explicit RequestHandlerFactory(MockDatastore& server) : _server(server) {}
+
+	Poco::Net::HTTPRequestHandler*
+	createRequestHandler(const Poco::Net::HTTPServerRequest&) override {
+		return new RequestHandler(_server);
+	}
+
+  private:
+	MockDatastore& _server;
+};
+} // namespace details
+
+/* inline */ ds::DatasetProperties
+make_properties(const std::string& uuid,
+                const std::string& voxel_type /* = "uint16" */,
+                i3d::Vector3d<int> dimensions /* = {300, 200, 50} */,
+                i3d::Vector3d<int> block_dim /* = {64, 64, 16} */,
+                const std::vector<i3d::Vector3d<int>>& resolutions
+                /* = {{1, 1, 1}, {2, 2, 1}, {4, 4, 2}} */) {
+	ds::DatasetProperties props;
+	props.uuid = uuid;
+	props.voxel_type = voxel_type;
+	props.dimensions = dimensions;
+	props.channels = 1;
+	props.angles = 1;
+	props.voxel_unit = "um";
+	props.voxel_resolution = i3d::Vector3d<double>{1.0, 1.0, 1.0};
+	props.compression = "raw";
+	props.versions = {0, 1};
+	props.label = "mock";
+	props.timepoint_ids = {0};
+
+	for (auto resolution : resolutions)
+		props.resolution_levels.push_back(
+		    {{"resolutions", resolution}, {"blockDimensions", block_dim}});
+
+	return props;
+}
+
+/* inline */ std::string to_json(const ds::DatasetProperties& props) {
+	using details::to_array;
+	Poco::JSON::Object root;
+
+	root.set("uuid", props.uuid);
+	root.set("voxelType", props.voxel_type);
+	root.set("dimensions", to_array(props.dimensions));
+	root.set("channels", props.channels);
+	root.set("angles", props.angles);
+	root.set("transformations", props.transformations
+	                                ? Poco::Dynamic::Var(*props.transformations)
+	                                : Poco::Dynamic::Var());
+	root.set("voxelUnit", props.voxel_unit);
+	root.set("voxelResolution", props.voxel_resolution
+	                                ? Poco::Dynamic::Var(
+	                                      to_array(*props.voxel_resolution))
+	                                : Poco::Dynamic::Var());
+	root.set("timepointResolution",
+	         details::to_var(props.timepoint_resolution));
+	root.set("channelResolution", details::to_var(props.channel_resolution));
+	root.set("angleResolution", details::to_var(props.angle_resolution));
+	root.set("compression", props.compression);
+
+	Poco::JSON::Array::Ptr levels(new Poco::JSON::Array);
+	for (const auto& map : props.resolution_levels) {
+		Poco::JSON::Object::Ptr level(new Poco::JSON::Object);
+		for (const auto& [name, value] : map)
+			level->set(name, to_array(value));
+		levels->add(level);
+	}
+	root.set("resolutionLevels", levels);
+
+	Poco::JSON::Array::Ptr versions(new Poco::JSON::Array);
+	for (int version : props.versions)
+		versions->add(version);
+	root.set("versions", versions);
+
+	root.set("label", props.label);
+	root.set("viewRegistrations",
+	         props.view_registrations
+	             ? Poco::Dynamic::Var(*props.view_registrations)
+	             : Poco::Dynamic::Var());
+
+	Poco::JSON::Array::Ptr timepoints(new Poco::JSON::Array);
+	for (int id : props.timepoint_ids)
+		timepoints->add(id);
+	root.set("timepointIds", timepoints);
+
+	std::ostringstream out;
+	root.stringify(out);
+	return out.str();
+}
+
+/* ======================== MockDatastore ========================== */
+
+inline MockDatastore::MockDatastore(ds::DatasetProperties props,
+                                    MockSettings settings /* = {} */)
+    : _props(std::move(props)), _settings(std::move(settings)),
+      _latency(_settings.latency.count()), _bandwidth(_settings.bandwidth) {
+	if (!_settings.storage_dir.empty())
+		std::filesystem::create_directories(_settings.storage_dir);
+}
+
+inline MockDatastore::~MockDatastore() { stop(); }
+
+inline void MockDatastore::start() {
+	if (_server)
+		return;
+
+	Poco::Net::HTTPServerParams::Ptr params = new Poco::Net::HTTPServerParams;
+	params->setMaxThreads(_settings.max_threads);
+	params->setKeepAlive(true);
+
+	Poco::Net::ServerSocket socket(
+	    static_cast<unsigned short>(_settings.port));
+
+	_server = std::make_unique<Poco::Net::HTTPServer>(
+	    Poco::Net::HTTPRequestHandlerFactory::Ptr(
+	        new details::RequestHandlerFactory(*this)),
+	    socket, params);
+	_server->start();
+
+	std::lock_guard lock(_stats_mutex);
+	_stats = {};
+}
+
+inline void MockDatastore::stop() {
+	if (!_server)
+		return;
+
+	_server->stop();
+	_server.reset();
+}
+
+inline int MockDatastore::port() const {
+	return _server ? int(_server->port()) : _settings.port;
+}
+
+inline void MockDatastore::set_latency(std::chrono::milliseconds latency) {
+	_latency = latency.count();
+}
+
+inline void MockDatastore::set_bandwidth(std::size_t bandwidth) {
+	_bandwidth = bandwidth;
+}
+
+inline void
+MockDatastore::inject_faults(std::size_t count,
+                             Poco::Net::HTTPResponse::HTTPStatus status,
+                             bool overlong /* = false */) {
+	std::lock_guard lock(_faults_mutex);
+	_faults = count;
+	_fault_status = status;
+	_fault_overlong = overlong;
+}
+
+inline std::optional<MockDatastore::Fault> MockDatastore::take_fault() {
+	Fault out;
+	{
+		std::lock_guard lock(_faults_mutex);
+		if (_faults == 0)
+			return {};
+		--_faults;
+		out = {_fault_status, _fault_overlong};
+	}
+
+	std::lock_guard lock(_stats_mutex);
+	++_stats.faults;
+	return out;
+}
+
+inline MockStats MockDatastore::get_stats() const {
+	std::lock_guard lock(_stats_mutex);
+	return _stats;
+}
+
+inline void MockDatastore::handle(Poco::Net::HTTPServerRequest& request,
+                                  Poco::Net::HTTPServerResponse& response) {
+	using Poco::Net::HTTPRequest;
+	using Poco::Net::HTTPResponse;
+
+	{
+		std::lock_guard lock(_stats_mutex);
+		++_stats.requests;
+	}
+	std::this_thread::sleep_for(std::chrono::milliseconds(_latency.load()));
+
+	std::vector<std::string> path =
+	    details::split_path(Poco::URI(request.getURI()).getPath());
+
+	if (path.size() < 2 || path[0] != "datasets")
+		return send_error(response, HTTPResponse::HTTP_NOT_FOUND,
+		                  "Unknown endpoint");
+
+	if (path[1] != _props.uuid)
+		return send_error(response, HTTPResponse::HTTP_NOT_FOUND,
+		                  "Dataset not found");
+
+	/* /datasets/<uuid> */
+	if (path.size() == 2)
+		return send_properties(response);
+
+	/* /datasets/<uuid>/<rx>/<ry>/<rz>/<version>/read-write */
+	if (path.size() == 7 && path[6] == "read-write")
+		return redirect_to_session(path, request, response);
+
+	/* /datasets/<uuid>/<rx>/<ry>/<rz>/<version>/session(/<coord>)+ */
+	if (path.size() < 7 || path[6] != "session" || (path.size() - 7) % 6 != 0)
+		return send_error(response, HTTPResponse::HTTP_NOT_FOUND,
+		                  "Unknown endpoint");
+
+	Session session;
+	for (int i = 0; i < 3; ++i) {
+		std::optional<int> value = details::parse_int(path[2 + i]);
+		if (!value)
+			return send_error(response, HTTPResponse::HTTP_BAD_REQUEST,
+			                  "Invalid resolution");
+		session.resolution[i] = *value;
+	}
+
+	std::vector<i3d::Vector3d<int>> resolutions = _props.get_all_resolutions();
+	std::optional<int> version = parse_version(path[5]);
+	if (std::ranges::find(resolutions, session.resolution) ==
+	        resolutions.end() ||
+	    !version)
+		return send_error(response, HTTPResponse::HTTP_NOT_FOUND,
+		                  "Session not found");
+	session.version = *version;
+
+	std::vector<std::array<int, 6>> coords;
+	for (std::size_t i = 7; i < path.size(); i += 6) {
+		std::array<int, 6> coord;
+		for (std::size_t j = 0; j < 6; ++j) {
+			std::optional<int> value = details::parse_int(path[i + j]);
+			if (!value)
+				return send_error(response, HTTPResponse::HTTP_BAD_REQUEST,
+				                  "Invalid block coordinates");
+			coord[j] = *value;
+		}
+
+		if (!valid_block(session, coord))
+			return send_error(response, HTTPResponse::HTTP_NOT_FOUND,
+			                  "Block out of the dataset");
+		coords.push_back(coord);
+	}
+
+	std::optional<Fault> fault = take_fault();
+	if (fault && fault->status != HTTPResponse::HTTP_OK)
+		return send_error(response, fault->status, "Injected fault");
+
+	if (request.getMethod() == HTTPRequest::HTTP_GET) {
+		Body body = Body::COMPLETE;
+		if (fault)
+			body = fault->overlong ? Body::OVERLONG : Body::TRUNCATED;
+		return read_blocks(session, coords, response, body);
+	}
+	if (request.getMethod() == HTTPRequest::HTTP_POST)
+		return write_blocks(session, coords, request, response);
+
+	send_error(response, HTTPResponse::HTTP_BAD_REQUEST,
+	           "Unsupported method");
+}
+
+inline void
+MockDatastore::send_properties(Poco::Net::HTTPServerResponse& response) {
+	std::string json = to_json(_props);
+
+	response.setStatus(Poco::Net::HTTPResponse::HTTP_OK);
+	response.setContentType("application/json");
+	response.setContentLength(std::streamsize(json.size()));
+	response.send() << json;
+}
+
+inline void
+MockDatastore::redirect_to_session(const std::vector<std::string>& path,
+                                   Poco::Net::HTTPServerRequest& request,
+                                   Poco::Net::HTTPServerResponse& response) {
+	using Poco::Net::HTTPResponse;
+
+	i3d::Vector3d<int> resolution;
+	for (int i = 0; i < 3; ++i) {
+		std::optional<int> value = details::parse_int(path[2 + i]);
+		if (!value)
+			return send_error(response, HTTPResponse::HTTP_BAD_REQUEST,
+			                  "Invalid resolution");
+		resolution[i] = *value;
+	}
+
+	std::vector<i3d::Vector3d<int>> resolutions = _props.get_all_resolutions();
+	if (std::ranges::find(resolutions, resolution) == resolutions.end())
+		return send_error(response, HTTPResponse::HTTP_NOT_FOUND,
+		                  "Resolution not found");
+
+	std::optional<int> version = parse_version(path[5]);
+	if (!version)
+		return send_error(response, HTTPResponse::HTTP_NOT_FOUND,
+		                  "Version not found");
+
+	std::string location = fmt::format(
+	    "http://{}/datasets/{}/{}/{}/{}/{}/session", request.getHost(),
+	    _props.uuid, resolution.x, resolution.y, resolution.z, *version);
+
+	response.set("Location", location);
+	response.setStatus(HTTPResponse::HTTP_TEMPORARY_REDIRECT);
+	response.setContentLength(0);
+	response.send();
+}
+
+inline void
+MockDatastore::read_blocks(const Session& session,
+                           const std::vector<std::array<int, 6>>& coords,
+                           Poco::Net::HTTPServerResponse& response,
+                           Body body) {
+	std::vector<std::vector<char>> blocks;
+	std::size_t total = 0;
+
+	i3d::Vector3d<int> block_dim =
+	    _props.get_block_dimensions(session.resolution);
+	i3d::Vector3d<int> img_dim = _props.get_img_dimensions(session.resolution);
+
+	for (const auto& coord : coords) {
+		std::optional<std::vector<char>> block =
+		    load_block(make_key(session, coord));
+
+		if (!block) {
+			/* Never written, send zeros */
+			i3d::Vector3d<int> size = ds::details::data_manip::get_block_size(
+			    {coord[0], coord[1], coord[2]}, block_dim, img_dim);
+			block.emplace(ds::details::data_manip::get_block_data_size(
+			    size, _props.voxel_type));
+
+			ds::details::data_manip::set_elem_at(*block, "int32", 0, size.x);
+			ds::details::data_manip::set_elem_at(*block, "int32", 4, size.y);
+			ds::details::data_manip::set_elem_at(*block, "int32", 8, size.z);
+		}
+
+		total += block->size();
+		blocks.push_back(std::move(*block));
+	}
+
+	/* Truncated body ends in the middle of a block, overlong one has
+	 * zeros appended */
+	std::size_t length = total;
+	if (body == Body::TRUNCATED)
+		length = total / 2;
+	else if (body == Body::OVERLONG) {
+		length = total + total / 2 + 1;
+		blocks.emplace_back(length - total);
+	}
+
+	response.setStatus(Poco::Net::HTTPResponse::HTTP_OK);
+	response.setContentType("application/octet-stream");
+	response.setContentLength(std::streamsize(length));
+	std::ostream& os = response.send();
+
+	Throttle throttle(_bandwidth);
+	std::size_t sent = 0;
+	for (const auto& block : blocks)
+		for (std::size_t i = 0; i < block.size() && sent < length;
+		     i += CHUNK_SIZE) {
+			std::size_t count =
+			    std::min({CHUNK_SIZE, block.size() - i, length - sent});
+			os.write(block.data() + i, std::streamsize(count));
+			throttle.consume(count);
+			sent += count;
+		}
+
+	std::lock_guard lock(_stats_mutex);
+	_stats.blocks_read += coords.size();
+	_stats.bytes_sent += length;
+}
+
+inline void
+MockDatastore::write_blocks(const Session& session,
+                            const std::vector<std::array<int, 6>>& coords,
+                            Poco::Net::HTTPServerRequest& request,
+                            Poco::Net::HTTPServerResponse& response) {
+	using Poco::Net::HTTPResponse;
+
+	i3d::Vector3d<int> block_dim =
+	    _props.get_block_dimensions(session.resolution);
+	i3d::Vector3d<int> img_dim = _props.get_img_dimensions(session.resolution);
+
+	std::istream& is = request.stream();
+	Throttle throttle(_bandwidth);
+	std::size_t total = 0;
+
+	/* Validate the whole body first, so failed request stores nothing */
+	std::vector<std::vector<char>> blocks;
+	for (const auto& coord : coords) {
+		i3d::Vector3d<int> size = ds::details::data_manip::get_block_size(
+		    {coord[0], coord[1], coord[2]}, block_dim, img_dim);
+		std::vector<char> block(std::size_t(
+		    ds::details::data_manip::get_block_data_size(size,
+		                                                 _props.voxel_type)));
+
+		is.read(block.data(), 12);
+		i3d::Vector3d<int> header;
+		for (int i = 0; i < 3; ++i)
+			header[i] = ds::details::data_manip::get_elem_at<int>(
+			    block, "int32", 4 * i);
+
+		if (!is || header != size)
+			return send_error(response, HTTPResponse::HTTP_BAD_REQUEST,
+			                  "Invalid block header");
+
+		for (std::size_t i = 12; i < block.size(); i += CHUNK_SIZE) {
+			std::size_t count = std::min(CHUNK_SIZE, block.size() - i);
+			is.read(block.data() + i, std::streamsize(count));
+			throttle.consume(count);
+		}
+
+		if (!is)
+			return send_error(response, HTTPResponse::HTTP_BAD_REQUEST,
+			                  "Request body is too short");
+
+		total += block.size();
+		blocks.push_back(std::move(block));
+	}
+
+	for (std::size_t i = 0; i < coords.size(); ++i)
+		store_block(make_key(session, coords[i]), std::move(blocks[i]));
+
+	response.setStatus(HTTPResponse::HTTP_OK);
+	response.setContentLength(0);
+	response.send();
+
+	std::lock_guard lock(_stats_mutex);
+	_stats.blocks_written += coords.size();
+	_stats.bytes_received += total;
+}
+
+inline void
+MockDatastore::send_error(Poco::Net::HTTPServerResponse& response,
+                          Poco::Net::HTTPResponse::HTTPStatus status,
+                          const std::string& message) {
+	response.setStatusAndReason(status);
+	response.setContentType("text/plain");
+	response.setContentLength(std::streamsize(message.size()));
+	response.send() << message;
+}
+
+inline std::optional<int>
+MockDatastore::parse_version(const std::string& version) const {
+	if (version == "latest")
+		return _props.versions.empty()
+		           ? 0
+		           : *std::ranges::max_element(_props.versions);
+
+	std::optional<int> out = details::parse_int(version);
+	if (out &&
+	    std::ranges::find(_props.versions, *out) == _props.versions.end())
+		return {};
+	return out;
+}
+
+inline bool MockDatastore::valid_block(const Session& session,
+                                       const std::array<int, 6>& coord) const {
+	i3d::Vector3d<int> img_dim = _props.get_img_dimensions(session.resolution);
+	i3d::Vector3d<int> block_dim =
+	    _props.get_block_dimensions(session.resolution);
+	i3d::Vector3d<int> block_count = (img_dim + block_dim - 1) / block_dim;
+
+	for (int i = 0; i < 3; ++i)
+		if (coord[i] < 0 || coord[i] >= block_count[i])
+			return false;
+
+	return coord[3] >= 0 && coord[4] >= 0 && coord[4] < _props.channels &&
+	       coord[5] >= 0 && coord[5] < _props.angles;
+}
+
+inline MockDatastore::BlockKey
+MockDatastore::make_key(const Session& session,
+                        const std::array<int, 6>& coord) {
+	return {session.resolution.x,
+	        session.resolution.y,
+	        session.resolution.z,
+	        session.version,
+	        coord[3],
+	        coord[4],
+	        coord[5],
+	        coord[0],
+	        coord[1],
+	        coord[2]};
+}
+
+inline std::optional<std::vector<char>>
+MockDatastore::load_block(const BlockKey& key) const {
+	std::shared_lock lock(_blocks_mutex);
+
+	if (_settings.storage_dir.empty()) {
+		auto it = _blocks.find(key);
+		if (it == _blocks.end())
+			return {};
+		return it->second;
+	}
+
+	std::filesystem::path path = block_path(key);
+	if (!std::filesystem::exists(path))
+		return {};
+
+	std::vector<char> out(std::filesystem::file_size(path));
+	std::ifstream file(path, std::ios::binary);
+	file.read(out.data(), std::streamsize(out.size()));
+	return out;
+}
+
+inline void MockDatastore::store_block(const BlockKey& key,
+                                       std::vector<char> data) {
+	std::unique_lock lock(_blocks_mutex);
+
+	if (_settings.storage_dir.empty()) {
+		_blocks[key] = std::move(data);
+		return;
+	}
+
+	std::ofstream file(block_path(key), std::ios::binary | std::ios::trunc);
+	file.write(data.data(), std::streamsize(data.size()));
+}
+
+inline std::filesystem::path
+MockDatastore::block_path(const BlockKey& key) const {
+	std::string name;
+	for (int value : key)
+		name += std::to_string(value) + "_";
+	name.back() = '.';
+
+	return _settings.storage_dir / (name + "block");
+}
+
+/* ========================= Throttle ============================== */
+
+inline MockDatastore::Throttle::Throttle(std::size_t bandwidth)
+    : _bandwidth(bandwidth), _start(std::chrono::steady_clock::now()) {}
+
+inline void MockDatastore::Throttle::consume(std::size_t bytes) {
+	_total += bytes;
+	if (_bandwidth == 0)
+		return;
+
+	std::chrono::duration<double> elapsed(double(_total) / double(_bandwidth));
+	std::this_thread::sleep_until(
+	    _start +
+	    std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+	        elapsed));
+}
+
+} // namespace mock
@@ -4,14 +4,12 @@
 #include <i3d/image3d.h>
 
 template <typename T>
-void meassure() {
+void meassure(ds::dataset_props_ptr props) {
 	ds::ImageView img_view(SERVER_IP, SERVER_PORT, DS_UUID, IMG_CHANNEL,
 	                       IMG_TIMEPOINT, IMG_ANGLE, IMG_RESOLUTION,
 	                       IMG_VERSION);
 
 	std::cout << "Searching for blocks to request\n";
-	auto props =
-	    ds::get_dataset_properties(SERVER_IP, SERVER_PORT, DS_UUID);
 
 	i3d::Vector3d<int> img_dim = props->get_img_dimensions(IMG_RESOLUTION);
 	i3d::Vector3d<int> block_dim = props->get_block_dimensions(IMG_RESOLUTION);
@@ -30,14 +28,11 @@ void meassure() {
 	auto start = std::chrono::steady_clock::now();
 
 	for (auto block : blocks)
-		auto img = img_view.read_block<T>(block); 
+		auto img = img_view.read_block<T>(block, props);
 
 	auto end = std::chrono::steady_clock::now();
 
-	double secs = double(std::chrono::duration_cast<std::chrono::milliseconds>(
-	                         end - start)
-	                         .count()) /
-	              1000.0;
+	double secs = std::chrono::duration<double>(end - start).count();
 	std::size_t bytes = img_dim.x * img_dim.y * img_dim.z * sizeof(T);
 	std::cout << "Reading took: " << secs << " seconds\n";
 	std::cout << "Downloaded: " << bytes << " bytes\n";
@@ -54,5 +49,5 @@ int main() {
 	std::cout << "[OK]" << std::endl;
 
 	/** Select correct format for template **/
-	SELECT_TYPE(props->voxel_type, meassure);
+	SELECT_TYPE(props->voxel_type, meassure, props);
 }
\ No newline at end of file
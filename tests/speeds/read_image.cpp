@@ -4,22 +4,19 @@
 #include <i3d/image3d.h>
 
 template <typename T>
-void meassure() {
+void meassure(ds::dataset_props_ptr props) {
 	ds::ImageView img_view(SERVER_IP, SERVER_PORT, DS_UUID, IMG_CHANNEL,
 	                       IMG_TIMEPOINT, IMG_ANGLE, IMG_RESOLUTION,
-	                       IMG_VERSION);	
+	                       IMG_VERSION);
 
 	std::cout << "Starting meassurement\n";
 	auto start = std::chrono::steady_clock::now();
 
-	i3d::Image3d<T> img = img_view.read_image<T>();
+	i3d::Image3d<T> img = img_view.read_image<T>(props);
 
 	auto end = std::chrono::steady_clock::now();
 
-	double secs = double(std::chrono::duration_cast<std::chrono::milliseconds>(
-	                         end - start)
-	                         .count()) /
-	              1000.0;
+	double secs = std::chrono::duration<double>(end - start).count();
 	std::size_t bytes = img.GetImageSize() * sizeof(T);
 	std::cout << "Reading took: " << secs << " seconds\n";
 	std::cout << "Downloaded: " << bytes << " bytes\n";
@@ -36,5 +33,5 @@ int main() {
 	std::cout << "[OK]" << std::endl;
 
 	/** Select correct format for template **/
-	SELECT_TYPE(props->voxel_type, meassure);
+	SELECT_TYPE(props->voxel_type, meassure, props);
 }
\ No newline at end of file
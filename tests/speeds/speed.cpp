@@ -0,0 +1,421 @@
+#include "../../src/hpc_ds_api.hpp"
+#include "../common.hpp"
+#include "../mock/mock_server.hpp"
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <fmt/core.h>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <sstream>
+#include <i3d/image3d.h>
+#include <thread>
+
+/**
+ * Parameterised speed test
+ *
+ * Runs every combination of the given parameters (comma separated lists):
+ *
+ *   --mode=read,write          direction of transfer
+ *   --unit=block,region,image  what is transferred by one operation
+ *   --order=ordered,shuffled   order of blocks/regions
+ *   --threads=1,4              number of concurrent operations
+ *   --batch=0,16               blocks per request (and per block operation),
+ *                              0 = library defaults, single block operations
+ *   --region=X,Y,Z             region size (default 2x block dimensions)
+ *   --warmup=1                 untimed trials before measurement
+ *   --trials=5                 measured trials
+ *   --json=<file>              also write results as JSON
+ *
+ * By default, the server from tests/common.hpp is used. With --mock[=type],
+ * a local mock server is started instead (--mock-latency=<ms> and
+ * --mock-bandwidth=<MB/s> emulate network).
+ */
+
+using Vec = i3d::Vector3d<int>;
+using clock_type = std::chrono::steady_clock;
+
+struct Options {
+	std::vector<std::string> modes = {"read"};
+	std::vector<std::string> units = {"block"};
+	std::vector<std::string> orders = {"shuffled"};
+	std::vector<int> threads = {1};
+	std::vector<std::size_t> batches = {0};
+	std::optional<Vec> region;
+	int warmup = 1;
+	int trials = 5;
+	std::string json;
+
+	std::optional<std::string> mock_type;
+	int mock_latency = 0;
+	double mock_bandwidth = 0;
+};
+
+struct Config {
+	std::string mode, unit, order;
+	int threads;
+	std::size_t batch;
+};
+
+struct Report {
+	Config config;
+	std::size_t operations = 0;       // per trial
+	std::size_t bytes = 0;            // per trial
+	std::vector<double> latencies;    // seconds, all measured operations
+	std::vector<double> throughputs;  // bytes per second, one per trial
+};
+
+void print_report(const Report& r);
+
+struct Trial {
+	double seconds;
+	std::size_t bytes;
+};
+
+/* One operation, returns transferred bytes (voxels only) */
+using Operation = std::function<std::size_t()>;
+
+double seconds(clock_type::duration d) {
+	return std::chrono::duration<double>(d).count();
+}
+
+std::vector<std::string> split(const std::string& str) {
+	std::vector<std::string> out;
+	std::stringstream stream(str);
+	std::string item;
+	while (std::getline(stream, item, ','))
+		out.push_back(item);
+	return out;
+}
+
+Options parse_options(int argc, char** argv) {
+	Options opts;
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		std::size_t eq = arg.find('=');
+		std::string key = arg.substr(0, eq);
+		std::string value = eq == std::string::npos ? "" : arg.substr(eq + 1);
+
+		if (key == "--mode")
+			opts.modes = split(value);
+		else if (key == "--unit")
+			opts.units = split(value);
+		else if (key == "--order")
+			opts.orders = split(value);
+		else if (key == "--threads") {
+			opts.threads.clear();
+			for (auto& v : split(value))
+				opts.threads.push_back(std::stoi(v));
+		} else if (key == "--batch") {
+			opts.batches.clear();
+			for (auto& v : split(value))
+				opts.batches.push_back(std::stoul(v));
+		} else if (key == "--region") {
+			auto v = split(value);
+			if (v.size() != 3)
+				throw std::invalid_argument("--region needs X,Y,Z");
+			opts.region =
+			    Vec{std::stoi(v[0]), std::stoi(v[1]), std::stoi(v[2])};
+		} else if (key == "--warmup")
+			opts.warmup = std::stoi(value);
+		else if (key == "--trials") {
+			opts.trials = std::stoi(value);
+			if (opts.trials < 1)
+				throw std::invalid_argument("--trials needs at least 1");
+		} else if (key == "--json")
+			opts.json = value;
+		else if (key == "--mock")
+			opts.mock_type = value.empty() ? "uint16" : value;
+		else if (key == "--mock-latency")
+			opts.mock_latency = std::stoi(value);
+		else if (key == "--mock-bandwidth")
+			opts.mock_bandwidth = std::stod(value);
+		else
+			throw std::invalid_argument("Unknown argument: " + arg);
+	}
+	return opts;
+}
+
+double percentile(std::vector<double> values, double p) {
+	if (values.empty())
+		return 0;
+	std::ranges::sort(values);
+	auto rank = std::size_t(std::ceil(p / 100.0 * double(values.size())));
+	return values[std::clamp<std::size_t>(rank, 1, values.size()) - 1];
+}
+
+double mean(const std::vector<double>& values) {
+	double sum = 0;
+	for (double v : values)
+		sum += v;
+	return values.empty() ? 0 : sum / double(values.size());
+}
+
+double stddev(const std::vector<double>& values) {
+	if (values.size() < 2)
+		return 0;
+	double m = mean(values), sum = 0;
+	for (double v : values)
+		sum += (v - m) * (v - m);
+	return std::sqrt(sum / double(values.size() - 1));
+}
+
+/* Runs all operations on <threads> threads, records their latencies */
+Trial run_trial(const std::vector<Operation>& ops,
+                int threads,
+                std::vector<double>* latencies) {
+	std::atomic<std::size_t> next = 0;
+	std::atomic<std::size_t> bytes = 0;
+	std::vector<std::vector<double>> thread_latencies(
+	    static_cast<std::size_t>(threads));
+
+	auto start = clock_type::now();
+	std::vector<std::thread> workers;
+	for (int t = 0; t < threads; ++t)
+		workers.emplace_back([&, t] {
+			auto& out = thread_latencies[std::size_t(t)];
+			for (std::size_t i = next++; i < ops.size(); i = next++) {
+				auto op_start = clock_type::now();
+				bytes += ops[i]();
+				out.push_back(seconds(clock_type::now() - op_start));
+			}
+		});
+	for (auto& worker : workers)
+		worker.join();
+	double secs = seconds(clock_type::now() - start);
+
+	if (latencies)
+		for (const auto& l : thread_latencies)
+			latencies->insert(latencies->end(), l.begin(), l.end());
+	return {secs, bytes};
+}
+
+template <typename T>
+std::vector<Operation> make_operations(const Config& config,
+                                       const Options& opts,
+                                       const ds::ImageView& view,
+                                       ds::dataset_props_ptr props,
+                                       const i3d::Image3d<T>& src) {
+	Vec img_dim = props->get_img_dimensions(IMG_RESOLUTION);
+	Vec block_dim = props->get_block_dimensions(IMG_RESOLUTION);
+	bool read = config.mode == "read";
+	std::vector<Operation> ops;
+
+	auto bytes_of = [](Vec size) {
+		return std::size_t(size.x) * std::size_t(size.y) *
+		       std::size_t(size.z) * sizeof(T);
+	};
+
+	if (config.unit == "image") {
+		/* Each thread transfers the whole image */
+		for (int t = 0; t < config.threads; ++t)
+			ops.push_back([=, &view, &src] {
+				if (read)
+					view.read_image<T>(props);
+				else
+					view.write_image(src, props);
+				return bytes_of(img_dim);
+			});
+		return ops;
+	}
+
+	/* Start points of blocks or regions */
+	Vec step = config.unit == "block" ? block_dim
+	                                  : opts.region.value_or(block_dim * 2);
+	std::vector<Vec> starts;
+	for (int x = 0; x < img_dim.x; x += step.x)
+		for (int y = 0; y < img_dim.y; y += step.y)
+			for (int z = 0; z < img_dim.z; z += step.z)
+				starts.emplace_back(x, y, z);
+
+	if (config.order == "shuffled")
+		shuffle(starts);
+
+	if (config.unit == "region") {
+		for (Vec start : starts) {
+			Vec size = step;
+			for (int i = 0; i < 3; ++i)
+				size[i] = std::min(step[i], img_dim[i] - start[i]);
+
+			ops.push_back([=, &view, &src] {
+				if (read) {
+					std::vector<T> buffer(bytes_of(size) / sizeof(T));
+					view.read_region(
+					    start, ds::StridedView<T>::contiguous(buffer, size),
+					    props);
+				} else
+					view.write_region(ds::details::data_manip::make_view(src)
+					                      .subview(start, size),
+					                  start, props);
+				return bytes_of(size);
+			});
+		}
+		return ops;
+	}
+
+	/* Blocks, <batch> of them per operation */
+	std::size_t batch = std::max<std::size_t>(config.batch, 1);
+	for (std::size_t i = 0; i < starts.size(); i += batch) {
+		std::vector<Vec> coords, offsets;
+		std::size_t bytes = 0;
+		for (std::size_t j = i; j < std::min(i + batch, starts.size()); ++j) {
+			coords.push_back(starts[j] / block_dim);
+			offsets.push_back(starts[j]);
+			bytes += bytes_of(
+			    props->get_block_size(coords.back(), IMG_RESOLUTION));
+		}
+
+		ops.push_back([=, &view, &src] {
+			if (read)
+				view.read_blocks<T>(coords, props);
+			else
+				view.write_blocks(src, coords, offsets, props);
+			return bytes;
+		});
+	}
+	return ops;
+}
+
+template <typename T>
+std::vector<Report> meassure(const Options& opts,
+                             ds::dataset_props_ptr props) {
+	ds::Connection conn(SERVER_IP, SERVER_PORT, DS_UUID);
+	ds::ImageView view = conn.get_view(IMG_CHANNEL, IMG_TIMEPOINT, IMG_ANGLE,
+	                                   IMG_RESOLUTION, IMG_VERSION);
+
+	/* Source of all writes */
+	i3d::Image3d<T> src;
+	if (std::ranges::find(opts.modes, "write") != opts.modes.end()) {
+		std::cout << "Generating random image\n";
+		src.MakeRoom(props->get_img_dimensions(IMG_RESOLUTION));
+		fill_random(src);
+	}
+
+	fmt::print("{:<6} {:<7} {:<9} {:>7} {:>6} {:>7} | {:>9} {:>9} {:>9} | "
+	           "{:>18}\n",
+	           "mode", "unit", "order", "threads", "batch", "ops", "p50 [ms]",
+	           "p95 [ms]", "p99 [ms]", "throughput [MB/s]");
+
+	std::vector<Report> reports;
+	for (const auto& mode : opts.modes)
+		for (const auto& unit : opts.units)
+			for (const auto& order : opts.orders)
+				for (int threads : opts.threads)
+					for (std::size_t batch : opts.batches) {
+						Config config{mode, unit, order, threads, batch};
+
+						/* 0 keeps library defaults (adaptive batching) */
+						ds::BatchLimits limits;
+						if (batch != 0) {
+							limits.max_blocks = batch;
+							limits.adaptive = false;
+						}
+						conn.set_batch_limits(limits);
+
+						auto ops =
+						    make_operations<T>(config, opts, view, props, src);
+						Report report;
+						report.config = config;
+						report.operations = ops.size();
+
+						for (int i = 0; i < opts.warmup; ++i)
+							run_trial(ops, threads, nullptr);
+
+						for (int i = 0; i < opts.trials; ++i) {
+							Trial trial =
+							    run_trial(ops, threads, &report.latencies);
+							report.bytes = trial.bytes;
+							report.throughputs.push_back(double(trial.bytes) /
+							                             trial.seconds);
+						}
+
+						print_report(report);
+						reports.push_back(std::move(report));
+					}
+
+	return reports;
+}
+
+void print_report(const Report& r) {
+	fmt::print("{:<6} {:<7} {:<9} {:>7} {:>6} {:>7} | {:>9.2f} {:>9.2f} "
+	           "{:>9.2f} | {:>9.2f} +- {:<6.2f}\n",
+	           r.config.mode, r.config.unit, r.config.order, r.config.threads,
+	           r.config.batch, r.operations, percentile(r.latencies, 50) * 1e3,
+	           percentile(r.latencies, 95) * 1e3,
+	           percentile(r.latencies, 99) * 1e3, mean(r.throughputs) / 1e6,
+	           stddev(r.throughputs) / 1e6);
+}
+
+void write_json(std::ostream& os,
+                const std::vector<Report>& reports,
+                const Options& opts,
+                const std::string& voxel_type) {
+	os << "{\n";
+	os << fmt::format("  \"server\": \"{}\",\n",
+	                  opts.mock_type ? "mock" : SERVER_IP);
+	os << fmt::format("  \"voxel_type\": \"{}\",\n", voxel_type);
+	os << fmt::format("  \"warmup\": {},\n  \"trials\": {},\n", opts.warmup,
+	                  opts.trials);
+	os << "  \"results\": [";
+
+	for (std::size_t i = 0; i < reports.size(); ++i) {
+		const Report& r = reports[i];
+		os << (i == 0 ? "\n" : ",\n");
+		os << fmt::format(
+		    "    {{\"mode\": \"{}\", \"unit\": \"{}\", \"order\": \"{}\", "
+		    "\"threads\": {}, \"batch\": {}, \"operations\": {}, "
+		    "\"bytes\": {}, \"latency_p50_s\": {}, \"latency_p95_s\": {}, "
+		    "\"latency_p99_s\": {}, \"throughput_mean\": {}, "
+		    "\"throughput_stddev\": {}, \"throughput_min\": {}, "
+		    "\"throughput_max\": {}}}",
+		    r.config.mode, r.config.unit, r.config.order, r.config.threads,
+		    r.config.batch, r.operations, r.bytes, percentile(r.latencies, 50),
+		    percentile(r.latencies, 95), percentile(r.latencies, 99),
+		    mean(r.throughputs), stddev(r.throughputs),
+		    std::ranges::min(r.throughputs), std::ranges::max(r.throughputs));
+	}
+
+	os << "\n  ]\n}\n";
+}
+
+int main(int argc, char** argv) {
+	Options opts;
+	try {
+		opts = parse_options(argc, argv);
+	} catch (const std::exception& e) {
+		std::cerr << e.what() << '\n';
+		return 1;
+	}
+
+	std::unique_ptr<mock::MockDatastore> server;
+	if (opts.mock_type) {
+		mock::MockSettings settings;
+		settings.port = SERVER_PORT;
+		settings.latency = std::chrono::milliseconds(opts.mock_latency);
+		settings.bandwidth = std::size_t(opts.mock_bandwidth * 1'000'000.0);
+
+		server = std::make_unique<mock::MockDatastore>(
+		    mock::make_properties(DS_UUID, *opts.mock_type), settings);
+		server->start();
+		std::cout << "Started mock server on port " << server->port() << '\n';
+	}
+
+	std::cout << "Fetching properties from the server ... " << std::flush;
+	auto props = ds::get_dataset_properties(SERVER_IP, SERVER_PORT, DS_UUID);
+	std::cout << "[OK]" << std::endl;
+
+	std::vector<Report> reports;
+	SELECT_TYPE(props->voxel_type, reports = meassure, opts, props);
+
+	if (!opts.json.empty()) {
+		std::ofstream file(opts.json);
+		write_json(file, reports, opts, props->voxel_type);
+		if (!file) {
+			std::cerr << "Could not write " << opts.json << '\n';
+			return 1;
+		}
+	}
+}
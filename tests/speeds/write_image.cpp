@@ -5,14 +5,12 @@
 
 
 template <typename T>
-void meassure() {
+void meassure(ds::dataset_props_ptr props) {
 	ds::ImageView img_view(SERVER_IP, SERVER_PORT, DS_UUID, IMG_CHANNEL,
 	                       IMG_TIMEPOINT, IMG_ANGLE, IMG_RESOLUTION,
 	                       IMG_VERSION);
-    std::cout << "Generating random image\n";
-    auto props =
-	    ds::get_dataset_properties(SERVER_IP, SERVER_PORT, DS_UUID);
-    i3d::Vector3d<int> img_dim = props->get_img_dimensions(IMG_RESOLUTION);
+	std::cout << "Generating random image\n";
+	i3d::Vector3d<int> img_dim = props->get_img_dimensions(IMG_RESOLUTION);
 	i3d::Image3d<T> new_img;
 	new_img.MakeRoom(img_dim);
 	fill_random(new_img);
@@ -20,17 +18,14 @@ void meassure() {
 	std::cout << "Starting meassurement\n";
 	auto start = std::chrono::steady_clock::now();
 
-	img_view.write_image(new_img);
+	img_view.write_image(new_img, props);
 
 	auto end = std::chrono::steady_clock::now();
 
-	double secs = double(std::chrono::duration_cast<std::chrono::milliseconds>(
-	                         end - start)
-	                         .count()) /
-	              1000.0;
+	double secs = std::chrono::duration<double>(end - start).count();
 	std::size_t bytes = new_img.GetImageSize() * sizeof(T);
 	std::cout << "Writing took: " << secs << " seconds\n";
-	std::cout << "Downloaded: " << bytes << " bytes\n";
+	std::cout << "Uploaded: " << bytes << " bytes\n";
 	std::cout << "Average speed: " << double(bytes) / 1'000'000.0 / secs
 	          << " MB/s\n";
 }
@@ -44,5 +39,5 @@ int main() {
 	std::cout << "[OK]" << std::endl;
 
 	/** Select correct format for template **/
-	SELECT_TYPE(props->voxel_type, meassure);
+	SELECT_TYPE(props->voxel_type, meassure, props);
 }
\ No newline at end of file
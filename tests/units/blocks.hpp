@@ -2,8 +2,18 @@
 
 #include "../common.hpp"
 #include <iostream>
+#include <thread>
+
+#ifdef DATASTORE_MOCK
+#include "../mock/mock_server.hpp"
+#endif
 
 namespace units {
+#ifdef DATASTORE_MOCK
+/* Embedded server started by main(), used to inject faults */
+inline mock::MockDatastore* mock_server = nullptr;
+#endif
+
 template <typename T>
 void test_blocks() {
 	test_start("Read/Write blocks");
@@ -112,6 +122,316 @@ void test_blocks() {
 	}
 
     phase_ok();
+
+	phase_start("Record metrics of block reads and writes");
+
+	{
+		conn.reset_metrics();
+		conn.write_blocks(conn_img, shuffled, conn_offsets, IMG_CHANNEL,
+		                  IMG_TIMEPOINT, IMG_ANGLE, IMG_RESOLUTION,
+		                  IMG_VERSION);
+		conn.read_blocks<T>(shuffled, IMG_CHANNEL, IMG_TIMEPOINT, IMG_ANGLE,
+		                    IMG_RESOLUTION, IMG_VERSION);
+
+		ds::Metrics metrics = conn.get_metrics();
+		if constexpr (ds::details::_METRICS_) {
+			assert(metrics.counters["read.blocks"] == shuffled.size());
+			assert(metrics.counters["write.blocks"] == shuffled.size());
+			assert(metrics.counters["read.bytes"] ==
+			       metrics.counters["write.bytes"]);
+			assert(metrics.histograms["read.transfer"].count() ==
+			       metrics.counters["read.requests"]);
+			assert(metrics.histograms["read.session"].count() == 1);
+		} else
+			assert(metrics.counters.empty() && metrics.histograms.empty());
+	}
+
+	phase_ok();
+
+	phase_start("Trace block reads");
+
+	{
+		ds::start_tracing();
+		view.read_blocks<T>(shuffled);
+		ds::stop_tracing();
+		std::string trace = ds::get_trace();
+
+		for (std::string name : {"session_url_request", "make_request",
+		                         "read_data"})
+			assert(trace.find(fmt::format("\"name\": \"{}\"", name)) !=
+			       std::string::npos);
+
+		/* Nothing recorded after stop */
+		view.read_blocks<T>(shuffled);
+		assert(ds::get_trace() == trace);
+	}
+
+	phase_ok();
+
+	phase_start("Hedge slow block reads");
+
+	{
+		/* Hedge almost every request */
+		ds::HedgingPolicy policy;
+		policy.enabled = true;
+		policy.percentile = 0;
+		policy.min_delay = std::chrono::milliseconds(0);
+		policy.min_samples = 1;
+		policy.budget = 0.5;
+		conn.set_hedging_policy(policy);
+		conn.reset_metrics();
+
+		i3d::Image3d<T> conn_cpy;
+		conn_cpy.MakeRoom(conn_img.GetSize());
+		for (int i = 0; i < 3; ++i)
+			conn.read_blocks(shuffled, conn_cpy, conn_offsets, IMG_CHANNEL,
+			                 IMG_TIMEPOINT, IMG_ANGLE, IMG_RESOLUTION,
+			                 IMG_VERSION);
+		assert(conn_cpy == conn_img);
+
+		ds::Metrics metrics = conn.get_metrics();
+		assert(metrics.counters["read.hedges"] > 0);
+		assert(metrics.counters["read.hedge_wins"] <=
+		       metrics.counters["read.hedges"]);
+
+		conn.set_hedging_policy({});
+	}
+
+	phase_ok();
+
+	phase_start("Cancel block operations");
+
+	{
+		ds::Timeouts timeouts;
+		timeouts.io = std::chrono::milliseconds(30000);
+		view.set_timeouts(timeouts);
+		assert(view.get_timeouts().io == timeouts.io);
+
+		/* Destination keeps its previous content */
+		ds::CancellationToken token;
+		token.cancel();
+		i3d::Image3d<T> view_cpy = view_img;
+		bool cancelled = false;
+		try {
+			view.with_cancellation(token).read_blocks(shuffled, view_cpy,
+			                                          view_offsets);
+		} catch (const ds::OperationCancelled&) {
+			cancelled = true;
+		}
+		assert(cancelled);
+		assert(view_cpy == view_img);
+
+		cancelled = false;
+		try {
+			view.with_cancellation(ds::CancellationToken::with_timeout(
+			                           std::chrono::milliseconds(0)))
+			    .write_blocks(view_img, shuffled, view_offsets);
+		} catch (const ds::OperationCancelled&) {
+			cancelled = true;
+		}
+		assert(cancelled);
+
+		/* Token which is never cancelled does not interfere */
+		assert(view.with_cancellation({}).read_image<T>() == conn_img);
+
+		view.set_timeouts({});
+
+		bool rejected = false;
+		try {
+			view.set_timeouts({std::chrono::milliseconds(0)});
+		} catch (const std::logic_error&) {
+			rejected = true;
+		}
+		assert(rejected);
+
+#ifdef DATASTORE_MOCK
+		using clock = std::chrono::steady_clock;
+
+		/* Cancelled while the server delays the response */
+		mock_server->set_latency(std::chrono::milliseconds(2000));
+		ds::CancellationToken pending;
+		std::thread canceller([pending]() mutable {
+			std::this_thread::sleep_for(std::chrono::milliseconds(100));
+			pending.cancel();
+		});
+		clock::time_point start = clock::now();
+		cancelled = false;
+		try {
+			view.with_cancellation(pending).read_blocks<T>(shuffled);
+		} catch (const ds::OperationCancelled&) {
+			cancelled = true;
+		}
+		canceller.join();
+		assert(cancelled);
+		assert(clock::now() - start < std::chrono::milliseconds(1000));
+		mock_server->set_latency(std::chrono::milliseconds(0));
+
+		/* Deadline expires while the body is being received */
+		mock_server->set_bandwidth(std::size_t(256) << 10);
+		start = clock::now();
+		cancelled = false;
+		try {
+			view.with_cancellation(ds::CancellationToken::with_timeout(
+			                           std::chrono::milliseconds(300)))
+			    .read_image<T>();
+		} catch (const ds::OperationCancelled&) {
+			cancelled = true;
+		}
+		assert(cancelled);
+		assert(clock::now() - start < std::chrono::milliseconds(1500));
+		mock_server->set_bandwidth(0);
+#endif
+	}
+
+	phase_ok();
+
+	phase_start("Limit concurrent block requests");
+
+	{
+		ds::ConcurrencyPolicy policy;
+		policy.adaptive = false;
+		policy.initial_limit = 2;
+		conn.set_concurrency_policy(policy);
+
+		/* Shared by all connections to the same server */
+		assert(view.get_concurrency_policy().initial_limit == 2);
+		assert(view.get_concurrency_limit() == 2);
+
+		conn.reset_metrics();
+		i3d::Image3d<T> conn_cpy;
+		conn_cpy.MakeRoom(conn_img.GetSize());
+		conn.read_blocks(shuffled, conn_cpy, conn_offsets, IMG_CHANNEL,
+		                 IMG_TIMEPOINT, IMG_ANGLE, IMG_RESOLUTION, IMG_VERSION);
+		assert(conn_cpy == conn_img);
+		assert(conn.get_metrics().histograms["read.concurrency"].max() <= 2);
+
+		conn.set_concurrency_policy({});
+
+		/* Adaptive limit driven directly, one round of requests at a time */
+		using Controller = ds::details::ConcurrencyController;
+		using std::chrono::milliseconds;
+		policy.adaptive = true;
+		policy.max_limit = 8;
+		Controller controller(policy);
+		auto round = [&](std::size_t bytes, milliseconds first_byte,
+		                 bool upload) {
+			std::vector<Controller::Slot> slots;
+			for (std::size_t i = controller.limit(); i > 0; --i)
+				slots.push_back(controller.acquire());
+			for (const Controller::Slot& slot : slots)
+				controller.record_success(slot, bytes, first_byte, upload);
+		};
+
+		/* Grows (at least every other round) up to the maximum */
+		for (int i = 0; i < 12; ++i)
+			round(std::size_t(1) << 20, milliseconds(10), false);
+		assert(controller.limit() == 8);
+
+		/* Larger batches and uploads take longer, but are not spikes */
+		round(std::size_t(128) << 20, milliseconds(500), false);
+		round(std::size_t(1) << 20, milliseconds(100), true);
+		assert(controller.limit() == 8);
+
+		/* Spike backs off once per round of requests */
+		round(std::size_t(1) << 20, milliseconds(50), false);
+		assert(controller.limit() == 4);
+
+		/* So does congestion, requests sent before see the same one */
+		{
+			Controller::Slot stale = controller.acquire();
+			controller.record_congestion(controller.acquire());
+			assert(controller.limit() == 2);
+			controller.record_congestion(stale);
+			assert(controller.limit() == 2);
+		}
+
+		for (int i = 0; i < 4; ++i)
+			controller.record_congestion(controller.acquire());
+		assert(controller.limit() == policy.min_limit);
+	}
+
+	phase_ok();
+
+	phase_start("Spread block requests across endpoints");
+
+	{
+		ds::Connection multi(
+		    {{SERVER_IP, SERVER_PORT}, {SERVER_IP, SERVER_PORT}}, DS_UUID);
+		i3d::Image3d<T> conn_cpy;
+		conn_cpy.MakeRoom(conn_img.GetSize());
+		multi.read_blocks(shuffled, conn_cpy, conn_offsets, IMG_CHANNEL,
+		                  IMG_TIMEPOINT, IMG_ANGLE, IMG_RESOLUTION, IMG_VERSION,
+		                  props);
+		assert(conn_cpy == conn_img);
+
+#ifdef DATASTORE_MOCK
+		/* Nothing listens on port 1, requests fail over to the server */
+		ds::Connection failover({{"127.0.0.1", 1}, {SERVER_IP, SERVER_PORT}},
+		                        DS_UUID);
+		assert(failover.read_image<T>(IMG_CHANNEL, IMG_TIMEPOINT, IMG_ANGLE,
+		                              IMG_RESOLUTION, IMG_VERSION) == conn_img);
+#endif
+	}
+
+	phase_ok();
+
+#ifdef DATASTORE_MOCK
+	phase_start("Retry failed block requests");
+
+	{
+		using Poco::Net::HTTPResponse;
+
+		ds::RetryPolicy policy;
+		policy.initial_backoff = std::chrono::milliseconds(1);
+		view.set_retry_policy(policy);
+
+		/* Truncated bodies, only missing blocks are requested again */
+		view.write_image(view_img);
+		mock_server->inject_faults(3, HTTPResponse::HTTP_OK);
+		i3d::Image3d<T> view_cpy;
+		view_cpy.MakeRoom(view_img.GetSize());
+		view.read_blocks(shuffled, view_cpy, view_offsets);
+		assert(view_cpy == view_img);
+
+		/* Overlong bodies are requested again as a whole */
+		mock_server->inject_faults(3, HTTPResponse::HTTP_OK, true);
+		i3d::Image3d<T> overlong_cpy;
+		overlong_cpy.MakeRoom(view_img.GetSize());
+		view.reset_metrics();
+		view.read_blocks(shuffled, overlong_cpy, view_offsets);
+		assert(overlong_cpy == view_img);
+		if constexpr (ds::details::_METRICS_)
+			assert(view.get_metrics().counters["read.retries"] == 3);
+
+		/* Transient errors */
+		mock_server->inject_faults(2, HTTPResponse::HTTP_SERVICE_UNAVAILABLE);
+		view.write_blocks(conn_img, shuffled, conn_offsets);
+		mock_server->inject_faults(2, HTTPResponse::HTTP_SERVICE_UNAVAILABLE);
+		assert(view.read_image<T>() == conn_img);
+
+		/* Give up after the last attempt (both faults hit one batch) */
+		ds::ConcurrencyPolicy sequential;
+		sequential.adaptive = false;
+		sequential.initial_limit = 1;
+		sequential.max_limit = 1;
+		view.set_concurrency_policy(sequential);
+		policy.max_attempts = 2;
+		view.set_retry_policy(policy);
+		mock_server->inject_faults(2, HTTPResponse::HTTP_SERVICE_UNAVAILABLE);
+		bool failed = false;
+		try {
+			view.read_blocks<T>(shuffled);
+		} catch (const std::logic_error&) {
+			failed = true;
+		}
+		assert(failed);
+
+		view.set_retry_policy({});
+		view.set_concurrency_policy({});
+	}
+
+	phase_ok();
+#endif
 	test_ok();
 }
 } // namespace units
\ No newline at end of file
@@ -1,8 +1,13 @@
 #pragma once
 
 #include "../common.hpp"
+#include <cmath>
+#include <filesystem>
+#include <fstream>
 #include <i3d/transform.h>
 #include <iostream>
+#include <limits>
+#include <numeric>
 
 namespace units {
 template <typename T>
@@ -66,6 +71,253 @@ void test_image() {
 	}
 
 	phase_ok();
+
+	phase_start("Read image of runtime voxel type");
+
+	{
+		assert(ds::visit_voxel_type(props->voxel_type, [](auto type) {
+			return std::is_same_v<typename decltype(type)::type, T>;
+		}));
+
+		ds::AnyImage any = view.read_image_any();
+		assert(ds::voxel_type_of(any) == props->voxel_type);
+		assert(std::get<i3d::Image3d<T>>(any) == view_random_img);
+
+		std::size_t voxels = std::visit(
+		    [](const auto& img) { return img.GetImageSize(); }, any);
+		assert(voxels == view_random_img.GetImageSize());
+
+		ds::AnyImage region = conn.read_region_any(
+		    {0, 0, 0}, img_dim, IMG_CHANNEL, IMG_TIMEPOINT, IMG_ANGLE,
+		    IMG_RESOLUTION, IMG_VERSION, props);
+		assert(std::get<i3d::Image3d<T>>(region) == view_random_img);
+	}
+
+	phase_ok();
+
+	phase_start("Read image to file");
+
+	{
+		const std::string path = "read_image_to_file.nrrd";
+		view.read_image_to_file<T>(path, ds::FileLayout::NRRD);
+
+		/* Skip header (terminated by empty line) */
+		std::ifstream file(path, std::ios::binary);
+		std::string line;
+		while (std::getline(file, line) && !line.empty())
+			;
+
+		i3d::Image3d<T> got;
+		got.MakeRoom(img_dim);
+		file.read(reinterpret_cast<char*>(got.GetFirstVoxelAddr()),
+		          std::streamsize(got.GetImageSize() * sizeof(T)));
+		assert(file.good());
+		assert(view_random_img == got);
+
+		file.close();
+		std::filesystem::remove(path);
+	}
+
+	{
+		/* Coarsest level, whose block grid differs from full resolution */
+		i3d::Vector3d<int> resolution = props->get_all_resolutions().back();
+		auto coarse_view = conn.get_view(IMG_CHANNEL, IMG_TIMEPOINT,
+		                                 IMG_ANGLE, resolution, IMG_VERSION);
+
+		i3d::Image3d<T> coarse_img;
+		coarse_img.MakeRoom(props->get_img_dimensions(resolution));
+		fill_random(coarse_img);
+		coarse_view.write_image(coarse_img, props);
+
+		const std::string path = "read_image_to_file.raw";
+		coarse_view.read_image_to_file<T>(path, ds::FileLayout::RAW, props);
+
+		i3d::Image3d<T> got;
+		got.MakeRoom(coarse_img.GetSize());
+		std::ifstream file(path, std::ios::binary);
+		file.read(reinterpret_cast<char*>(got.GetFirstVoxelAddr()),
+		          std::streamsize(got.GetImageSize() * sizeof(T)));
+		assert(file.good());
+		assert(coarse_img == got);
+
+		file.close();
+		std::filesystem::remove(path);
+	}
+
+	phase_ok();
+
+	phase_start("Export image slices");
+
+	if constexpr (ds::cnpts::FileVoxel<T>) {
+		const std::string pattern = "export_image_{:04}.tif";
+		view.export_image<T>(pattern);
+
+		for (int z = 0; z < img_dim.z; ++z) {
+			std::string path = fmt::format(fmt::runtime(pattern), z);
+			i3d::Image3d<T> slice;
+			slice.ReadImage(path.c_str());
+			assert(slice.GetSizeX() == std::size_t(img_dim.x));
+			assert(slice.GetSizeY() == std::size_t(img_dim.y));
+
+			for (int y = 0; y < img_dim.y; ++y)
+				for (int x = 0; x < img_dim.x; ++x)
+					assert(slice.GetVoxel(x, y, 0) ==
+					       view_random_img.GetVoxel(x, y, z));
+			std::filesystem::remove(path);
+		}
+	}
+
+	phase_ok();
+
+	phase_start("Import image slices");
+
+	if constexpr (ds::cnpts::FileVoxel<T>) {
+		const std::string pattern = "import_image_{:04}.tif";
+		fill_random(random_img);
+		for (int z = 0; z < img_dim.z; ++z) {
+			i3d::Image3d<T> slice;
+			random_img.GetSliceZ(slice, std::size_t(z));
+			slice.SaveImage(fmt::format(fmt::runtime(pattern), z).c_str());
+		}
+
+		view.import_image<T>(pattern);
+		assert(view.read_image<T>() == random_img);
+
+		for (int z = 0; z < img_dim.z; ++z)
+			std::filesystem::remove(fmt::format(fmt::runtime(pattern), z));
+	}
+
+	phase_ok();
+
+	phase_start("Apply filter by tiles");
+
+	{
+		fill_random(random_img);
+		view.write_image(random_img);
+
+		ds::TilingPolicy policy;
+		policy.halo = {2, 2, 1};
+		policy.tile_blocks = {2, 1, 1};
+		i3d::Vector3d<int> max_tile =
+		    props->get_block_dimensions(IMG_RESOLUTION) * policy.tile_blocks +
+		    policy.halo * 2;
+
+		/* Pointwise filter, so the view can be its own target */
+		view.apply_filter<T>(
+		    [&](const i3d::Image3d<T>& in, i3d::Image3d<T>& out) {
+			    assert(lt(i3d::Vector3d<int>(in.GetSize()), max_tile + 1));
+			    out.MakeRoom(in.GetSize());
+			    for (std::size_t i = 0; i < in.GetImageSize(); ++i)
+				    out.SetVoxel(i, T(in.GetVoxel(i) / 2));
+		    },
+		    view, policy);
+
+		for (std::size_t i = 0; i < random_img.GetImageSize(); ++i)
+			random_img.SetVoxel(i, T(random_img.GetVoxel(i) / 2));
+		assert(view.read_image<T>() == random_img);
+
+		/* Neighbourhood filter needs the halo, so the result goes to another
+		 * version and has to match the filter applied to the whole image */
+		if (props->versions.size() > 1) {
+			int older = *std::ranges::min_element(props->versions);
+			ds::ImageView target =
+			    conn.get_view(IMG_CHANNEL, IMG_TIMEPOINT, IMG_ANGLE,
+			                  IMG_RESOLUTION, std::to_string(older));
+
+			policy.halo = {1, 1, 1};
+			view.apply_filter<T>(
+			    [](const i3d::Image3d<T>& in, i3d::Image3d<T>& out) {
+				    max_filter(in, out);
+			    },
+			    target, policy);
+
+			i3d::Image3d<T> filtered;
+			max_filter(random_img, filtered);
+			assert(target.read_image<T>() == filtered);
+			assert(view.read_image<T>() == random_img);
+		}
+	}
+
+	phase_ok();
+
+	phase_start("Compute statistics");
+
+	{
+		i3d::Vector3d<int> start = img_dim / 4;
+		i3d::Vector3d<int> end = img_dim - img_dim / 4;
+
+		double count = 0, sum = 0;
+		double min = std::numeric_limits<double>::infinity();
+		double max = -min;
+		std::vector<double> values;
+		for (int z = start.z; z < end.z; ++z)
+			for (int y = start.y; y < end.y; ++y)
+				for (int x = start.x; x < end.x; ++x) {
+					double value = double(random_img.GetVoxel(x, y, z));
+					count += 1;
+					sum += value;
+					min = std::min(min, value);
+					max = std::max(max, value);
+					values.push_back(value);
+				}
+
+		ds::StatisticsOptions options;
+		options.bins = 16;
+		options.range = {min, max};
+		ds::Statistics stats = view.compute_statistics(start, end, options);
+
+		assert(double(stats.count()) == count);
+		assert(stats.min() == min && stats.max() == max);
+		assert(std::abs(stats.mean() - sum / count) <=
+		       1e-9 * std::max(1.0, std::abs(sum / count)));
+		assert(stats.histogram().size() == 16);
+		assert(double(std::accumulate(stats.histogram().begin(),
+		                              stats.histogram().end(),
+		                              std::uint64_t(0))) == count);
+
+		double mean = sum / count;
+		double deviation = 0;
+		for (double value : values)
+			deviation += (value - mean) * (value - mean);
+		assert(std::abs(stats.variance() - deviation / count) <=
+		       1e-6 * std::max(1.0, deviation / count));
+
+		/* Percentile is the upper edge of the bin of the exact value */
+		std::ranges::sort(values);
+		double median = values[std::size_t(std::ceil(count / 2)) - 1];
+		double width = (max - min) / 16;
+		double tolerance = 1e-9 * std::max(1.0, std::abs(max));
+		assert(stats.percentile(50) >= median - tolerance &&
+		       stats.percentile(50) <= median + width + tolerance);
+		assert(stats.percentile(100) == max);
+
+		/* Coarser level, region is extended to whole voxels of that level */
+		i3d::Vector3d<int> level = props->get_all_resolutions().back();
+		if (level != IMG_RESOLUTION) {
+			ds::ImageView coarse = conn.get_view(
+			    IMG_CHANNEL, IMG_TIMEPOINT, IMG_ANGLE, level, IMG_VERSION);
+			i3d::Image3d<T> coarse_img;
+			coarse_img.MakeRoom(props->get_img_dimensions(level));
+			fill_random(coarse_img);
+			coarse.write_image(coarse_img);
+
+			ds::StatisticsOptions approximate;
+			approximate.resolution = level;
+			ds::Statistics coarse_stats =
+			    view.compute_statistics(start, end, approximate);
+
+			i3d::Vector3d<int> from = start / level;
+			i3d::Vector3d<int> to = i3d::min((end + level - 1) / level,
+			                                 props->get_img_dimensions(level));
+			i3d::Image3d<T> covered = get_subimage(coarse_img, from, to - from);
+			auto [low, high] = std::ranges::minmax_element(covered);
+			assert(coarse_stats.count() == covered.GetImageSize());
+			assert(coarse_stats.min() == double(*low) &&
+			       coarse_stats.max() == double(*high));
+		}
+	}
+
+	phase_ok();
 	
 	
 	phase_start("Write with pyramids");
@@ -83,9 +335,13 @@ void test_image() {
 			                        IMG_VERSION, mode);
 
 			for (auto& resolution : props->get_all_resolutions()) {
-				i3d::Image3d<T> cpy;
-				i3d::Resample(random_img, cpy,
-				              props->get_img_dimensions(resolution), mode);
+				/* Pyramids are cascaded, so nearest neighbour is decimation
+				 * (first voxel of each window) rather than i3d::Resample of
+				 * the full image, which cannot be computed level by level
+				 * when dimensions are not multiples of the factor */
+				i3d::Image3d<T> cpy = downsample_nearest(
+				    random_img, resolution,
+				    props->get_img_dimensions(resolution));
 
 				assert(cpy == conn.read_image<T>(IMG_CHANNEL, IMG_TIMEPOINT,
 				                                 IMG_ANGLE, resolution,
@@ -111,9 +367,13 @@ void test_image() {
 			                         IMG_ANGLE, IMG_VERSION, mode);
 
 			for (auto& resolution : props->get_all_resolutions()) {
-				i3d::Image3d<T> cpy;
-				i3d::Resample(random_img, cpy,
-				              props->get_img_dimensions(resolution), mode);
+				/* Pyramids are cascaded, so nearest neighbour is decimation
+				 * (first voxel of each window) rather than i3d::Resample of
+				 * the full image, which cannot be computed level by level
+				 * when dimensions are not multiples of the factor */
+				i3d::Image3d<T> cpy = downsample_nearest(
+				    random_img, resolution,
+				    props->get_img_dimensions(resolution));
 
 				assert(cpy == conn.read_image<T>(IMG_CHANNEL, IMG_TIMEPOINT,
 				                                 IMG_ANGLE, resolution,
@@ -124,6 +384,147 @@ void test_image() {
 
 	phase_ok();
 
+	phase_start("Write with pyramids using reduction");
+
+	{
+		fill_random(random_img);
+		conn.write_with_pyramids(random_img, IMG_CHANNEL, IMG_TIMEPOINT,
+		                         IMG_ANGLE, IMG_VERSION, ds::ReductionMode::MAX);
+
+		for (auto& resolution : props->get_all_resolutions()) {
+			/* Maximum of cascaded maxima equals to the maximum of window */
+			i3d::Image3d<T> cpy = downsample_max(
+			    random_img, resolution, props->get_img_dimensions(resolution));
+
+			assert(cpy == conn.read_image<T>(IMG_CHANNEL, IMG_TIMEPOINT,
+			                                 IMG_ANGLE, resolution,
+			                                 IMG_VERSION));
+		}
+	}
+
+	phase_ok();
+
+	phase_start("Write with pyramids using average and mode");
+
+	{
+		std::vector<i3d::Vector3d<int>> order =
+		    ds::details::pyramids::get_generation_order(*props);
+
+		/* Small values (few labels for mode), so sums are exact in float */
+		for (auto [mode, max] : {std::pair{ds::ReductionMode::AVERAGE, 255},
+		                         std::pair{ds::ReductionMode::MODE, 3}}) {
+			fill_random(random_img, max);
+			conn.write_with_pyramids(random_img, IMG_CHANNEL, IMG_TIMEPOINT,
+			                         IMG_ANGLE, IMG_VERSION, mode);
+
+			auto reference = [&](const i3d::Image3d<T>& src,
+			                     i3d::Vector3d<int> factor,
+			                     i3d::Vector3d<int> size) {
+				return mode == ds::ReductionMode::AVERAGE
+				           ? downsample_average(src, factor, size)
+				           : downsample_mode(src, factor, size);
+			};
+
+			/* Levels are cascaded, each one is reduced from the coarsest
+			 * already generated level with integer ratio */
+			std::vector<std::pair<i3d::Vector3d<int>, i3d::Image3d<T>>>
+			    levels{{{1, 1, 1}, random_img}};
+			for (auto resolution : order) {
+				if (resolution == i3d::Vector3d<int>{1, 1, 1})
+					continue;
+
+				auto source = std::find_if(
+				    levels.rbegin(), levels.rend(), [&](const auto& level) {
+					    return ds::details::pyramids::get_level_ratio(
+					               level.first, resolution)
+					        .has_value();
+				    });
+				i3d::Vector3d<int> factor =
+				    *ds::details::pyramids::get_level_ratio(source->first,
+				                                            resolution);
+				i3d::Image3d<T> cpy = reference(
+				    source->second, factor,
+				    props->get_img_dimensions(resolution));
+
+				i3d::Image3d<T> img = conn.read_image<T>(
+				    IMG_CHANNEL, IMG_TIMEPOINT, IMG_ANGLE, resolution,
+				    IMG_VERSION);
+				assert(cpy == img);
+
+				/* Average of rounded averages stays within 1 of the mean
+				 * of the whole window */
+				if (mode == ds::ReductionMode::AVERAGE)
+					assert(near(reference(random_img, resolution,
+					                      props->get_img_dimensions(
+					                          resolution)),
+					            img, 1.0));
+
+				levels.emplace_back(resolution, std::move(cpy));
+			}
+		}
+	}
+
+	phase_ok();
+
+	phase_start("Update pyramids after block writes");
+
+	{
+		auto block_dim = props->get_block_dimensions({1, 1, 1});
+		std::vector<i3d::Vector3d<int>> changed = {
+		    {0, 0, 0}, props->get_block_count({1, 1, 1}) - 1};
+		std::vector<i3d::Vector3d<int>> offsets;
+
+		for (auto coord : changed) {
+			i3d::Image3d<T> block;
+			block.MakeRoom(props->get_block_size(coord, {1, 1, 1}));
+			fill_random(block);
+			copy_to_subimage(random_img, block, coord * block_dim);
+			offsets.push_back(coord * block_dim);
+		}
+
+		conn.write_blocks(random_img, changed, offsets, IMG_CHANNEL,
+		                  IMG_TIMEPOINT, IMG_ANGLE, {1, 1, 1}, IMG_VERSION);
+		conn.update_pyramids<T>(changed, IMG_CHANNEL, IMG_TIMEPOINT,
+		                        IMG_ANGLE, IMG_VERSION, ds::ReductionMode::MAX);
+
+		for (auto& resolution : props->get_all_resolutions()) {
+			i3d::Image3d<T> cpy = downsample_max(
+			    random_img, resolution, props->get_img_dimensions(resolution));
+
+			assert(cpy == conn.read_image<T>(IMG_CHANNEL, IMG_TIMEPOINT,
+			                                 IMG_ANGLE, resolution,
+			                                 IMG_VERSION));
+		}
+	}
+
+	phase_ok();
+
+	phase_start("Stream with pyramids");
+
+	{
+		fill_random(random_img);
+		auto block_dim = props->get_block_dimensions({1, 1, 1});
+		ds::block_producer<T> producer = [&](i3d::Vector3d<int> coord) {
+			return get_subimage(random_img, coord * block_dim,
+			                    props->get_block_size(coord, {1, 1, 1}));
+		};
+
+		conn.stream_with_pyramids(producer, IMG_CHANNEL, IMG_TIMEPOINT,
+		                          IMG_ANGLE, IMG_VERSION,
+		                          ds::ReductionMode::NEAREST);
+
+		for (auto& resolution : props->get_all_resolutions()) {
+			i3d::Image3d<T> cpy = downsample_nearest(
+			    random_img, resolution, props->get_img_dimensions(resolution));
+
+			assert(cpy == conn.read_image<T>(IMG_CHANNEL, IMG_TIMEPOINT,
+			                                 IMG_ANGLE, resolution,
+			                                 IMG_VERSION));
+		}
+	}
+
+	phase_ok();
+
 	test_ok();
 }
 } // namespace units
\ No newline at end of file
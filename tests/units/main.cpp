@@ -4,7 +4,25 @@
 #include "image.hpp"
 #include "region.hpp"
 
+#ifdef DATASTORE_MOCK
+#include "../mock/mock_server.hpp"
+
+#ifndef DATASTORE_MOCK_VOXEL_TYPE
+#define DATASTORE_MOCK_VOXEL_TYPE "uint16"
+#endif
+#endif
+
 int main() {
+#ifdef DATASTORE_MOCK
+	/* Serve the tested dataset locally instead of using remote server */
+	mock::MockSettings settings;
+	settings.port = SERVER_PORT;
+	mock::MockDatastore server(
+	    mock::make_properties(DS_UUID, DATASTORE_MOCK_VOXEL_TYPE), settings);
+	server.start();
+	units::mock_server = &server;
+#endif
+
 	auto props = ds::get_dataset_properties(SERVER_IP, SERVER_PORT, DS_UUID);
 
 	SELECT_TYPE(props->voxel_type, units::test_block)
@@ -285,6 +285,121 @@ void test_region() {
 
 	phase_ok();
 
+	phase_start("Write random region");
+
+	view.write_image(random_img);
+	{
+		std::mt19937_64 gen(std::random_device{}());
+		i3d::Vector3d<int> img_dim = props->get_img_dimensions(IMG_RESOLUTION);
+
+		std::vector dists = {
+		    std::uniform_int_distribution<>(0, img_dim.x),
+		    std::uniform_int_distribution<>(0, img_dim.y),
+		    std::uniform_int_distribution<>(0, img_dim.z),
+		};
+
+		const std::size_t RANDOM_COUNT = 10;
+		for (std::size_t n = 0; n < RANDOM_COUNT; ++n) {
+			i3d::Vector3d<int> s, e;
+			do {
+				for (int i = 0; i < 3; ++i) {
+					s[i] = dists[i](gen);
+					e[i] = dists[i](gen);
+				}
+			} while (!lt(s, e));
+
+			i3d::Image3d<T> patch;
+			patch.MakeRoom(e - s);
+			fill_random(patch);
+
+			/* One block per request, edge blocks are merged batch by batch */
+			if (n == RANDOM_COUNT / 2) {
+				ds::BatchLimits limits;
+				limits.adaptive = false;
+				limits.max_body_bytes = 1;
+				view.set_batch_limits(limits);
+			}
+
+			if (n % 2 == 0)
+				view.write_region(patch, s);
+			else
+				conn.write_region(patch, s, IMG_CHANNEL, IMG_TIMEPOINT,
+				                  IMG_ANGLE, IMG_RESOLUTION, IMG_VERSION);
+
+			copy_to_subimage(random_img, patch, s);
+			assert(view.read_image<T>() == random_img);
+		}
+
+		view.set_batch_limits({});
+	}
+
+	phase_ok();
+
+	phase_start("Read/Write region using strided view");
+
+	view.write_image(random_img);
+	{
+		std::mt19937_64 gen(std::random_device{}());
+		i3d::Vector3d<int> img_dim = props->get_img_dimensions(IMG_RESOLUTION);
+
+		std::vector dists = {
+		    std::uniform_int_distribution<>(0, img_dim.x),
+		    std::uniform_int_distribution<>(0, img_dim.y),
+		    std::uniform_int_distribution<>(0, img_dim.z),
+		};
+
+		const std::size_t RANDOM_COUNT = 6;
+		for (std::size_t n = 0; n < RANDOM_COUNT; ++n) {
+			i3d::Vector3d<int> s, e;
+			do {
+				for (int i = 0; i < 3; ++i) {
+					s[i] = dists[i](gen);
+					e[i] = dists[i](gen);
+				}
+			} while (!lt(s, e));
+
+			/* z is the fastest axis of the buffer */
+			i3d::Vector3d<int> size = e - s;
+			std::vector<T> buffer(std::size_t(size.x) * size.y * size.z);
+			ds::StridedView<T> src{
+			    buffer, size,
+			    i3d::Vector3d<std::ptrdiff_t>(std::ptrdiff_t(size.y) * size.z,
+			                                  size.z, 1),
+			    0};
+
+			i3d::Image3d<T> patch;
+			patch.MakeRoom(size);
+			fill_random(patch);
+			for (int x = 0; x < size.x; ++x)
+				for (int y = 0; y < size.y; ++y)
+					for (int z = 0; z < size.z; ++z)
+						src.at(x, y, z) = patch.GetVoxel(x, y, z);
+
+			if (n % 2 == 0)
+				view.write_region(src, s);
+			else
+				conn.write_region(src, s, IMG_CHANNEL, IMG_TIMEPOINT,
+				                  IMG_ANGLE, IMG_RESOLUTION, IMG_VERSION);
+			copy_to_subimage(random_img, patch, s);
+
+			std::vector<T> got(buffer.size());
+			auto dest = ds::StridedView<T>::contiguous(got, size);
+			if (n % 2 == 0)
+				view.read_region(s, dest);
+			else
+				conn.read_region(s, dest, IMG_CHANNEL, IMG_TIMEPOINT,
+				                 IMG_ANGLE, IMG_RESOLUTION, IMG_VERSION);
+
+			for (int x = 0; x < size.x; ++x)
+				for (int y = 0; y < size.y; ++y)
+					for (int z = 0; z < size.z; ++z)
+						assert(dest.at(x, y, z) == src.at(x, y, z));
+		}
+		assert(view.read_image<T>() == random_img);
+	}
+
+	phase_ok();
+
 	test_ok();
 }
 } // namespace units
\ No newline at end of file